@@ -38,6 +38,150 @@ bench() {
     sed -i "1i\Mode: $file_size" reports/benchmark_$6.md
 }
 
+bench_threads() {
+    current_path=$1
+    directories_per_depth=$2
+    files_per_directory=$3
+    recursion_depth=$4
+    current_recursion_depth=$5
+    file_size=$6
+
+    mkdir data
+    ./test_data.sh $1 $2 $3 $4 $5 $6
+
+    total_directory_count=$(find ./data -mindepth 1 -type d | wc -l)
+    total_file_count=$(find ./data -mindepth 1 -type f | wc -l)
+
+    echo "Mode: $file_size (thread scaling)"
+    echo "Directories: $total_directory_count"
+    echo "Files: $total_file_count"
+
+    hyperfine \
+    --export-markdown reports/benchmark_threads_$6.md \
+    --warmup 3 \
+    --runs 5 \
+    --parameter-list threads 1,2,4,8,16 \
+    'ddk_dev -p data -t {threads}'
+
+    # cold page cache scans, dropping the caches requires root
+    hyperfine \
+    --export-markdown reports/benchmark_scan_backend_$6.md \
+    --prepare 'sync; echo 3 | sudo tee /proc/sys/vm/drop_caches || true' \
+    --runs 5 \
+    'ddk_dev -p data -t 1' \
+    'ddk_dev -p data -t 1 -u'
+
+    rm -rf ./data
+
+    sed -i "1i\Files: $total_file_count" reports/benchmark_threads_$6.md
+    sed -i "1i\Directories: $total_directory_count" reports/benchmark_threads_$6.md
+    sed -i "1i\Mode: $file_size (thread scaling)" reports/benchmark_threads_$6.md
+    sed -i "1i\Mode: $file_size (cold cache, io_uring scan backend)" reports/benchmark_scan_backend_$6.md
+}
+
+bench_hash_threads() {
+    current_path=$1
+    directories_per_depth=$2
+    files_per_directory=$3
+    recursion_depth=$4
+    current_recursion_depth=$5
+    file_size=$6
+
+    mkdir data
+    ./test_data.sh $1 $2 $3 $4 $5 $6
+
+    total_test_data_size=$(du -sh $1 | cut -f1 -d$'\t')
+    total_file_count=$(find ./data -mindepth 1 -type f | wc -l)
+
+    echo "Mode: $file_size (hashing thread scaling)"
+    echo "Files: $total_file_count"
+    echo "Total test data size on disk: $total_test_data_size"
+
+    # all files share their size, so nearly all of the time is spent hashing
+    hyperfine \
+    --export-markdown reports/benchmark_hash_threads_$6.md \
+    --warmup 3 \
+    --runs 5 \
+    --parameter-list threads 1,2,4,8,16 \
+    'ddk_dev -p data -t {threads}' \
+    'ddk_dev -p data -d -t {threads}'
+
+    rm -rf ./data
+
+    sed -i "1i\Files: $total_file_count" reports/benchmark_hash_threads_$6.md
+    sed -i "1i\Total test data size on disk: $total_test_data_size" reports/benchmark_hash_threads_$6.md
+    sed -i "1i\Mode: $file_size (hashing thread scaling)" reports/benchmark_hash_threads_$6.md
+}
+
+bench_hash_algorithms() {
+    current_path=$1
+    directories_per_depth=$2
+    files_per_directory=$3
+    recursion_depth=$4
+    current_recursion_depth=$5
+    file_size=$6
+
+    mkdir data
+    ./test_data.sh $1 $2 $3 $4 $5 $6
+
+    total_test_data_size=$(du -sh $1 | cut -f1 -d$'\t')
+
+    echo "Mode: $file_size (hash algorithms)"
+    echo "Total test data size on disk: $total_test_data_size"
+
+    hyperfine \
+    --export-markdown reports/benchmark_hash_algorithms_$6.md \
+    --warmup 1 \
+    --runs 5 \
+    --parameter-list algorithm xxh64,xxh3-64,xxh3-128 \
+    'ddk_dev -p data -t 1 -a {algorithm}' \
+    'ddk_dev -p data -a {algorithm}'
+
+    rm -rf ./data
+
+    sed -i "1i\Total test data size on disk: $total_test_data_size" reports/benchmark_hash_algorithms_$6.md
+    sed -i "1i\Mode: $file_size (hash algorithms)" reports/benchmark_hash_algorithms_$6.md
+}
+
+bench_read_modes() {
+    current_path=$1
+    directories_per_depth=$2
+    files_per_directory=$3
+    recursion_depth=$4
+    current_recursion_depth=$5
+    file_size=$6
+
+    mkdir data
+    ./test_data.sh $1 $2 $3 $4 $5 $6
+
+    total_test_data_size=$(du -sh $1 | cut -f1 -d$'\t')
+
+    echo "Mode: $file_size (read modes)"
+    echo "Total test data size on disk: $total_test_data_size"
+
+    # "-m 0" maps every file, "-m 1048576" reads every file into buffers
+    hyperfine \
+    --export-markdown reports/benchmark_read_modes_warm_$6.md \
+    --warmup 1 \
+    --runs 5 \
+    --parameter-list options "-m 0","-m 1048576","--direct-io","--drop-cache","-u","-u -q 128","-u --direct-io" \
+    'ddk_dev -p data -t 1 {options}'
+
+    hyperfine \
+    --export-markdown reports/benchmark_read_modes_cold_$6.md \
+    --prepare 'sync; echo 3 | sudo tee /proc/sys/vm/drop_caches' \
+    --runs 5 \
+    --parameter-list options "-m 0","-m 1048576","--direct-io","--drop-cache","-u","-u -q 128","-u --direct-io" \
+    'ddk_dev -p data -t 1 {options}'
+
+    rm -rf ./data
+
+    cat reports/benchmark_read_modes_cold_$6.md >> reports/benchmark_read_modes_warm_$6.md
+    mv reports/benchmark_read_modes_warm_$6.md reports/benchmark_read_modes_$6.md
+    sed -i "1i\Total test data size on disk: $total_test_data_size" reports/benchmark_read_modes_$6.md
+    sed -i "1i\Mode: $file_size (read modes, warm and cold page cache)" reports/benchmark_read_modes_$6.md
+}
+
 mkdir reports
 
 current_path="./data"
@@ -47,6 +191,7 @@ recursion_depth=1
 current_recursion_depth=0
 file_size="RANDOM"
 bench $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
+bench_threads $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
 
 current_path="./data"
 directories_per_depth=0
@@ -55,6 +200,7 @@ recursion_depth=0
 current_recursion_depth=0
 file_size="1GB"
 bench $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
+bench_hash_algorithms $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
 
 current_path="./data"
 directories_per_depth=10
@@ -63,6 +209,8 @@ recursion_depth=3
 current_recursion_depth=0
 file_size="1MB"
 bench $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
+bench_hash_threads $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
+bench_read_modes $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
 
 current_path="./data"
 directories_per_depth=10
@@ -71,12 +219,25 @@ recursion_depth=3
 current_recursion_depth=0
 file_size="1KB"
 bench $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
+bench_hash_threads $current_path $directories_per_depth $files_per_directory $recursion_depth $current_recursion_depth $file_size
 
 echo "# Benchmark Results 📊⏱️📐" >> reports/benchmark.md
 cat reports/benchmark_RANDOM.md >> reports/benchmark.md
 echo "" >> reports/benchmark.md
+cat reports/benchmark_threads_RANDOM.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
+cat reports/benchmark_scan_backend_RANDOM.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
 cat reports/benchmark_1GB.md >> reports/benchmark.md
 echo "" >> reports/benchmark.md
+cat reports/benchmark_hash_algorithms_1GB.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
 cat reports/benchmark_1MB.md >> reports/benchmark.md
 echo "" >> reports/benchmark.md
+cat reports/benchmark_hash_threads_1MB.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
+cat reports/benchmark_read_modes_1MB.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
 cat reports/benchmark_1KB.md >> reports/benchmark.md
+echo "" >> reports/benchmark.md
+cat reports/benchmark_hash_threads_1KB.md >> reports/benchmark.md
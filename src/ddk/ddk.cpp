@@ -1,11 +1,13 @@
 #include "filter/common.hpp"
 #include "fsinfo_parser.hpp"
+#include "verify/verification.hpp"
 #include "version.h"
 #include <algorithm>
 #include <cxxopts.hpp>
 #include <fmt/color.h>
 #include <fmt/core.h>
 #include <iostream>
+#include <memory>
 
 static void printVersion() { fmt::print("{}\n", DDK_VERSION); }
 
@@ -18,32 +20,106 @@ static void printResultsDedup(const DDK::FileSystemInfo *const fsinfo, const boo
         fmt::print("{}\n", DDK::FSInfoParser::summary(fsinfo));
     }
 
-    const std::string result = detailed ? DDK::FSInfoParser::FSinfoDuplicateListDetailed(fsinfo)
-                                        : DDK::FSInfoParser::FSinfoDuplicateList(fsinfo);
-    fmt::print("{}", result);
+    DDK::FSInfoParser::Sink sink;
+    if (detailed) {
+        DDK::FSInfoParser::FSinfoDuplicateListDetailed(sink, fsinfo);
+    } else {
+        DDK::FSInfoParser::FSinfoDuplicateList(sink, fsinfo);
+    }
 }
 
 static void printResultsDedupCompare(const DDK::FileSystemInfo *const fsinfo,
-                                     const DDK::FileSystemInfo *const compare,
+                                     const std::vector<const DDK::FileSystemInfo *> &compares,
                                      bool detailed) {
     if (detailed) {
-        fmt::print("{}\n", DDK::FSInfoParser::summary(fsinfo, compare));
+        fmt::print("{}\n", DDK::FSInfoParser::summary(fsinfo, compares));
     }
 
-    const std::string result = detailed
-                                   ? DDK::FSInfoParser::FSinfoDuplicateListDetailed(fsinfo, compare)
-                                   : DDK::FSInfoParser::FSinfoDuplicateList(fsinfo, compare);
-    fmt::print("{}", result);
+    DDK::FSInfoParser::Sink sink;
+    if (detailed) {
+        DDK::FSInfoParser::FSinfoDuplicateListDetailed(sink, fsinfo, compares);
+    } else {
+        DDK::FSInfoParser::FSinfoDuplicateList(sink, fsinfo, compares);
+    }
 }
 
-static std::filesystem::path getPathFromOption(const cxxopts::ParseResult &result,
-                                               const std::string option) {
-    std::filesystem::path sanitized_path;
+// safety prompt
+static bool confirmRemoval(const bool force) {
+    if (force) {
+        return true;
+    }
 
-    if (result.count(option) == 0) {
-        return std::filesystem::current_path().string();
+    std::string proceed = "";
+    do {
+        fmt::print(fmt::emphasis::bold | fg(fmt::color::red),
+                   "Do you want to you want to PERMANENTLY DELETE the listed duplicates? [y/n]: ");
+        std::cin >> proceed;
+    } while (!std::cin.fail() && proceed != "y" && proceed != "n");
+    return proceed == "y";
+}
+
+// symlinks are only kept if a group holds nothing else, see DDK::VERIFY::selectKeeper()
+static DDK::VERIFY::DuplicateGroup makeDuplicateGroup(std::vector<std::filesystem::path> files) {
+    const std::size_t keeper = DDK::VERIFY::selectKeeper(files);
+    DDK::VERIFY::DuplicateGroup group{files[keeper], {}};
+    for (std::size_t file = 0; file < files.size(); file++) {
+        if (file != keeper) {
+            group.candidates.push_back(std::move(files[file]));
+        }
+    }
+    return group;
+}
+
+// one file of every group is kept, the others are only removed if their bytes match it
+static void removeDuplicates(const std::vector<DDK::VERIFY::DuplicateGroup> &groups,
+                             const std::size_t threads) {
+    const DDK::VERIFY::Verification verification = DDK::VERIFY::verifyDuplicates(groups, threads);
+    for (const auto &path : verification.rejected) {
+        fmt::print(fmt::emphasis::bold | fg(fmt::color::yellow),
+                   "WARN: \"{}\" is not a verified copy of the file it duplicates and is not "
+                   "removed.\n",
+                   path.string());
     }
-    std::string path = result[option].as<std::string>();
+    for (const auto &path : verification.verified) {
+        std::filesystem::remove(path);
+    }
+
+    const double seconds = std::max(verification.seconds, 1e-9);
+    fmt::print("Removed {} verified duplicates: {} verified at {}/s\n",
+               verification.verified.size(),
+               DDK::FSInfoParser::humanReadableSize(verification.verifiedBytes),
+               DDK::FSInfoParser::humanReadableSize(
+                   static_cast<std::uintmax_t>(verification.verifiedBytes / seconds)));
+}
+
+static void saveHashCache(DDK::HASH::HashCache &cache,
+                          const std::string &path,
+                          const bool detailed) {
+    if (!cache.save()) {
+        fmt::print(fmt::emphasis::bold | fg(fmt::color::yellow),
+                   "WARN: Could not write hash cache \"{}\".\n", path);
+    }
+    if (detailed) {
+        fmt::print("Hash cache: {} hits, {} misses, {} entries\n", cache.getHits(),
+                   cache.getMisses(), cache.size());
+    }
+}
+
+static void saveSnapshot(DDK::SCAN::Snapshot &snapshot,
+                         const std::string &path,
+                         const bool detailed) {
+    if (!snapshot.save()) {
+        fmt::print(fmt::emphasis::bold | fg(fmt::color::yellow),
+                   "WARN: Could not write snapshot \"{}\".\n", path);
+    }
+    if (detailed) {
+        fmt::print("Snapshot: {} reused, {} listed directories\n", snapshot.getReusedCount(),
+                   snapshot.getListedCount());
+    }
+}
+
+static std::filesystem::path sanitizePath(std::string path) {
+    std::filesystem::path sanitized_path;
 
     const auto tilde = path.find('~');
     if (tilde != std::string::npos) {
@@ -65,6 +141,14 @@ static std::filesystem::path getPathFromOption(const cxxopts::ParseResult &resul
     return std::filesystem::canonical(sanitized_path);
 }
 
+static std::filesystem::path getPathFromOption(const cxxopts::ParseResult &result,
+                                               const std::string option) {
+    if (result.count(option) == 0) {
+        return std::filesystem::current_path().string();
+    }
+    return sanitizePath(result[option].as<std::string>());
+}
+
 int main(int argc, char *argv[]) {
     cxxopts::Options options(
         "ddk", "DeDuplicationKit (ddk) is a simple command line tool for finding duplicate files.");
@@ -74,11 +158,24 @@ int main(int argc, char *argv[]) {
         ("h,help", "Display this manual and exit", cxxopts::value<bool>()->default_value("false"))
         ("v,version", "Display semantic version of ddk", cxxopts::value<bool>()->default_value("false"))
         ("p,path", "Search for duplicates in specific path \"arg\". When no \"-p arg\" is specified, ddk will default to the current path.", cxxopts::value<std::string>())
-        ("c,compare", "Compare content of path \"-p arg\" with content of path \"-c arg\" and lists all duplicates of files within path \"-c arg\" that are found within path \"-p arg\" and are not within path \"-c arg\"", cxxopts::value<std::string>())
+        ("c,compare", "Compare content of path \"-p arg\" with content of path \"-c arg\" and lists all duplicates of files within path \"-c arg\" that are found within path \"-p arg\" and are not within path \"-c arg\". Can be given up to 15 times to compare with several paths at once, every file is still read only once.", cxxopts::value<std::vector<std::string>>())
         ("d,detailed", "Show detailed information about deduplication scan", cxxopts::value<bool>()->default_value("false"))
         ("l,symlinks", "Follow symbolic links during deduplication scan", cxxopts::value<bool>()->default_value("false"))
-        ("r,remove", "Remove duplicates (PERMANENTLY DELETES FILES! USE WITH CAUTION!)", cxxopts::value<bool>()->default_value("false"))
+        ("r,remove", "Remove duplicates but keep the first file of every group. Files are compared byte by byte with the kept file before they are deleted (PERMANENTLY DELETES FILES! USE WITH CAUTION!)", cxxopts::value<bool>()->default_value("false"))
         ("f,force", "Skip user prompt for asking if you really want to delete all duplicates and start deleting files immediately. Can only be used together with option \"-r\".", cxxopts::value<bool>()->default_value("false"))
+        ("t,threads", "Number of threads used for scanning directories and hashing files. \"-t 0\" uses all available hardware threads.", cxxopts::value<std::size_t>()->default_value("0"))
+        ("u,io-uring", "Batch metadata requests during scans and keep many file reads in flight while hashing with io_uring. Falls back to regular system calls if io_uring is not supported by the kernel.", cxxopts::value<bool>()->default_value("false"))
+        ("q,queue-depth", "Number of file reads every hashing thread keeps in flight with \"-u\". Must be between 1 and 1024.", cxxopts::value<unsigned int>()->default_value("32"))
+        ("a,algorithm", "Hash algorithm used for comparing file contents: \"xxh64\", \"xxh3-64\" or \"xxh3-128\". 64 bit hashes are faster but more likely to report different files as duplicates on very large file sets.", cxxopts::value<std::string>()->default_value("xxh3-128"))
+        ("e,exact", "Compare files of equal size byte by byte in lockstep instead of comparing hashes. Only reports files with identical content.", cxxopts::value<bool>()->default_value("false"))
+        ("b,block-size", "Size in KiB of the first and last block of a file that are hashed before its whole content. Files larger than \"-s arg\" that differ within these blocks are never read completely. Must be between 4 and 64.", cxxopts::value<std::size_t>()->default_value("16"))
+        ("s,single-read-size", "Size in KiB up to which files are hashed completely with a single read instead of block by block.", cxxopts::value<std::uintmax_t>()->default_value("64"))
+        ("m,mmap-threshold", "Size in KiB from which files are memory mapped for hashing. Smaller files are read into a reused buffer.", cxxopts::value<std::uintmax_t>()->default_value("1024"))
+        ("cache", "Keep content hashes in the cache file \"arg\" and only read files that changed since their hashes were cached. Hashes of other hash options are dropped.", cxxopts::value<std::string>())
+        ("compact-cache", "Remove entries of files that were not seen within \"arg\" days from the cache file of \"--cache\" and exit.", cxxopts::value<unsigned int>())
+        ("snapshot", "Keep directory listings in the snapshot file \"arg\" and only list directories again whose entries changed since the last scan. Files modified in place keep their previous size in the totals until an entry of their directory changes, but are never reported as duplicates while their size differs.", cxxopts::value<std::string>())
+        ("direct-io", "Read files with O_DIRECT and bypass the page cache where the file system supports it. Files are never memory mapped.", cxxopts::value<bool>()->default_value("false"))
+        ("drop-cache", "Drop hashed files from the page cache after reading them. Files are never memory mapped.", cxxopts::value<bool>()->default_value("false"))
         ;
     // clang-format on
 
@@ -92,8 +189,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // do not allow duplicate options
-    for (const auto &option : {"h", "v", "p", "c", "d", "l", "r", "f"}) {
+    // do not allow duplicate options, only "-c" may be given several times
+    for (const auto &option : {"h", "v", "p", "d", "l", "r", "f", "t", "u", "q", "a", "e", "b", "s",
+                               "m", "cache", "compact-cache", "snapshot", "direct-io",
+                               "drop-cache"}) {
         if (result.count(option) > 1) {
             printInvalidOptions();
             return 1;
@@ -112,84 +211,204 @@ int main(int argc, char *argv[]) {
 
     const bool analyze_symLinks = result["l"].as<bool>();
     const bool detailed = result["d"].as<bool>();
-    const bool compare = result.count("c") == 1;
+    const bool compare = result.count("c") > 0;
     const bool remove = result["r"].as<bool>();
     const bool remove_force = result["f"].as<bool>();
-    const std::filesystem::path path = getPathFromOption(result, "p");
-    const DDK::FileSystemInfo fsinfo(path, analyze_symLinks);
-    const DDK::FileSystemInfo *fsinfo_compare;
+    const std::size_t threads = result["t"].as<std::size_t>();
+    const DDK::SCAN::Backend scan_backend =
+        result["u"].as<bool>() ? DDK::SCAN::Backend::IO_URING : DDK::SCAN::Backend::DEFAULT;
+    const unsigned int queue_depth = result["q"].as<unsigned int>();
+    if (queue_depth < 1 || queue_depth > 1024) {
+        printInvalidOptions();
+        return 1;
+    }
+    const bool exact = result["e"].as<bool>();
+    const std::size_t block_size = result["b"].as<std::size_t>();
+    if (block_size < 4 || block_size > 64) {
+        printInvalidOptions();
+        return 1;
+    }
+    const auto algorithm = DDK::HASH::parseAlgorithm(result["a"].as<std::string>());
+    if (!algorithm) {
+        printInvalidOptions();
+        return 1;
+    }
+    DDK::FILTER::DEDUPLICATION::HashStages hash_stages;
+    hash_stages.headBytes = block_size * 1024;
+    hash_stages.tailBytes = block_size * 1024;
+    hash_stages.singleReadThreshold = result["s"].as<std::uintmax_t>() * 1024;
+    hash_stages.algorithm = *algorithm;
+    hash_stages.mappedReadThreshold = result["m"].as<std::uintmax_t>() * 1024;
+    hash_stages.readOptions.directIo = result["direct-io"].as<bool>();
+    hash_stages.readOptions.dropCache = result["drop-cache"].as<bool>();
+    if (scan_backend == DDK::SCAN::Backend::IO_URING) {
+        hash_stages.ioUringQueueDepth = queue_depth;
+    }
 
-    if (compare) {
-        const std::filesystem::path path_compare = getPathFromOption(result, "c");
-        if (path == path_compare) {
-            fmt::print(fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::red),
-                       "ERROR: If you want to find duplicates in one directory use \"-p\" only.\n");
+    // opened with the final hash options, since they decide which cached hashes are valid
+    std::unique_ptr<DDK::HASH::HashCache> hash_cache;
+    const std::string hash_cache_path =
+        result.count("cache") == 1 ? result["cache"].as<std::string>() : "";
+    if (!hash_cache_path.empty()) {
+        hash_cache = std::make_unique<DDK::HASH::HashCache>(
+            hash_cache_path, DDK::FILTER::DEDUPLICATION::getCacheConfiguration(hash_stages));
+        hash_stages.cache = hash_cache.get();
+    }
+    if (result.count("compact-cache") == 1) {
+        if (!hash_cache) {
+            printInvalidOptions();
             return 1;
         }
-
-        if (DDK::FILTER::COMMON::is_in_sub_directory(path, path_compare)) {
-            fmt::print(fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::red),
-                       "ERROR: Cannot compare \"{}\" to a parent directory \"{}\". This would "
-                       "result in 0 duplicates found.\n",
-                       path.string(), path_compare.string());
+        const auto removed = hash_cache->compact(
+            std::chrono::hours(24) * result["compact-cache"].as<unsigned int>());
+        if (!removed) {
+            fmt::print("ERROR: Could not write hash cache \"{}\".\n", hash_cache_path);
             return 1;
         }
+        fmt::print("Removed {} hash cache entries.\n", *removed);
+        return 0;
+    }
+
+    const std::filesystem::path path = getPathFromOption(result, "p");
+
+    std::unique_ptr<DDK::SCAN::Snapshot> snapshot;
+    const std::string snapshot_path =
+        result.count("snapshot") == 1 ? result["snapshot"].as<std::string>() : "";
+    if (!snapshot_path.empty()) {
+        snapshot = std::make_unique<DDK::SCAN::Snapshot>(snapshot_path, analyze_symLinks);
+    }
+
+    // a plain duplicate list does not need the item tree, files are bucketed while scanning
+    if (!compare && !detailed && !exact) {
+        const DDK::STREAM::StreamingDeduplication dedup(path, analyze_symLinks, threads,
+                                                        scan_backend, hash_stages,
+                                                        snapshot.get());
+        {
+            DDK::FSInfoParser::Sink sink;
+            DDK::FSInfoParser::FSinfoDuplicateList(sink, &dedup);
+        }
+        if (hash_cache) {
+            saveHashCache(*hash_cache, hash_cache_path, detailed);
+        }
+        if (snapshot) {
+            saveSnapshot(*snapshot, snapshot_path, detailed);
+        }
+
+        if (remove && confirmRemoval(remove_force)) {
+            std::vector<DDK::VERIFY::DuplicateGroup> groups;
+            std::size_t range_start = 0;
+            for (const std::size_t range : dedup.getDuplicateRanges()) {
+                std::vector<std::filesystem::path> files;
+                for (std::size_t i = range_start; i < range_start + range; i++) {
+                    files.push_back(dedup.getDuplicatePath(i));
+                }
+                groups.push_back(makeDuplicateGroup(std::move(files)));
+                range_start += range;
+            }
+            removeDuplicates(groups, threads);
+        }
+        return 0;
+    }
+
+    DDK::FileSystemInfo fsinfo(path, analyze_symLinks, threads, scan_backend, snapshot.get());
+    fsinfo.setHashStages(hash_stages);
+    if (exact) {
+        fsinfo.setEngine(DDK::FILTER::DEDUPLICATION::Engine::LOCKSTEP);
+    }
+    std::vector<std::unique_ptr<const DDK::FileSystemInfo>> fsinfo_compares;
+    std::vector<const DDK::FileSystemInfo *> compares;
 
-        if (DDK::FILTER::COMMON::is_in_sub_directory(path_compare, path)) {
-            fmt::print(
-                fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::yellow),
-                "WARN: Comparing to a subdirectory will only list duplicates within the path "
-                "\"-p\" that are not within the path \"-c\". So here only duplicates found "
-                "within \"{}\" that are not located within \"{}\" are listed.",
-                path.string(), path_compare.string());
-            fmt::print("\n");
+    if (compare) {
+        const auto compare_options = result["c"].as<std::vector<std::string>>();
+        if (compare_options.size() > DDK::FileSystemInfo::MAX_COMPARES) {
+            printInvalidOptions();
+            return 1;
         }
 
-        fsinfo_compare = new DDK::FileSystemInfo(path_compare, analyze_symLinks);
-        printResultsDedupCompare(&fsinfo, fsinfo_compare, detailed);
+        for (const std::string &compare_option : compare_options) {
+            const std::filesystem::path path_compare = sanitizePath(compare_option);
+            if (path == path_compare) {
+                fmt::print(
+                    fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::red),
+                    "ERROR: If you want to find duplicates in one directory use \"-p\" only.\n");
+                return 1;
+            }
+
+            if (DDK::FILTER::COMMON::is_in_sub_directory(path, path_compare)) {
+                fmt::print(fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::red),
+                           "ERROR: Cannot compare \"{}\" to a parent directory \"{}\". This would "
+                           "result in 0 duplicates found.\n",
+                           path.string(), path_compare.string());
+                return 1;
+            }
+
+            if (DDK::FILTER::COMMON::is_in_sub_directory(path_compare, path)) {
+                fmt::print(
+                    fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::yellow),
+                    "WARN: Comparing to a subdirectory will only list duplicates within the path "
+                    "\"-p\" that are not within the path \"-c\". So here only duplicates found "
+                    "within \"{}\" that are not located within \"{}\" are listed.",
+                    path.string(), path_compare.string());
+                fmt::print("\n");
+            }
+
+            fsinfo_compares.push_back(std::make_unique<const DDK::FileSystemInfo>(
+                path_compare, analyze_symLinks, threads, scan_backend, snapshot.get()));
+            compares.push_back(fsinfo_compares.back().get());
+        }
+        printResultsDedupCompare(&fsinfo, compares, detailed);
     } else {
         printResultsDedup(&fsinfo, detailed);
     }
+    if (hash_cache) {
+        saveHashCache(*hash_cache, hash_cache_path, detailed);
+    }
+    if (snapshot) {
+        saveSnapshot(*snapshot, snapshot_path, detailed);
+    }
 
     // TODO: store duplicates in ddk main to prevent recalculation during delete
 
     // TODO: Check if any duplicates were found before trying to delete
     if (remove) {
-        // safety prompt
-        if (!remove_force) {
-            std::string proceed = "";
-            do {
-                fmt::print(
-                    fmt::emphasis::bold | fg(fmt::color::red),
-                    "Do you want to you want to PERMANENTLY DELETE the listed duplicates? [y/n]: ");
-                std::cin >> proceed;
-            } while (!std::cin.fail() && proceed != "y" && proceed != "n");
-            if (proceed != "y") {
-                return 0;
-            }
+        if (!confirmRemoval(remove_force)) {
+            return 0;
         }
 
         // remove duplicates
+        std::vector<DDK::VERIFY::DuplicateGroup> groups;
         if (compare) {
-            const auto duplicates = fsinfo.getDuplicatesFromCompare(fsinfo_compare);
+            // files within the compared paths are kept
+            const auto duplicates = fsinfo.getDuplicatesFromCompare(compares);
             for (const auto duplicate : duplicates) {
+                DDK::VERIFY::DuplicateGroup group;
+                std::vector<std::filesystem::path> keepers;
                 for (const auto fsi : duplicate) {
-                    if (!DDK::FILTER::COMMON::is_in_sub_directory(fsi->getPath(),
-                                                                  fsinfo_compare->getRootPath())) {
-                        std::filesystem::remove(fsi->getPath());
+                    if ((fsi->getOrigins() & DDK::FileSystemInfo::COMPARE_ORIGINS) == 0) {
+                        group.candidates.push_back(fsi->getPath());
+                    } else {
+                        keepers.push_back(fsi->getPath());
                     }
                 }
+                if (!keepers.empty()) {
+                    group.keeper = keepers[DDK::VERIFY::selectKeeper(keepers)];
+                    groups.push_back(std::move(group));
+                }
             }
         } else {
             const auto &[items, ranges] = fsinfo.getDuplicates();
-            for (const auto &item : items) {
-                std::filesystem::remove(item->getPath());
+            std::size_t range_start = 0;
+            for (const std::size_t range : ranges) {
+                std::vector<std::filesystem::path> files;
+                for (std::size_t i = range_start; i < range_start + range; i++) {
+                    files.push_back(items.at(i)->getPath());
+                }
+                groups.push_back(makeDuplicateGroup(std::move(files)));
+                range_start += range;
             }
         }
+        removeDuplicates(groups, threads);
     }
 
-    if (compare) {
-        delete fsinfo_compare;
-    }
     return 0;
 }
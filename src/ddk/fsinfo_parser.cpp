@@ -1,9 +1,21 @@
 #include "fsinfo_parser.hpp"
 #include "filter/common.hpp"
+#include "filter/deduplication.hpp"
 #include <cmath>
 #include <sstream>
+#include <unordered_set>
 
 namespace DDK::FSInfoParser {
+Sink::Sink(std::FILE *file) : m_file(file) {}
+
+Sink::~Sink() { flush(); }
+
+void Sink::flush() {
+    std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+    std::fflush(m_file);
+    m_buffer.clear();
+}
+
 std::string humanReadableSize(std::uintmax_t size) {
     double mantissa = size;
     int i = 0;
@@ -17,6 +29,11 @@ std::string humanReadableSize(std::uintmax_t size) {
     return stream.str();
 }
 
+// item of getDuplicatesFromCompare() within any compared path
+bool isWithinCompare(const DDK::FileSystemItem *item) {
+    return (item->getOrigins() & DDK::FileSystemInfo::COMPARE_ORIGINS) != 0;
+}
+
 // pass std pair here
 std::string getItemInfo(DDK::FileSystemItem *item, bool tag, bool fullPath) {
     std::string itemInfo = tag ? "[*] " : "[ ] ";
@@ -42,28 +59,41 @@ std::string getItemInfo(DDK::FileSystemItem *item, bool tag, bool fullPath) {
     return itemInfo;
 }
 
-std::string getDuplicateGroups(
-    const std::vector<std::pair<DDK::FileSystemItem *, bool>> &duplicates) {
-    std::string duplicateInfo{};
-
-    duplicateInfo +=
-        "Duplicate Group with " + std::to_string(duplicates.size()) + " duplicates detected: " +
-        humanReadableSize(duplicates.front().first->getSizeInBytes() * duplicates.size()) + " [" +
-        std::to_string(duplicates.size()) + " x " +
-        humanReadableSize(duplicates.front().first->getSizeInBytes()) + "]\n";
-    for (const auto duplicate : duplicates) {
-        duplicateInfo += getItemInfo(duplicate.first, duplicate.second, true) + "\n";
+// hard links of a file are listed but only occupy the space of a single copy
+std::string getDuplicateGroupHeader(std::size_t duplicates,
+                                    std::size_t copies,
+                                    std::uintmax_t size) {
+    std::string header = "Duplicate Group with " + std::to_string(duplicates) +
+                         " duplicates detected: " + humanReadableSize(size * copies) + " [" +
+                         std::to_string(copies) + " x " + humanReadableSize(size) + "]";
+    if (copies < duplicates) {
+        const std::size_t links = duplicates - copies;
+        header += " + " + std::to_string(links) + (links == 1 ? " hard link" : " hard links");
     }
+    return header + "\n";
+}
 
-    return duplicateInfo;
+void printDuplicateGroup(Sink &sink,
+                         const std::vector<std::pair<DDK::FileSystemItem *, bool>> &duplicates) {
+    std::vector<DDK::FileSystemItem *> items{};
+    for (const auto &duplicate : duplicates) {
+        items.push_back(duplicate.first);
+    }
+    sink.print("{}", getDuplicateGroupHeader(duplicates.size(),
+                                             FILTER::DEDUPLICATION::countDistinctFiles(items),
+                                             duplicates.front().first->getSizeInBytes()));
+    for (const auto &duplicate : duplicates) {
+        sink.print("{}\n", getItemInfo(duplicate.first, duplicate.second, true));
+    }
 }
 
+// duplicates of getDuplicatesFromCompare() outside of the compared paths are tagged deletable
 std::vector<std::pair<DDK::FileSystemItem *, bool>> deletableDuplicates(
-    std::vector<DDK::FileSystemItem *> duplicates, const std::filesystem::path &path_compare_root) {
+    std::vector<DDK::FileSystemItem *> duplicates) {
     DDK::FILTER::COMMON::sortFSitemsByPathLexicographically(duplicates);
     std::vector<std::pair<DDK::FileSystemItem *, bool>> duplicatesTagged{};
     for (const auto &duplicate : duplicates) {
-        if (!DDK::FILTER::COMMON::is_in_sub_directory(duplicate->getPath(), path_compare_root)) {
+        if (!isWithinCompare(duplicate)) {
             duplicatesTagged.push_back(std::make_pair(duplicate, true));
         } else {
             duplicatesTagged.push_back(std::make_pair(duplicate, false));
@@ -72,45 +102,55 @@ std::vector<std::pair<DDK::FileSystemItem *, bool>> deletableDuplicates(
     return duplicatesTagged;
 }
 
-std::string getDuplicateListFromCompare(const std::vector<DDK::FileSystemItem *> &duplicates,
-                                        const std::filesystem::path &path_compare_root) {
-    std::string duplicateInfo{};
-
-    for (const auto &duplicate : deletableDuplicates(duplicates, path_compare_root)) {
+void printDuplicateListFromCompare(Sink &sink,
+                                   const std::vector<DDK::FileSystemItem *> &duplicates) {
+    for (const auto &duplicate : deletableDuplicates(duplicates)) {
         if (duplicate.second) {
-            duplicateInfo += duplicate.first->getPathAsString() + "\n";
+            sink.print("{}\n", duplicate.first->getPathAsString());
         }
     }
-    return duplicateInfo;
 }
 
-std::string FSinfoDuplicateList(const DDK::FileSystemInfo *const fsinfo) {
-    std::string result{};
+void FSinfoDuplicateList(Sink &sink, const DDK::FileSystemInfo *const fsinfo) {
     const auto &[items, ranges] = fsinfo->getDuplicates();
     for (const auto &item : items) {
-        result += item->getPathAsString() + "\n";
+        sink.print("{}\n", item->getPathAsString());
     }
-    return result;
 }
 
-std::string FSinfoDuplicateList(const DDK::FileSystemInfo *const fsinfo,
-                                const DDK::FileSystemInfo *const compare) {
-    std::string result{};
-    auto duplicates = fsinfo->getDuplicatesFromCompare(compare);
-
-    for (const auto duplicate : duplicates) {
-        result += getDuplicateListFromCompare(duplicate, compare->getRootPath());
+void FSinfoDuplicateList(Sink &sink, const DDK::STREAM::StreamingDeduplication *const dedup) {
+    for (std::size_t i = 0; i < dedup->getDuplicatesCount(); i++) {
+        sink.print("{}\n", dedup->getDuplicatePath(i).string());
     }
+}
 
-    return result;
+void FSinfoDuplicateList(Sink &sink,
+                         const DDK::FileSystemInfo *const fsinfo,
+                         const std::vector<const DDK::FileSystemInfo *> &compares) {
+    for (const auto &duplicate : fsinfo->getDuplicatesFromCompare(compares)) {
+        printDuplicateListFromCompare(sink, duplicate);
+    }
 }
 
-std::uint64_t redundant_size(const std::vector<std::vector<DDK::FileSystemItem *>> &duplicates,
-                             const std::filesystem::path &compare_path) {
+std::uint64_t redundant_size(const std::vector<std::vector<DDK::FileSystemItem *>> &duplicates) {
     std::uint64_t redundant_data_size = 0;
     for (const auto duplicate : duplicates) {
+        // removing a link of a file that stays within a compared path frees no space
+        std::unordered_set<SCAN::FileId, SCAN::FileIdHash> kept_files{};
+        for (const auto fsi : duplicate) {
+            if (isWithinCompare(fsi)) {
+                kept_files.insert(fsi->getFileId());
+            }
+        }
+
+        std::unordered_set<SCAN::FileId, SCAN::FileIdHash> counted_files{};
         for (const auto fsi : duplicate) {
-            if (!FILTER::COMMON::is_in_sub_directory(fsi->getPath(), compare_path)) {
+            const SCAN::FileId file_id = fsi->getFileId();
+            if (isWithinCompare(fsi)) {
+                continue;
+            }
+            if (!file_id.isHardlinked() ||
+                (kept_files.count(file_id) == 0 && counted_files.insert(file_id).second)) {
                 redundant_data_size += fsi->getSizeInBytes();
             }
         }
@@ -118,68 +158,156 @@ std::uint64_t redundant_size(const std::vector<std::vector<DDK::FileSystemItem *
     return redundant_data_size;
 }
 
-std::string parseDuplicatesDetailed(
+// the totals lead the report, so they are counted before any group is printed
+void printDuplicatesDetailed(
+    Sink &sink,
     const std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> &duplicates) {
-    std::string result{};
     const auto &[items, ranges] = duplicates;
 
     if (items.empty()) {
-        return "No duplicates found!\n";
+        sink.print("No duplicates found!\n");
+        return;
     }
 
     std::uint64_t redundant_data_size = 0;
-    std::string duplicateInfo{};
-
+    std::vector<std::size_t> copies(ranges.size());
     std::size_t range_start = 0;
     for (std::size_t range = 0; range < ranges.size(); range++) {
-        std::size_t range_end = range_start + ranges.at(range);
-        redundant_data_size += (ranges.at(range) - 1) * items.at(range_start)->getSizeInBytes();
+        const std::size_t range_end = range_start + ranges.at(range);
+        copies[range] = FILTER::DEDUPLICATION::countDistinctFiles(
+            {items.begin() + range_start, items.begin() + range_end});
+        redundant_data_size += (copies[range] - 1) * items.at(range_start)->getSizeInBytes();
+        range_start = range_end;
+    }
 
-        duplicateInfo +=
-            "Duplicate Group with " + std::to_string(ranges.at(range)) + " duplicates detected: " +
-            humanReadableSize(items.at(range_start)->getSizeInBytes() * ranges.at(range)) + " [" +
-            std::to_string(ranges.at(range)) + " x " +
-            humanReadableSize(items.at(range_start)->getSizeInBytes()) + "]\n";
+    sink.print("Duplicate Groups found: {}\nRedundant data: {}\n\n", ranges.size(),
+               humanReadableSize(redundant_data_size));
 
-        duplicateInfo += getItemInfo(items.at(range_start), false, false) + "\n";
+    range_start = 0;
+    for (std::size_t range = 0; range < ranges.size(); range++) {
+        const std::size_t range_end = range_start + ranges.at(range);
+        sink.print("{}", getDuplicateGroupHeader(ranges.at(range), copies[range],
+                                                 items.at(range_start)->getSizeInBytes()));
+
+        sink.print("{}\n", getItemInfo(items.at(range_start), false, false));
         for (std::size_t i = range_start + 1; i < range_end; i++) {
-            duplicateInfo += getItemInfo(items.at(i), true, false) + "\n";
+            sink.print("{}\n", getItemInfo(items.at(i), true, false));
         }
         range_start = range_end;
     }
+}
 
-    return "Duplicate Groups found: " + std::to_string(ranges.size()) + "\n" +
-           "Redundant data: " + humanReadableSize(redundant_data_size) + "\n\n" + result;
+void printHardlinksDetailed(
+    Sink &sink,
+    const std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> &hardlinks) {
+    const auto &[items, ranges] = hardlinks;
+
+    if (items.empty()) {
+        return;
+    }
+
+    std::uintmax_t shared_data_size = 0;
+    std::size_t range_start = 0;
+    for (const std::size_t range : ranges) {
+        shared_data_size += (range - 1) * items.at(range_start)->getSizeInBytes();
+        range_start += range;
+    }
+
+    sink.print("\nHardlink Groups found: {}\nData shared by hard links: {}\n\n", ranges.size(),
+               humanReadableSize(shared_data_size));
+
+    range_start = 0;
+    for (const std::size_t range : ranges) {
+        sink.print("Hardlink Group with {} links to the same file: {}\n", range,
+                   humanReadableSize(items.at(range_start)->getSizeInBytes()));
+        for (std::size_t i = range_start; i < range_start + range; i++) {
+            sink.print("{}\n", getItemInfo(items.at(i), false, true));
+        }
+        range_start += range;
+    }
 }
 
-std::string parseDuplicatesDetailedCompare(
-    const std::vector<std::vector<DDK::FileSystemItem *>> &duplicates,
-    const std::filesystem::path &compare_path) {
-    std::string result{};
+std::string parseHashStatistics(const FILTER::DEDUPLICATION::HashStatistics &statistics) {
+    using FILTER::DEDUPLICATION::HashStage;
+    // nothing was hashed or files were compared byte by byte
+    if (statistics.hashedFiles[static_cast<std::size_t>(HashStage::HEAD)] == 0) {
+        return "";
+    }
+
+    const auto stageInfo = [&statistics](HashStage stage, const std::string &name) {
+        const auto i = static_cast<std::size_t>(stage);
+        return "Data read by " + name + " hashes: " + humanReadableSize(statistics.hashedBytes[i]) +
+               " [" + std::to_string(statistics.hashedFiles[i]) + " files]\n";
+    };
+
+    return "\n" + stageInfo(HashStage::HEAD, "head") + stageInfo(HashStage::TAIL, "tail") +
+           stageInfo(HashStage::FULL, "full") + "Data skipped by head hashes: " +
+           humanReadableSize(statistics.savedBytes[static_cast<std::size_t>(HashStage::HEAD)]) +
+           "\n" + "Data skipped by tail hashes: " +
+           humanReadableSize(statistics.savedBytes[static_cast<std::size_t>(HashStage::TAIL)]) +
+           "\n";
+}
+
+// compared paths that contain items of a duplicate group
+std::string getComparedPaths(const std::vector<DDK::FileSystemItem *> &duplicates,
+                             const std::vector<const DDK::FileSystemInfo *> &compares) {
+    FileTable::Origins origins = 0;
+    for (const auto fsi : duplicates) {
+        origins |= fsi->getOrigins();
+    }
+
+    std::string paths{};
+    for (std::size_t compare = 0; compare < compares.size(); compare++) {
+        if ((origins & DDK::FileSystemInfo::getCompareOrigin(compare)) != 0) {
+            paths += (paths.empty() ? "" : ", ") + compares[compare]->getRootPath().string();
+        }
+    }
+    return "Found within compared paths: " + paths + "\n";
+}
 
+void printDuplicatesDetailedCompare(
+    Sink &sink,
+    const std::vector<std::vector<DDK::FileSystemItem *>> &duplicates,
+    const std::vector<const DDK::FileSystemInfo *> &compares) {
     if (duplicates.empty()) {
-        return "No duplicates found!\n";
-    } else {
-        result += "Duplicate Groups found: " + std::to_string(duplicates.size()) + "\n";
-        result += "Redundant data: " + humanReadableSize(redundant_size(duplicates, compare_path)) +
-                  "\n\n";
+        sink.print("No duplicates found!\n");
+        return;
     }
+    sink.print("Duplicate Groups found: {}\nRedundant data: {}\n\n", duplicates.size(),
+               humanReadableSize(redundant_size(duplicates)));
 
-    for (const auto duplicate : duplicates) {
-        result += getDuplicateGroups(deletableDuplicates(duplicate, compare_path)) + "\n";
+    for (const auto &duplicate : duplicates) {
+        printDuplicateGroup(sink, deletableDuplicates(duplicate));
+        // with a single compared path every group is found within it
+        if (compares.size() > 1) {
+            sink.print("{}", getComparedPaths(duplicate, compares));
+        }
+        sink.print("\n");
     }
+}
 
-    return result;
+void FSinfoDuplicateListDetailed(Sink &sink, const DDK::FileSystemInfo *const fsinfo) {
+    printDuplicatesDetailed(sink, fsinfo->getDuplicates());
+    printHardlinksDetailed(sink, fsinfo->getHardlinks());
+    sink.print("{}", parseHashStatistics(fsinfo->getHashStatistics()));
 }
 
-std::string FSinfoDuplicateListDetailed(const DDK::FileSystemInfo *const fsinfo) {
-    return parseDuplicatesDetailed(fsinfo->getDuplicates());
+void FSinfoDuplicateListDetailed(Sink &sink,
+                                 const DDK::FileSystemInfo *const fsinfo,
+                                 const std::vector<const DDK::FileSystemInfo *> &compares) {
+    printDuplicatesDetailedCompare(sink, fsinfo->getDuplicatesFromCompare(compares), compares);
+    sink.print("{}", parseHashStatistics(fsinfo->getHashStatistics()));
 }
 
-std::string FSinfoDuplicateListDetailed(const DDK::FileSystemInfo *const fsinfo,
-                                        const DDK::FileSystemInfo *const compare) {
-    return parseDuplicatesDetailedCompare(fsinfo->getDuplicatesFromCompare(compare),
-                                          compare->getRootPath());
+std::string memoryUsage(const std::vector<const DDK::FileSystemInfo *> &fsinfos) {
+    std::size_t memory = 0;
+    std::size_t items = 0;
+    for (const auto fsinfo : fsinfos) {
+        memory += fsinfo->getMemoryUsage();
+        items += fsinfo->getFilesCount() + fsinfo->getDirectoriesCount();
+    }
+    return "Memory used for analyzed items: " + humanReadableSize(memory) + " [" +
+           std::to_string(items > 0 ? memory / items : 0) + " bytes per item]\n";
 }
 
 std::string summary(const DDK::FileSystemInfo *const fsinfo) {
@@ -193,29 +321,40 @@ std::string summary(const DDK::FileSystemInfo *const fsinfo) {
     }
 
     result += "Analyzed data: " + humanReadableSize(fsinfo->getTotalSize()) + "\n";
+    result += memoryUsage({fsinfo});
 
     return result;
 }
 
 std::string summary(const DDK::FileSystemInfo *const fsinfo,
-                    const DDK::FileSystemInfo *const compare) {
-    std::string result = "Searching for duplicates of:\n" + compare->getRootPath().string() + "\n";
+                    const std::vector<const DDK::FileSystemInfo *> &compares) {
+    std::string result = "Searching for duplicates of:\n";
+    std::vector<const DDK::FileSystemInfo *> fsinfos{fsinfo};
+    for (const auto compare : compares) {
+        result += compare->getRootPath().string() + "\n";
+        fsinfos.push_back(compare);
+    }
     result += "in path:\n" + fsinfo->getRootPath().string() + "\n\n";
 
-    result +=
-        "Analyzed files: " + std::to_string(fsinfo->getFilesCount() + compare->getFilesCount()) +
-        "\n";
-    result += "Analyzed subdirectories: " +
-              std::to_string(fsinfo->getDirectoriesCount() + compare->getDirectoriesCount()) + "\n";
+    std::size_t files = 0;
+    std::size_t directories = 0;
+    std::size_t symlinks = 0;
+    std::uintmax_t size = 0;
+    for (const auto analyzed : fsinfos) {
+        files += analyzed->getFilesCount();
+        directories += analyzed->getDirectoriesCount();
+        symlinks += analyzed->getSymlinksCount();
+        size += analyzed->getTotalSize();
+    }
+    result += "Analyzed files: " + std::to_string(files) + "\n";
+    result += "Analyzed subdirectories: " + std::to_string(directories) + "\n";
 
     if (fsinfo->symlinks()) {
-        result += "Analyzed symlinks: " +
-                  std::to_string(fsinfo->getSymlinksCount() + compare->getSymlinksCount()) + "\n";
+        result += "Analyzed symlinks: " + std::to_string(symlinks) + "\n";
     }
 
-    result +=
-        "Analyzed data: " + humanReadableSize(fsinfo->getTotalSize() + compare->getTotalSize()) +
-        "\n";
+    result += "Analyzed data: " + humanReadableSize(size) + "\n";
+    result += memoryUsage(fsinfos);
 
     return result;
 }
@@ -1,15 +1,47 @@
 #include "fsinfo.hpp"
+#include "stream/streaming_deduplication.hpp"
+
+#include <cstdio>
+#include <fmt/format.h>
+#include <iterator>
 
 namespace DDK::FSInfoParser {
+// formats a report into a buffer that is written to file in large chunks
+class Sink {
+  public:
+    static constexpr std::size_t FLUSH_SIZE = 64 * 1024;
+
+    explicit Sink(std::FILE *file = stdout);
+    ~Sink();
+
+    Sink(const Sink &) = delete;
+    Sink &operator=(const Sink &) = delete;
+
+    template <typename... Args> void print(fmt::format_string<Args...> format, Args &&...args) {
+        fmt::format_to(std::back_inserter(m_buffer), format, std::forward<Args>(args)...);
+        if (m_buffer.size() >= FLUSH_SIZE) {
+            flush();
+        }
+    }
+    void flush();
+
+  private:
+    fmt::memory_buffer m_buffer;
+    std::FILE *const m_file;
+};
+
 std::string humanReadableSize(std::uintmax_t size);
 std::string getItemInfo(const DDK::FileSystemItem *item, bool fullPath = false);
-std::string FSinfoDuplicateList(const DDK::FileSystemInfo *const fsinfo);
-std::string FSinfoDuplicateList(const DDK::FileSystemInfo *const fsinfo,
-                                const DDK::FileSystemInfo *const compare);
-std::string FSinfoDuplicateListDetailed(const DDK::FileSystemInfo *const fsinfo);
-std::string FSinfoDuplicateListDetailed(const DDK::FileSystemInfo *const fsinfo,
-                                        const DDK::FileSystemInfo *const compare);
+void FSinfoDuplicateList(Sink &sink, const DDK::FileSystemInfo *const fsinfo);
+void FSinfoDuplicateList(Sink &sink, const DDK::STREAM::StreamingDeduplication *const dedup);
+void FSinfoDuplicateList(Sink &sink,
+                         const DDK::FileSystemInfo *const fsinfo,
+                         const std::vector<const DDK::FileSystemInfo *> &compares);
+void FSinfoDuplicateListDetailed(Sink &sink, const DDK::FileSystemInfo *const fsinfo);
+void FSinfoDuplicateListDetailed(Sink &sink,
+                                 const DDK::FileSystemInfo *const fsinfo,
+                                 const std::vector<const DDK::FileSystemInfo *> &compares);
 std::string summary(const DDK::FileSystemInfo *const fsinfo);
 std::string summary(const DDK::FileSystemInfo *const fsinfo,
-                    const DDK::FileSystemInfo *const compare);
+                    const std::vector<const DDK::FileSystemInfo *> &compares);
 } // namespace DDK::FSInfoParser
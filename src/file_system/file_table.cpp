@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "file_table.hpp"
+#include "fsitem.hpp"
+
+namespace DDK {
+namespace {
+template <typename T> std::size_t capacityInBytes(const std::vector<T> &column) {
+    return column.capacity() * sizeof(T);
+}
+
+template <typename Relations> std::size_t relationsInBytes(const Relations &relations) {
+    // rough estimate of the node based containers: one node per element
+    std::size_t bytes = relations.bucket_count() * sizeof(void *);
+    for (const auto &[index, related] : relations) {
+        bytes += 4 * sizeof(void *) + related.size() * 4 * sizeof(void *);
+    }
+    return bytes;
+}
+} // namespace
+
+FileTable::FileTable() : m_rootNameSize(0), m_root(nullptr), m_rootParent(nullptr) {}
+
+FileTable::~FileTable() = default;
+
+void FileTable::addRoot(const std::filesystem::path &path,
+                        std::filesystem::file_type type,
+                        std::uintmax_t size,
+                        bool symlink,
+                        FileSystemError error,
+                        std::size_t depth,
+                        SCAN::FileId fileId) {
+    m_nameOffsets.push_back(m_names.size());
+    m_names += path.native();
+    m_rootNameSize = path.filename().native().size();
+    for (const std::filesystem::path &component : path) {
+        m_rootComponents.push_back(component.native());
+    }
+    append(NO_INDEX, type, size, symlink, error, depth);
+    if (fileId.isHardlinked()) {
+        m_fileIds.emplace(0, fileId);
+    }
+}
+
+FileTable::Index FileTable::addChildren(Index directory,
+                                        const std::vector<SCAN::DirectoryEntry> &entries) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    const Index firstChild = static_cast<Index>(m_sizes.size());
+    if (m_sizes.size() + entries.size() >= NO_INDEX) {
+        throw std::length_error("too many file system items");
+    }
+
+    for (const SCAN::DirectoryEntry &entry : entries) {
+        m_nameOffsets.push_back(m_names.size());
+#if defined(_WIN32)
+        m_names += std::filesystem::u8path(entry.name).native();
+#else
+        m_names += entry.name;
+#endif
+
+        const FileSystemError error = entry.type == std::filesystem::file_type::not_found
+                                          ? FileSystemError::PATH_DOES_NOT_EXIST
+                                          : FileSystemError::NO_ERROR;
+        const Index index = append(directory, entry.type, entry.size, entry.symlink, error,
+                                   m_depths.at(directory) + 1);
+        if (entry.fileId.isHardlinked()) {
+            m_fileIds.emplace(index, entry.fileId);
+        }
+    }
+
+    Directory &parent = m_directories.at(m_directoryIndices.at(directory));
+    parent.firstChild = firstChild;
+    parent.childrenCount = static_cast<Index>(entries.size());
+    return firstChild;
+}
+
+FileTable::Index FileTable::append(Index parent,
+                                   std::filesystem::file_type type,
+                                   std::uintmax_t size,
+                                   bool symlink,
+                                   FileSystemError error,
+                                   std::size_t depth) {
+    const Index index = static_cast<Index>(m_sizes.size());
+
+    m_sizes.push_back(size);
+    m_hashes.push_back({});
+    m_parents.push_back(parent);
+    m_depths.push_back(static_cast<std::uint16_t>(depth));
+    m_types.push_back(type);
+    m_errors.push_back(static_cast<std::uint8_t>(error));
+    m_flags.push_back(symlink ? FLAG_SYMLINK : 0);
+    m_origins.push_back(0);
+
+    if (type == std::filesystem::file_type::directory) {
+        m_directoryIndices.push_back(static_cast<Index>(m_directories.size()));
+        m_directories.push_back({index, 0, 0, 0, symlink ? Index{1} : Index{0}});
+    } else {
+        m_directoryIndices.push_back(NO_INDEX);
+    }
+
+    return index;
+}
+
+void FileTable::setError(Index index, FileSystemError error) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_errors.at(index) = static_cast<std::uint8_t>(error);
+}
+
+void FileTable::finalize(FileSystemItem *root, const FileSystemItem *rootParent) {
+    m_root = root;
+    m_rootParent = rootParent;
+
+    // children always have larger indices than their parent, so a single reverse pass sees every
+    // item after all of its descendants
+    for (Index index = static_cast<Index>(m_sizes.size()); index-- > 1;) {
+        if (isDropped(index)) {
+            continue;
+        }
+
+        const Index parentIndex = m_parents[index];
+        Directory &parent = m_directories[m_directoryIndices[parentIndex]];
+        m_sizes[parentIndex] += m_sizes[index];
+
+        if (m_directoryIndices[index] != NO_INDEX) {
+            const Directory &directory = m_directories[m_directoryIndices[index]];
+            parent.subDirectoriesCount += 1 + directory.subDirectoriesCount;
+            parent.filesCount += directory.filesCount;
+            parent.symlinksCount += directory.symlinksCount;
+        } else {
+            if (getType(index) == std::filesystem::file_type::regular) {
+                parent.filesCount++;
+            }
+            parent.symlinksCount += isSymlink(index) ? 1 : 0;
+        }
+    }
+
+    m_sizes.shrink_to_fit();
+    m_hashes.shrink_to_fit();
+    m_parents.shrink_to_fit();
+    m_directoryIndices.shrink_to_fit();
+    m_depths.shrink_to_fit();
+    m_types.shrink_to_fit();
+    m_errors.shrink_to_fit();
+    m_flags.shrink_to_fit();
+    m_origins.shrink_to_fit();
+    m_directories.shrink_to_fit();
+    m_names.shrink_to_fit();
+    m_nameOffsets.shrink_to_fit();
+
+    m_items.reserve(m_sizes.size());
+    for (Index index = 0; index < m_sizes.size(); index++) {
+        m_items.push_back(FileSystemItem(this, index));
+    }
+}
+
+bool FileTable::isDropped(Index index) const {
+    // directories that could not be listed are removed from the tree, like they were never found
+    return getError(index) == FileSystemError::ACCESS_DENIED;
+}
+
+FileTable::Index FileTable::skipDropped(Index index, Index end) const {
+    while (index < end && isDropped(index)) {
+        index++;
+    }
+    return index;
+}
+
+std::size_t FileTable::size() const { return m_sizes.size(); }
+
+std::size_t FileTable::getMemoryUsage() const {
+    return capacityInBytes(m_sizes) + capacityInBytes(m_hashes) + capacityInBytes(m_parents) +
+           capacityInBytes(m_directoryIndices) + capacityInBytes(m_depths) +
+           capacityInBytes(m_types) + capacityInBytes(m_errors) + capacityInBytes(m_flags) +
+           capacityInBytes(m_origins) + capacityInBytes(m_directories) +
+           m_names.capacity() * sizeof(std::filesystem::path::value_type) +
+           capacityInBytes(m_nameOffsets) + capacityInBytes(m_items) +
+           m_fileIds.bucket_count() * sizeof(void *) +
+           m_fileIds.size() * (sizeof(void *) + sizeof(Index) + sizeof(SCAN::FileId)) +
+           relationsInBytes(m_duplicates) + relationsInBytes(m_potentialDuplicates);
+}
+
+FileSystemItem *FileTable::getItem(Index index) const {
+    return index == 0 ? m_root : const_cast<FileSystemItem *>(&m_items[index]);
+}
+
+const FileSystemItem *FileTable::getRootParent() const { return m_rootParent; }
+
+FileTable::Index FileTable::getParent(Index index) const { return m_parents[index]; }
+
+std::size_t FileTable::getDepth(Index index) const { return m_depths[index]; }
+
+std::filesystem::file_type FileTable::getType(Index index) const {
+    return m_types[index];
+}
+
+std::uintmax_t FileTable::getSize(Index index) const { return m_sizes[index]; }
+
+std::basic_string_view<std::filesystem::path::value_type> FileTable::getNameSlice(
+    Index index) const {
+    const std::size_t begin = m_nameOffsets[index];
+    const std::size_t end =
+        index + 1 < m_nameOffsets.size() ? m_nameOffsets[index + 1] : m_names.size();
+    return {m_names.data() + begin, end - begin};
+}
+
+std::basic_string_view<std::filesystem::path::value_type> FileTable::getName(Index index) const {
+    const auto name = getNameSlice(index);
+    // the root stores its full path
+    return index == 0 ? name.substr(name.size() - m_rootNameSize) : name;
+}
+
+void FileTable::collectAncestors(Index index, std::vector<Index> &ancestors) const {
+    ancestors.clear();
+    for (; index != 0; index = m_parents[index]) {
+        ancestors.push_back(index);
+    }
+}
+
+std::filesystem::path FileTable::getPath(Index index) const {
+    thread_local std::vector<Index> ancestors;
+    collectAncestors(index, ancestors);
+
+    std::size_t size = getNameSlice(0).size();
+    for (const Index ancestor : ancestors) {
+        size += 1 + getNameSlice(ancestor).size();
+    }
+
+    std::filesystem::path::string_type path;
+    path.reserve(size);
+    path += getNameSlice(0);
+    for (auto ancestor = ancestors.rbegin(); ancestor != ancestors.rend(); ancestor++) {
+        // equivalent to path / name, names never contain separators
+        if (!path.empty() && path.back() != std::filesystem::path::preferred_separator) {
+            path += std::filesystem::path::preferred_separator;
+        }
+        path += getNameSlice(*ancestor);
+    }
+    return path;
+}
+
+int FileTable::comparePaths(Index lhs, const FileTable &rhsTable, Index rhs) const {
+    if (&rhsTable == this) {
+        if (lhs == rhs) {
+            return 0;
+        }
+
+        // climb up to the children of the closest common ancestor and compare their names
+        Index lhsAncestor = lhs;
+        Index rhsAncestor = rhs;
+        while (m_depths[lhsAncestor] > m_depths[rhsAncestor]) {
+            lhsAncestor = m_parents[lhsAncestor];
+        }
+        while (m_depths[rhsAncestor] > m_depths[lhsAncestor]) {
+            rhsAncestor = m_parents[rhsAncestor];
+        }
+        if (lhsAncestor == rhsAncestor) {
+            // one item is an ancestor of the other one
+            return m_depths[lhs] < m_depths[rhs] ? -1 : 1;
+        }
+        while (m_parents[lhsAncestor] != m_parents[rhsAncestor]) {
+            lhsAncestor = m_parents[lhsAncestor];
+            rhsAncestor = m_parents[rhsAncestor];
+        }
+        const int result = getNameSlice(lhsAncestor).compare(getNameSlice(rhsAncestor));
+        return result < 0 ? -1 : (result > 0 ? 1 : 0);
+    }
+
+    // items of different trees, compare the component sequences: root components + names
+    thread_local std::vector<Index> lhsAncestors;
+    thread_local std::vector<Index> rhsAncestors;
+    collectAncestors(lhs, lhsAncestors);
+    rhsTable.collectAncestors(rhs, rhsAncestors);
+
+    using StringView = std::basic_string_view<std::filesystem::path::value_type>;
+    const auto component = [](const FileTable &table, const std::vector<Index> &ancestors,
+                              std::size_t position) -> StringView {
+        if (position < table.m_rootComponents.size()) {
+            return table.m_rootComponents[position];
+        }
+        return table.getNameSlice(ancestors[ancestors.size() - 1 -
+                                            (position - table.m_rootComponents.size())]);
+    };
+
+    const std::size_t lhsSize = m_rootComponents.size() + lhsAncestors.size();
+    const std::size_t rhsSize = rhsTable.m_rootComponents.size() + rhsAncestors.size();
+    for (std::size_t position = 0; position < lhsSize && position < rhsSize; position++) {
+        const int result = component(*this, lhsAncestors, position)
+                               .compare(component(rhsTable, rhsAncestors, position));
+        if (result != 0) {
+            return result < 0 ? -1 : 1;
+        }
+    }
+    return lhsSize < rhsSize ? -1 : (lhsSize > rhsSize ? 1 : 0);
+}
+
+void FileTable::getPathKey(Index index, std::filesystem::path::string_type &key) const {
+    thread_local std::vector<Index> ancestors;
+    collectAncestors(index, ancestors);
+
+    key.clear();
+    for (const std::filesystem::path::string_type &component : m_rootComponents) {
+        key += component;
+        key.push_back(0);
+    }
+    for (auto ancestor = ancestors.rbegin(); ancestor != ancestors.rend(); ancestor++) {
+        key += getNameSlice(*ancestor);
+        key.push_back(0);
+    }
+}
+
+FileSystemError FileTable::getError(Index index) const {
+    return static_cast<FileSystemError>(m_errors[index]);
+}
+
+bool FileTable::isSymlink(Index index) const { return (m_flags[index] & FLAG_SYMLINK) != 0; }
+
+std::size_t FileTable::getChildFilesCount(Index index) const {
+    const Index directory = m_directoryIndices[index];
+    return directory != NO_INDEX ? m_directories[directory].filesCount : 0;
+}
+
+std::size_t FileTable::getChildSubDirectoriesCount(Index index) const {
+    const Index directory = m_directoryIndices[index];
+    return directory != NO_INDEX ? m_directories[directory].subDirectoriesCount : 0;
+}
+
+std::size_t FileTable::getChildSymlinksCount(Index index) const {
+    const Index directory = m_directoryIndices[index];
+    if (directory == NO_INDEX) {
+        return isSymlink(index) ? 1 : 0;
+    }
+    return m_directories[directory].symlinksCount;
+}
+
+std::vector<FileSystemItem *> FileTable::getChildren(Index index) const {
+    const ChildRange range = getChildRange(index);
+    return std::vector<FileSystemItem *>(range.begin(), range.end());
+}
+
+FileTable::ChildRange FileTable::getChildRange(Index index) const {
+    const Index directory = m_directoryIndices[index];
+    if (directory == NO_INDEX) {
+        return ChildRange(this, 0, 0);
+    }
+    const Index firstChild = m_directories[directory].firstChild;
+    return ChildRange(this, firstChild, firstChild + m_directories[directory].childrenCount);
+}
+
+FileTable::Index FileTable::getNextInTree(Index root, Index index) const {
+    const Index directory = m_directoryIndices[index];
+    if (directory != NO_INDEX) {
+        const Directory &children = m_directories[directory];
+        const Index end = children.firstChild + children.childrenCount;
+        const Index child = skipDropped(children.firstChild, end);
+        if (child != end) {
+            return child;
+        }
+    }
+
+    // siblings are stored as one block, so the next one directly follows unless it was dropped
+    for (Index item = index; item != root; item = m_parents[item]) {
+        const Directory &siblings = m_directories[m_directoryIndices[m_parents[item]]];
+        const Index end = siblings.firstChild + siblings.childrenCount;
+        const Index sibling = skipDropped(item + 1, end);
+        if (sibling != end) {
+            return sibling;
+        }
+    }
+    return NO_INDEX;
+}
+
+FileTable::Index FileTable::find(const std::filesystem::path &path) const {
+    auto component = path.begin();
+    for (const std::filesystem::path::string_type &rootComponent : m_rootComponents) {
+        if (component == path.end() || component->native() != rootComponent) {
+            return NO_INDEX;
+        }
+        component++;
+    }
+
+    Index index = 0;
+    for (; component != path.end(); component++) {
+        // trailing separator
+        if (component->empty()) {
+            continue;
+        }
+        const Index directory = m_directoryIndices[index];
+        if (directory == NO_INDEX) {
+            return NO_INDEX;
+        }
+        const Index firstChild = m_directories[directory].firstChild;
+        const Index childrenCount = m_directories[directory].childrenCount;
+        index = NO_INDEX;
+        for (Index child = firstChild; child < firstChild + childrenCount; child++) {
+            if (!isDropped(child) && getNameSlice(child) == component->native()) {
+                index = child;
+                break;
+            }
+        }
+        if (index == NO_INDEX) {
+            return NO_INDEX;
+        }
+    }
+    return index;
+}
+
+void FileTable::setOrigins(Index index, Origins origins) {
+    if (index == 0) {
+        std::fill(m_origins.begin(), m_origins.end(), origins);
+        return;
+    }
+
+    // descendants always follow their parent, so one forward pass finds all of them
+    std::vector<bool> within(m_origins.size() - index, false);
+    within[0] = true;
+    m_origins[index] = origins;
+    for (Index item = index + 1; item < m_origins.size(); item++) {
+        const Index parent = m_parents[item];
+        if (parent >= index && within[parent - index]) {
+            within[item - index] = true;
+            m_origins[item] = origins;
+        }
+    }
+}
+
+FileTable::Origins FileTable::getOrigins(Index index) const { return m_origins[index]; }
+
+SCAN::FileId FileTable::getFileId(Index index) const {
+    const auto fileId = m_fileIds.find(index);
+    return fileId != m_fileIds.end() ? fileId->second : SCAN::FileId{};
+}
+
+void FileTable::setHash(Index index, HASH::Hash hash) { m_hashes[index] = hash; }
+
+HASH::Hash FileTable::getHash(Index index) const { return m_hashes[index]; }
+
+void FileTable::addDuplicate(Index index, FileSystemItem *const duplicate) {
+    m_duplicates[index].insert(duplicate);
+}
+
+void FileTable::addPotentialDuplicate(Index index, FileSystemItem *const duplicate) {
+    m_potentialDuplicates[index].insert(duplicate);
+}
+
+const std::set<FileSystemItem *> &FileTable::getDuplicates(Index index) const {
+    static const std::set<FileSystemItem *> none;
+    const auto duplicates = m_duplicates.find(index);
+    return duplicates != m_duplicates.end() ? duplicates->second : none;
+}
+
+const std::set<FileSystemItem *> &FileTable::getPotentialDuplicates(Index index) const {
+    static const std::set<FileSystemItem *> none;
+    const auto duplicates = m_potentialDuplicates.find(index);
+    return duplicates != m_potentialDuplicates.end() ? duplicates->second : none;
+}
+} // namespace DDK
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "hash/hash.hpp"
+#include "scan/directory_reader.hpp"
+
+namespace DDK {
+class FileSystemItem;
+enum class FileSystemError;
+
+// Struct of arrays storage for all items of a scanned tree. Every column is a contiguous array
+// indexed by a 32-bit item index, the root has index 0. The children of a directory are stored
+// as one contiguous block and always have larger indices than their parent.
+class FileTable {
+  public:
+    using Index = std::uint32_t;
+    static constexpr Index NO_INDEX = std::numeric_limits<Index>::max();
+    // one bit per root path the item lies within, see FileSystemInfo::getDuplicatesFromCompare()
+    using Origins = std::uint16_t;
+
+    // Children of a directory in listing order, children that could not be listed are skipped.
+    // Iterates the table in place, so nothing is allocated.
+    class ChildRange {
+      public:
+        class Iterator {
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = FileSystemItem *;
+            using difference_type = std::ptrdiff_t;
+            using pointer = FileSystemItem *const *;
+            using reference = FileSystemItem *;
+
+            Iterator(const FileTable *table, Index index, Index end) :
+                m_table(table), m_index(table->skipDropped(index, end)), m_end(end) {}
+
+            FileSystemItem *operator*() const { return m_table->getItem(m_index); }
+            Iterator &operator++() {
+                m_index = m_table->skipDropped(m_index + 1, m_end);
+                return *this;
+            }
+            bool operator==(const Iterator &other) const { return m_index == other.m_index; }
+            bool operator!=(const Iterator &other) const { return m_index != other.m_index; }
+
+          private:
+            const FileTable *m_table;
+            Index m_index;
+            Index m_end;
+        };
+
+        ChildRange(const FileTable *table, Index begin, Index end) :
+            m_table(table), m_begin(begin), m_end(end) {}
+
+        Iterator begin() const { return Iterator(m_table, m_begin, m_end); }
+        Iterator end() const { return Iterator(m_table, m_end, m_end); }
+        bool empty() const { return begin() == end(); }
+
+      private:
+        const FileTable *m_table;
+        Index m_begin;
+        Index m_end;
+    };
+
+    FileTable();
+    ~FileTable();
+
+    FileTable(const FileTable &) = delete;
+    FileTable &operator=(const FileTable &) = delete;
+
+    void addRoot(const std::filesystem::path &path,
+                 std::filesystem::file_type type,
+                 std::uintmax_t size,
+                 bool symlink,
+                 FileSystemError error,
+                 std::size_t depth,
+                 SCAN::FileId fileId = {});
+    // Appends all entries of a directory listing as children of directory and returns the index
+    // of the first child. Thread safe, may be called concurrently while scanning.
+    Index addChildren(Index directory, const std::vector<SCAN::DirectoryEntry> &entries);
+    // Thread safe, may be called concurrently while scanning.
+    void setError(Index index, FileSystemError error);
+    // Accumulates sizes and counts of all directories and releases unused capacity. Must be called
+    // once after the scan is complete.
+    void finalize(FileSystemItem *root, const FileSystemItem *rootParent);
+
+    std::size_t size() const;
+    // approximate heap memory used by the table in bytes
+    std::size_t getMemoryUsage() const;
+
+    FileSystemItem *getItem(Index index) const;
+    const FileSystemItem *getRootParent() const;
+    Index getParent(Index index) const;
+    std::size_t getDepth(Index index) const;
+    std::filesystem::file_type getType(Index index) const;
+    std::uintmax_t getSize(Index index) const;
+    // rebuilds the full path from the names of all ancestors
+    std::filesystem::path getPath(Index index) const;
+    // last path component, no allocation
+    std::basic_string_view<std::filesystem::path::value_type> getName(Index index) const;
+    // Compares like std::filesystem::path::compare() without rebuilding any path. rhs may be an
+    // item of another table.
+    int comparePaths(Index lhs, const FileTable &rhsTable, Index rhs) const;
+    // Replaces key with all path components of index, each followed by a 0 character. Keys of
+    // items of any table compare like comparePaths().
+    void getPathKey(Index index, std::filesystem::path::string_type &key) const;
+    FileSystemError getError(Index index) const;
+    bool isSymlink(Index index) const;
+    // {0, 0} unless the item is a regular file with more than one hard link
+    SCAN::FileId getFileId(Index index) const;
+    std::size_t getChildFilesCount(Index index) const;
+    std::size_t getChildSubDirectoriesCount(Index index) const;
+    std::size_t getChildSymlinksCount(Index index) const;
+    // children in directory listing order, children that could not be listed are skipped
+    std::vector<FileSystemItem *> getChildren(Index index) const;
+    ChildRange getChildRange(Index index) const;
+    // Item following index in depth first order within the tree of root, NO_INDEX after the last
+    // one. Walks the table in place, so a whole tree is visited without allocating.
+    Index getNextInTree(Index root, Index index) const;
+    // index of the item at path, NO_INDEX if path is not within the root path
+    Index find(const std::filesystem::path &path) const;
+
+    // Replaces the origins of index and all of its descendants in a single pass over the table.
+    void setOrigins(Index index, Origins origins);
+    Origins getOrigins(Index index) const;
+
+    void setHash(Index index, HASH::Hash hash);
+    HASH::Hash getHash(Index index) const;
+    void addDuplicate(Index index, FileSystemItem *const duplicate);
+    void addPotentialDuplicate(Index index, FileSystemItem *const duplicate);
+    // the stored sets themselves, empty for items without any
+    const std::set<FileSystemItem *> &getDuplicates(Index index) const;
+    const std::set<FileSystemItem *> &getPotentialDuplicates(Index index) const;
+
+  private:
+    // only directories carry children, so their bookkeeping lives in a separate table
+    struct Directory {
+        Index firstChild;
+        Index childrenCount;
+        Index filesCount;
+        Index subDirectoriesCount;
+        Index symlinksCount;
+    };
+
+    static constexpr std::uint8_t FLAG_SYMLINK = 0x01;
+
+    Index append(Index parent,
+                 std::filesystem::file_type type,
+                 std::uintmax_t size,
+                 bool symlink,
+                 FileSystemError error,
+                 std::size_t depth);
+    bool isDropped(Index index) const;
+    // first index within [index, end) that is not dropped, end if there is none
+    Index skipDropped(Index index, Index end) const;
+    std::basic_string_view<std::filesystem::path::value_type> getNameSlice(Index index) const;
+    // collects the indices from index up to (excluding) the root
+    void collectAncestors(Index index, std::vector<Index> &ancestors) const;
+
+    std::mutex m_mutex;
+
+    std::vector<std::uintmax_t> m_sizes;
+    std::vector<HASH::Hash> m_hashes;
+    std::vector<Index> m_parents;
+    std::vector<Index> m_directoryIndices;
+    std::vector<std::uint16_t> m_depths;
+    std::vector<std::filesystem::file_type> m_types;
+    std::vector<std::uint8_t> m_errors;
+    std::vector<std::uint8_t> m_flags;
+    std::vector<Origins> m_origins;
+    std::vector<Directory> m_directories;
+
+    // Names of all items in index order, the name of an item ends where the next one begins. The
+    // root stores its full path, every other item only its name.
+    std::filesystem::path::string_type m_names;
+    std::vector<std::size_t> m_nameOffsets;
+    // components of the root path, compared against other tables
+    std::vector<std::filesystem::path::string_type> m_rootComponents;
+    std::size_t m_rootNameSize;
+
+    // hard links are rare, so their ids are not stored per item
+    std::unordered_map<Index, SCAN::FileId> m_fileIds;
+
+    // duplicate relations are rare, so they are not stored per item
+    std::unordered_map<Index, std::set<FileSystemItem *>> m_duplicates;
+    std::unordered_map<Index, std::set<FileSystemItem *>> m_potentialDuplicates;
+
+    FileSystemItem *m_root;
+    const FileSystemItem *m_rootParent;
+    // views handed out by FileSystemItem, index 0 is the root item itself
+    std::vector<FileSystemItem> m_items;
+};
+} // namespace DDK
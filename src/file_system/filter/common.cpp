@@ -1,7 +1,165 @@
 #include "common.hpp"
+#include "parallel/work_stealing_pool.hpp"
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 
 namespace DDK::FILTER::COMMON {
+namespace {
+// every thread of a parallel sort handles at least this many items
+constexpr std::size_t PARALLEL_SORT_CHUNK = 64 * 1024;
+constexpr std::size_t RADIX = 256;
+
+// key of the item at index, words are compared from the first to the last one
+template <std::size_t WORDS> struct SortKey {
+    std::array<std::uint64_t, WORDS> words;
+    std::uint32_t index;
+};
+
+// Splits count elements into chunks consecutive ranges and calls task(chunk, begin, end) for
+// every range, in parallel if there is a pool. Equal arguments always produce equal ranges.
+template <typename Task>
+void forEachChunk(std::size_t count,
+                  std::size_t chunks,
+                  PARALLEL::WorkStealingPool *pool,
+                  const Task &task) {
+    const std::size_t chunkSize = (count + chunks - 1) / chunks;
+    for (std::size_t chunk = 0; chunk < chunks; chunk++) {
+        const std::size_t begin = std::min(count, chunk * chunkSize);
+        const std::size_t end = std::min(count, begin + chunkSize);
+        if (pool != nullptr) {
+            pool->submit([&task, chunk, begin, end]() { task(chunk, begin, end); });
+        } else {
+            task(chunk, begin, end);
+        }
+    }
+    if (pool != nullptr) {
+        pool->wait();
+    }
+}
+
+// Stable LSD radix sort, ascending. Every pass distributes the keys by one byte, passes of bytes
+// that are equal for all keys are skipped. Every chunk is counted and scattered by its own task.
+template <std::size_t WORDS>
+void radixSort(std::vector<SortKey<WORDS>> &keys,
+               std::size_t chunks,
+               PARALLEL::WorkStealingPool *pool) {
+    std::vector<SortKey<WORDS>> buffer(keys.size());
+    std::vector<std::array<std::size_t, RADIX>> histograms(chunks);
+
+    for (std::size_t digit = 0; digit < WORDS * sizeof(std::uint64_t); digit++) {
+        const std::size_t word = WORDS - 1 - digit / sizeof(std::uint64_t);
+        const unsigned int shift = static_cast<unsigned int>(digit % sizeof(std::uint64_t)) * 8;
+        const auto byteOf = [word, shift](const SortKey<WORDS> &key) {
+            return static_cast<std::size_t>((key.words[word] >> shift) & (RADIX - 1));
+        };
+
+        const auto countChunk = [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, RADIX> &histogram = histograms[chunk];
+            histogram.fill(0);
+            for (std::size_t i = begin; i < end; i++) {
+                histogram[byteOf(keys[i])]++;
+            }
+        };
+        forEachChunk(keys.size(), chunks, pool, countChunk);
+
+        std::array<std::size_t, RADIX> totals{};
+        for (const std::array<std::size_t, RADIX> &histogram : histograms) {
+            for (std::size_t byte = 0; byte < RADIX; byte++) {
+                totals[byte] += histogram[byte];
+            }
+        }
+        if (std::find(totals.begin(), totals.end(), keys.size()) != totals.end()) {
+            continue;
+        }
+
+        // every chunk scatters its keys of a byte behind the ones of all previous chunks
+        std::size_t offset = 0;
+        for (std::size_t byte = 0; byte < RADIX; byte++) {
+            for (std::array<std::size_t, RADIX> &histogram : histograms) {
+                const std::size_t count = histogram[byte];
+                histogram[byte] = offset;
+                offset += count;
+            }
+        }
+
+        const auto scatterChunk = [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, RADIX> &offsets = histograms[chunk];
+            for (std::size_t i = begin; i < end; i++) {
+                buffer[offsets[byteOf(keys[i])]++] = keys[i];
+            }
+        };
+        forEachChunk(keys.size(), chunks, pool, scatterChunk);
+        keys.swap(buffer);
+    }
+}
+
+// items are sorted in chunks of at least PARALLEL_SORT_CHUNK items, one pool thread per chunk
+struct SortThreads {
+    SortThreads(std::size_t count, std::size_t threads)
+        : chunks(std::max<std::size_t>(1, std::min(PARALLEL::resolveThreadsCount(threads),
+                                                   count / PARALLEL_SORT_CHUNK))) {
+        if (chunks > 1) {
+            pool = std::make_unique<PARALLEL::WorkStealingPool>(chunks);
+        }
+    }
+
+    const std::size_t chunks;
+    std::unique_ptr<PARALLEL::WorkStealingPool> pool;
+};
+
+// Sorts items ascending by the keys getKey(item, words) stores and returns the sorted keys.
+template <std::size_t WORDS, typename GetKey>
+std::vector<SortKey<WORDS>> sortByKeys(std::vector<FileSystemItem *> &items,
+                                       const SortThreads &threads,
+                                       const GetKey &getKey) {
+    const std::size_t chunks = threads.chunks;
+    PARALLEL::WorkStealingPool *const pool = threads.pool.get();
+
+    std::vector<SortKey<WORDS>> keys(items.size());
+    const auto keyChunk = [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            getKey(items[i], keys[i].words);
+            keys[i].index = static_cast<std::uint32_t>(i);
+        }
+    };
+    forEachChunk(items.size(), chunks, pool, keyChunk);
+    radixSort(keys, chunks, pool);
+
+    std::vector<FileSystemItem *> sorted(items.size());
+    const auto permuteChunk = [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            sorted[i] = items[keys[i].index];
+        }
+    };
+    forEachChunk(items.size(), chunks, pool, permuteChunk);
+    items = std::move(sorted);
+    return keys;
+}
+
+// number of leading characters shared by the path keys of all items
+std::size_t getSharedPathKeySize(const std::vector<FileSystemItem *> &items,
+                                 const SortThreads &threads) {
+    std::filesystem::path::string_type first;
+    items.front()->getPathKey(first);
+
+    std::vector<std::size_t> shared(threads.chunks, first.size());
+    const auto shareChunk = [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        std::filesystem::path::string_type key;
+        for (std::size_t i = begin; i < end; i++) {
+            items[i]->getPathKey(key);
+            const auto sharedEnd = first.begin() + static_cast<std::ptrdiff_t>(shared[chunk]);
+            const auto mismatch = std::mismatch(first.begin(), sharedEnd, key.begin(), key.end());
+            shared[chunk] = static_cast<std::size_t>(mismatch.first - first.begin());
+        }
+    };
+    forEachChunk(items.size(), threads.chunks, threads.pool.get(), shareChunk);
+    return *std::min_element(shared.begin(), shared.end());
+}
+} // namespace
+
 bool is_in_sub_directory(std::filesystem::path path, const std::filesystem::path &root) {
     while (path != std::filesystem::path() && path != path.root_path()) {
         if (path == root) {
@@ -29,18 +187,64 @@ std::vector<std::vector<FileSystemItem *>> makeClusters(std::vector<FileSystemIt
 
     return clusters;
 }
-void sortFSitemsBySize(std::vector<FileSystemItem *> &items) {
-    std::sort(items.begin(), items.end(), [](const auto lhs, const auto rhs) {
-        return lhs->getSizeInBytes() > rhs->getSizeInBytes();
-    });
+void sortFSitemsBySize(std::vector<FileSystemItem *> &items, std::size_t threads) {
+    // complemented keys sort descending
+    const auto getKey = [](const FileSystemItem *const item, std::array<std::uint64_t, 1> &words) {
+        words[0] = ~static_cast<std::uint64_t>(item->getSizeInBytes());
+    };
+    sortByKeys<1>(items, SortThreads(items.size(), threads), getKey);
 }
-void sortFSitemsByHash(std::vector<FileSystemItem *> &items) {
-    std::sort(items.begin(), items.end(),
-              [](const auto lhs, const auto rhs) { return lhs->getHash() > rhs->getHash(); });
+void sortFSitemsByHash(std::vector<FileSystemItem *> &items, std::size_t threads) {
+    const auto getKey = [](const FileSystemItem *const item, std::array<std::uint64_t, 2> &words) {
+        const HASH::Hash hash = item->getHash();
+        words[0] = ~hash.high;
+        words[1] = ~hash.low;
+    };
+    sortByKeys<2>(items, SortThreads(items.size(), threads), getKey);
 }
-void sortFSitemsByPathLexicographically(std::vector<FileSystemItem *> &items) {
-    std::sort(items.begin(), items.end(),
-              [](const auto lhs, const auto rhs) { return lhs->getPath() > rhs->getPath(); });
+void sortFSitemsByPathLexicographically(std::vector<FileSystemItem *> &items,
+                                        std::size_t threads) {
+    if (items.empty()) {
+        return;
+    }
+
+    // The characters of the path key behind the shared ones, the first character in the most
+    // significant bits. Keys end with a 0 character and names are never empty, so a key that ends
+    // within the words compares like its path.
+    using Character = std::make_unsigned_t<std::filesystem::path::value_type>;
+    constexpr std::size_t WORD_CHARACTERS = sizeof(std::uint64_t) / sizeof(Character);
+    const SortThreads sortThreads(items.size(), threads);
+    const std::size_t shared = getSharedPathKeySize(items, sortThreads);
+    const auto getKey = [shared](const FileSystemItem *const item,
+                                 std::array<std::uint64_t, 2> &words) {
+        thread_local std::filesystem::path::string_type key;
+        item->getPathKey(key);
+        std::size_t position = shared;
+        for (std::uint64_t &word : words) {
+            word = 0;
+            for (std::size_t i = 0; i < WORD_CHARACTERS; i++, position++) {
+                const Character character =
+                    position < key.size() ? static_cast<Character>(key[position]) : 0;
+                word = (word << (sizeof(Character) * 8)) | character;
+            }
+            word = ~word;
+        }
+    };
+    const auto keys = sortByKeys<2>(items, sortThreads, getKey);
+
+    // paths that only differ behind the words of their keys
+    auto begin = items.begin();
+    for (std::size_t i = 1; i <= keys.size(); i++) {
+        if (i == keys.size() || keys[i].words != keys[i - 1].words) {
+            const auto end = items.begin() + static_cast<std::ptrdiff_t>(i);
+            if (end - begin > 1) {
+                std::sort(begin, end, [](const auto lhs, const auto rhs) {
+                    return lhs->comparePath(*rhs) > 0;
+                });
+            }
+            begin = end;
+        }
+    }
 }
 void onlyFiles(std::vector<FileSystemItem *> &items) {
     items.erase(std::remove_if(items.begin(), items.end(),
@@ -60,7 +264,7 @@ void removeFSItemsWithIdenticalPath(std::vector<FileSystemItem *> &items) {
 
     items.erase(std::unique(items.begin(), items.end(),
                             [](const auto lhs, const auto rhs) {
-                                return lhs->getPath() == rhs->getPath();
+                                return lhs->comparePath(*rhs) == 0;
                             }),
                 items.end());
 }
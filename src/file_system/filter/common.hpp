@@ -3,9 +3,17 @@
 namespace DDK::FILTER::COMMON {
 bool is_in_sub_directory(std::filesystem::path path, const std::filesystem::path &root);
 std::vector<std::vector<FileSystemItem *>> makeClusters(std::vector<FileSystemItem *> &items);
-void sortFSitemsBySize(std::vector<FileSystemItem *> &items);
-void sortFSitemsByHash(std::vector<FileSystemItem *> &items);
-void sortFSitemsByPathLexicographically(std::vector<FileSystemItem *> &items);
+// The sorts below read the key of every item once and sort (key, index) pairs with a radix sort,
+// items of equal keys keep their order. threads > 1 (or 0 for all hardware threads) sorts large
+// vectors on up to that many threads.
+// descending size
+void sortFSitemsBySize(std::vector<FileSystemItem *> &items, std::size_t threads = 1);
+// descending hash
+void sortFSitemsByHash(std::vector<FileSystemItem *> &items, std::size_t threads = 1);
+// Descending path. The radix sort orders a fixed width key of the path components behind the
+// components shared by all items, items of equal keys are compared by FileSystemItem::comparePath.
+void sortFSitemsByPathLexicographically(std::vector<FileSystemItem *> &items,
+                                        std::size_t threads = 1);
 void onlyFiles(std::vector<FileSystemItem *> &items);
 void removeEmptyFiles(std::vector<FileSystemItem *> &items);
 void removeFSItemsWithIdenticalPath(std::vector<FileSystemItem *> &items);
@@ -1,72 +1,806 @@
 #include "deduplication.hpp"
 #include "MemoryMapped.h"
 #include "common.hpp"
+#include "group_index.hpp"
+#include "hash/hash_policy.hpp"
+#include "io/async_reader.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "verify/verification.hpp"
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 
-#include "xxh3.h"
 namespace DDK::FILTER::DEDUPLICATION {
-XXH64_hash_t hashMappedMemory(const std::filesystem::path &path) {
-    MemoryMapped file(path.string(), MemoryMapped::MapRange::WholeFile,
-                      MemoryMapped::CacheHint::SequentialScan);
-    XXH64_hash_t hash = XXH64(file.getData(), file.size(), 0);
-    return hash;
+namespace {
+// Files that can not be read completely get no hash, otherwise all of them would share the hash
+// of the bytes that could be read and end up as duplicates of each other. The same goes for files
+// that no longer have the size they were grouped by, e.g. because it came from a stale snapshot.
+template <typename Policy>
+std::optional<HASH::Hash> hashBlock(const std::filesystem::path &path,
+                                    std::uintmax_t size,
+                                    std::uintmax_t offset,
+                                    std::uintmax_t length,
+                                    std::uint64_t seed,
+                                    const HashStages &stages) {
+    IO::FileReader file(path, stages.readOptions);
+    if (file.getSize() != size) {
+        return std::nullopt;
+    }
+    typename Policy::State state(seed);
+    if (!file.read(offset, length,
+                   [&state](const char *data, std::size_t size) { state.update(data, size); })) {
+        return std::nullopt;
+    }
+    return state.digest();
+}
+
+template <typename Policy>
+HASH::Hash hashMapped(const MemoryMapped &file) {
+    return Policy::hash(file.getData(), file.size(), 0);
+}
+
+template <typename Policy>
+std::optional<HASH::Hash> hashWholeFile(const std::filesystem::path &path,
+                                        std::uintmax_t size,
+                                        const HashStages &stages) {
+    if (size < stages.mappedReadThreshold || stages.readOptions.directIo ||
+        stages.readOptions.dropCache) {
+        return hashBlock<Policy>(path, size, 0, size, 0, stages);
+    }
+    const MemoryMapped file(path.string(), MemoryMapped::MapRange::WholeFile,
+                            MemoryMapped::CacheHint::SequentialScan);
+    if (!file.isValid() || file.size() != size) {
+        return std::nullopt;
+    }
+    return hashMapped<Policy>(file);
+}
+
+template <typename Policy>
+std::optional<HASH::Hash> hashSegment(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      std::size_t segment,
+                                      const HashStages &stages) {
+    const std::uintmax_t offset = segment * stages.segmentSize;
+    return hashBlock<Policy>(path, size, offset, std::min(stages.segmentSize, size - offset), 0,
+                             stages);
+}
+
+template <typename Policy>
+HASH::Hash combineSegmentHashes(const std::vector<HASH::Hash> &segmentHashes) {
+    static_assert(sizeof(HASH::Hash) == 2 * sizeof(std::uint64_t));
+    return Policy::hash(segmentHashes.data(), segmentHashes.size() * sizeof(HASH::Hash), 0);
+}
+
+template <typename Policy>
+std::optional<HASH::Hash> hashContent(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      const HashStages &stages) {
+    const std::size_t segments = getSegmentsCount(size, stages);
+    if (segments == 0) {
+        return hashWholeFile<Policy>(path, size, stages);
+    }
+
+    std::vector<HASH::Hash> segmentHashes(segments);
+    for (std::size_t segment = 0; segment < segments; segment++) {
+        const std::optional<HASH::Hash> segmentHash =
+            hashSegment<Policy>(path, size, segment, stages);
+        if (!segmentHash) {
+            return std::nullopt;
+        }
+        segmentHashes[segment] = *segmentHash;
+    }
+    return combineSegmentHashes<Policy>(segmentHashes);
+}
+
+// range of a file that is read by a stage that does not hash the whole content
+struct StageBlock {
+    std::uintmax_t offset;
+    std::uintmax_t length;
+    std::uint64_t seed;
+};
+
+StageBlock getStageBlock(std::uintmax_t size,
+                         HashStage stage,
+                         const HashStages &stages,
+                         HASH::Hash previousHash) {
+    if (stage == HashStage::HEAD) {
+        return {0, stages.headBytes, 0};
+    }
+    // chained with the head hash, so files only collide if both blocks are identical
+    return {size - stages.tailBytes, stages.tailBytes, previousHash.low ^ previousHash.high};
+}
+
+template <typename Policy>
+std::optional<HASH::Hash> hashFileStage(const std::filesystem::path &path,
+                                        std::uintmax_t size,
+                                        HashStage stage,
+                                        const HashStages &stages,
+                                        HASH::Hash previousHash) {
+    if (stage == getLastHashStage(size, stages)) {
+        return hashContent<Policy>(path, size, stages);
+    }
+    const StageBlock block = getStageBlock(size, stage, stages, previousHash);
+    return hashBlock<Policy>(path, size, block.offset, block.length, block.seed, stages);
+}
+
+void setHash(HashedFile &file, const std::optional<HASH::Hash> &hash) {
+    file.hash = hash.value_or(HASH::Hash{});
+    file.unreadable = !hash;
+}
+
+#if defined(DDK_HAS_IO_URING)
+// reader of the calling thread, nullptr if io_uring is not usable
+IO::AsyncReader *getThreadAsyncReader(unsigned int queueDepth) {
+    thread_local unsigned int readerQueueDepth = 0;
+    thread_local std::unique_ptr<IO::AsyncReader> reader;
+    if (readerQueueDepth != queueDepth) {
+        readerQueueDepth = queueDepth;
+        reader = IO::AsyncReader::create(queueDepth);
+    }
+    return reader.get();
 }
 
-void calculateHashValues(std::vector<FileSystemItem *> &items) {
+// hashes all files that are not hashed in segments, returns false if the ring failed
+template <typename Policy>
+bool hashFilesAsync(IO::AsyncReader &reader,
+                    std::vector<HashedFile> &files,
+                    HashStage stage,
+                    const HashStages &stages) {
+    std::vector<IO::ReadRequest> requests;
+    std::vector<typename Policy::State> states;
+    std::vector<std::uintmax_t> readBytes;
+    std::vector<HashedFile *> requestFiles;
+    for (HashedFile &file : files) {
+        StageBlock block{0, file.size, 0};
+        if (stage != getLastHashStage(file.size, stages)) {
+            block = getStageBlock(file.size, stage, stages, file.hash);
+        } else if (getSegmentsCount(file.size, stages) > 0) {
+            continue;
+        }
+        requests.push_back({&file.path, block.offset, block.length, file.size});
+        states.emplace_back(block.seed);
+        readBytes.push_back(0);
+        requestFiles.push_back(&file);
+    }
+
+    const auto update = [&states, &readBytes](std::size_t request, const char *data,
+                                              std::size_t size) {
+        states[request].update(data, size);
+        readBytes[request] += size;
+    };
+    if (!reader.read(requests, stages.readOptions, update)) {
+        return false;
+    }
+    for (std::size_t request = 0; request < requests.size(); request++) {
+        // requests stop early if their file could not be opened or read
+        requestFiles[request]->hash = states[request].digest();
+        requestFiles[request]->unreadable = readBytes[request] != requests[request].length;
+    }
+    for (HashedFile &file : files) {
+        if (stage == getLastHashStage(file.size, stages) &&
+            getSegmentsCount(file.size, stages) > 0) {
+            setHash(file, hashContent<Policy>(file.path, file.size, stages));
+        }
+    }
+    return true;
+}
+#endif
+
+template <typename Policy>
+void hashFilesStage(std::vector<HashedFile> &files, HashStage stage, const HashStages &stages) {
+#if defined(DDK_HAS_IO_URING)
+    if (stages.ioUringQueueDepth > 0) {
+        IO::AsyncReader *const reader = getThreadAsyncReader(stages.ioUringQueueDepth);
+        if (reader != nullptr && hashFilesAsync<Policy>(*reader, files, stage, stages)) {
+            return;
+        }
+    }
+#endif
+    for (HashedFile &file : files) {
+        setHash(file, hashFileStage<Policy>(file.path, file.size, stage, stages, file.hash));
+    }
+}
+
+// upper bound of files hashed by a single task, splits large size groups
+constexpr std::size_t HASH_TASK_FILES = 32;
+
+// items have to be grouped by size
+void calculateHashValues(std::vector<FileSystemItem *> &items,
+                         HashStage stage,
+                         const HashStages &stages,
+                         HashStatistics &statistics,
+                         PARALLEL::WorkStealingPool *pool) {
+    // all links of a file share their content, so every file is only read once
+    std::vector<FileSystemItem *> files;
+    std::unordered_map<SCAN::FileId, const FileSystemItem *, SCAN::FileIdHash> firstLinks;
+    std::vector<std::pair<FileSystemItem *, const FileSystemItem *>> links;
     for (FileSystemItem *const item : items) {
-        item->setHash(hashMappedMemory(item->getPath()));
+        const std::uintmax_t size = item->getSizeInBytes();
+        // the content hash of this file is already known
+        if (getLastHashStage(size, stages) < stage) {
+            continue;
+        }
+
+        const SCAN::FileId fileId = item->getFileId();
+        if (fileId.isHardlinked()) {
+            const auto [firstLink, added] = firstLinks.try_emplace(fileId, item);
+            if (!added) {
+                links.emplace_back(item, firstLink->second);
+                continue;
+            }
+        }
+        files.push_back(item);
+        statistics.addHashed(size, stage, stages);
+    }
+
+    // every item is written by exactly one task
+    std::vector<char> unreadable(files.size(), 0);
+    const auto hashFiles = [&files, &unreadable, stage, &stages](std::size_t begin,
+                                                                 std::size_t end) {
+        std::vector<HashedFile> hashedFiles;
+        for (std::size_t i = begin; i < end; i++) {
+            hashedFiles.push_back({files[i]->getPath(), files[i]->getSizeInBytes(),
+                                   files[i]->getHash()});
+        }
+        hashFilesStage(hashedFiles, stage, stages);
+        for (std::size_t i = begin; i < end; i++) {
+            files[i]->setHash(hashedFiles[i - begin].hash);
+            unreadable[i] = hashedFiles[i - begin].unreadable;
+        }
+    };
+    std::unordered_set<const FileSystemItem *> unreadableFiles;
+    if (pool == nullptr) {
+        hashFiles(0, files.size());
+    } else {
+        // the segments of large files are hashed by separate tasks and combined afterwards
+        struct SegmentedFile {
+            FileSystemItem *item;
+            HashedFile file;
+            std::vector<std::optional<HASH::Hash>> segmentHashes;
+        };
+        std::vector<SegmentedFile> segmentedFiles;
+        if (stage == HashStage::FULL) {
+            const auto segmented = std::stable_partition(
+                files.begin(), files.end(), [&stages](const FileSystemItem *const file) {
+                    return getSegmentsCount(file->getSizeInBytes(), stages) == 0;
+                });
+            for (auto item = segmented; item != files.end(); item++) {
+                HashedFile file{(*item)->getPath(), (*item)->getSizeInBytes(), (*item)->getHash()};
+                if (findCachedHash(file, stage, stages)) {
+                    (*item)->setHash(file.hash);
+                    continue;
+                }
+                const std::size_t segments = getSegmentsCount(file.size, stages);
+                segmentedFiles.push_back({*item, std::move(file),
+                                          std::vector<std::optional<HASH::Hash>>(segments)});
+            }
+            files.erase(segmented, files.end());
+        }
+        for (SegmentedFile &segmentedFile : segmentedFiles) {
+            for (std::size_t segment = 0; segment < segmentedFile.segmentHashes.size(); segment++) {
+                pool->submit([&segmentedFile, segment, &stages]() {
+                    segmentedFile.segmentHashes[segment] = hashSegment(
+                        segmentedFile.file.path, segmentedFile.file.size, segment, stages);
+                });
+            }
+        }
+
+        // size groups are independent of each other
+        const std::size_t taskFiles =
+            std::max<std::size_t>(HASH_TASK_FILES, stages.ioUringQueueDepth);
+        std::size_t begin = 0;
+        while (begin < files.size()) {
+            std::size_t end = begin + 1;
+            while (end < files.size() && end - begin < taskFiles &&
+                   files[end]->getSizeInBytes() == files[begin]->getSizeInBytes()) {
+                end++;
+            }
+            pool->submit([&hashFiles, begin, end]() { hashFiles(begin, end); });
+            begin = end;
+        }
+        pool->wait();
+
+        for (SegmentedFile &segmentedFile : segmentedFiles) {
+            const std::optional<HASH::Hash> hash =
+                combineSegmentHashes(segmentedFile.segmentHashes, stages);
+            if (!hash) {
+                unreadableFiles.insert(segmentedFile.item);
+                statistics.addDropped(segmentedFile.file.size, stage, stages);
+                continue;
+            }
+            segmentedFile.file.hash = *hash;
+            cacheHash(segmentedFile.file, stage, stages);
+            segmentedFile.item->setHash(segmentedFile.file.hash);
+        }
+    }
+
+    for (std::size_t i = 0; i < files.size(); i++) {
+        if (unreadable[i] != 0) {
+            unreadableFiles.insert(files[i]);
+            statistics.addDropped(files[i]->getSizeInBytes(), stage, stages);
+        }
+    }
+    for (const auto &[link, firstLink] : links) {
+        link->setHash(firstLink->getHash());
+        if (unreadableFiles.count(firstLink) != 0) {
+            unreadableFiles.insert(link);
+        }
+    }
+
+    // files that could not be read are never duplicates, the size groups stay in order
+    if (!unreadableFiles.empty()) {
+        items.erase(std::remove_if(items.begin(), items.end(),
+                                   [&unreadableFiles](const FileSystemItem *const item) {
+                                       return unreadableFiles.count(item) != 0;
+                                   }),
+                    items.end());
     }
 }
 
+
+struct SizeHash {
+    std::size_t operator()(std::uintmax_t size) const {
+        return static_cast<std::size_t>(mixBits(size));
+    }
+};
+
+struct SizeAndHash {
+    std::uintmax_t size;
+    HASH::Hash hash;
+
+    bool operator==(const SizeAndHash &other) const {
+        return size == other.size && hash == other.hash;
+    }
+};
+
+struct SizeAndHashHash {
+    std::size_t operator()(const SizeAndHash &key) const {
+        return static_cast<std::size_t>(key.hash.low ^ mixBits(key.size));
+    }
+};
+
+// Groups items by key and keeps the groups of at least two items, each as a contiguous range. The
+// keys are read in a single pass that fills a GroupIndex and the items are moved into their ranges
+// in a second one, so no item is compared with another. Groups keep the order of their first
+// items and the items of a group keep their order. onUnique receives every dropped item. Returns
+// the number of items of every kept group.
+template <typename Key, typename KeyHash, typename GetKey, typename OnUnique>
+std::vector<std::size_t> groupItems(std::vector<FileSystemItem *> &items,
+                                    GetKey getKey,
+                                    OnUnique onUnique) {
+    using Group = typename GroupIndex<Key, KeyHash>::Group;
+    constexpr std::uint32_t UNIQUE = std::numeric_limits<std::uint32_t>::max();
+
+    GroupIndex<Key, KeyHash> index(items.size());
+    std::vector<Group> groups(items.size());
+    for (std::size_t i = 0; i < items.size(); i++) {
+        groups[i] = index.insert(getKey(items[i]));
+    }
+
+    // items per group, turned into the offset of every kept group
+    std::vector<std::uint32_t> offsets(index.size(), 0);
+    for (const Group group : groups) {
+        offsets[group]++;
+    }
+    std::vector<std::size_t> ranges;
+    std::uint32_t kept = 0;
+    for (std::uint32_t &offset : offsets) {
+        const std::uint32_t count = offset;
+        offset = count > 1 ? kept : UNIQUE;
+        if (count > 1) {
+            ranges.push_back(count);
+            kept += count;
+        }
+    }
+
+    std::vector<FileSystemItem *> grouped(kept);
+    for (std::size_t i = 0; i < items.size(); i++) {
+        std::uint32_t &offset = offsets[groups[i]];
+        if (offset == UNIQUE) {
+            onUnique(items[i]);
+        } else {
+            grouped[offset++] = items[i];
+        }
+    }
+    items = std::move(grouped);
+    return ranges;
+}
+
+// Keeps groups of files of equal size, grouped by size.
 void removeFilesWithUniqueSize(std::vector<FileSystemItem *> &items) {
-    COMMON::sortFSitemsBySize(items);
+    groupItems<std::uintmax_t, SizeHash>(
+        items, [](const FileSystemItem *const item) { return item->getSizeInBytes(); },
+        [](const FileSystemItem *const) {});
+}
+
+// at least two distinct files among a group of at least two items
+bool hasDistinctFiles(std::vector<FileSystemItem *>::const_iterator begin,
+                      std::vector<FileSystemItem *>::const_iterator end) {
+    if (std::none_of(begin, end, [](const FileSystemItem *const item) {
+            return item->getFileId().isHardlinked();
+        })) {
+        return true;
+    }
+    return countDistinctFiles(std::vector<FileSystemItem *>(begin, end)) > 1;
+}
+
+// a reference file carries any of the references origins
+bool isReference(const FileSystemItem *const item, FileTable::Origins references) {
+    return (item->getOrigins() & references) != 0;
+}
+
+// a reference file and another file among a group
+bool spansReferences(std::vector<FileSystemItem *>::const_iterator begin,
+                     std::vector<FileSystemItem *>::const_iterator end,
+                     FileTable::Origins references) {
+    const bool reference = isReference(*begin, references);
+    return std::any_of(begin, end, [reference, references](const FileSystemItem *const item) {
+        return isReference(item, references) != reference;
+    });
+}
+
+// Keeps the files of sizes that are shared by reference files and other files, grouped by size.
+// Only the sizes of the reference files are indexed, all other files are looked up in that index.
+void joinFilesBySize(std::vector<FileSystemItem *> &items, FileTable::Origins references) {
+    GroupIndex<std::uintmax_t, SizeHash> index(static_cast<std::size_t>(
+        std::count_if(items.begin(), items.end(), [references](const FileSystemItem *const item) {
+            return isReference(item, references);
+        })));
+    for (const FileSystemItem *const item : items) {
+        if (isReference(item, references)) {
+            index.insert(item->getSizeInBytes());
+        }
+    }
 
-    std::size_t itemsCount = items.size();
-    for (std::size_t i = 0; i < itemsCount; i++) {
-        const bool previousDifferent =
-            i == 0 ? true : (items.at(i)->getSizeInBytes() != items.at(i - 1)->getSizeInBytes());
-        const bool nextDifferent =
-            i == itemsCount - 1
-                ? true
-                : (items.at(i)->getSizeInBytes() != items.at(i + 1)->getSizeInBytes());
-        if (previousDifferent && nextDifferent) {
-            items.erase(items.begin() + i);
-            i--;
-            itemsCount--;
+    std::vector<bool> matched(index.size(), false);
+    std::vector<FileSystemItem *> joined;
+    for (FileSystemItem *const item : items) {
+        if (isReference(item, references)) {
+            continue;
+        }
+        const auto group = index.find(item->getSizeInBytes());
+        if (group != GroupIndex<std::uintmax_t, SizeHash>::NO_GROUP) {
+            matched[group] = true;
+            joined.push_back(item);
+        }
+    }
+    for (FileSystemItem *const item : items) {
+        if (isReference(item, references) && matched[index.find(item->getSizeInBytes())]) {
+            joined.push_back(item);
         }
     }
+    items = std::move(joined);
+    removeFilesWithUniqueSize(items);
 }
 
-void removeFilesWithUniqueHash(std::vector<FileSystemItem *> &items) {
-    COMMON::sortFSitemsByHash(items);
+// Keeps groups of equal size and hash that contain at least two distinct files, grouped by size
+// and hash. Links of the same file are only duplicates of each other if another file shares their
+// content. Unless references is nullptr, groups without both reference files and other files are
+// dropped as well.
+void removeFilesWithUniqueHash(std::vector<FileSystemItem *> &items,
+                               HashStage stage,
+                               const HashStages &stages,
+                               HashStatistics &statistics,
+                               const FileTable::Origins *references = nullptr) {
+    const std::vector<std::size_t> ranges = groupItems<SizeAndHash, SizeAndHashHash>(
+        items,
+        [](const FileSystemItem *const item) {
+            return SizeAndHash{item->getSizeInBytes(), item->getHash()};
+        },
+        [stage, &stages, &statistics](const FileSystemItem *const item) {
+            statistics.addDropped(item->getSizeInBytes(), stage, stages);
+        });
 
-    std::size_t itemsCount = items.size();
-    for (std::size_t i = 0; i < itemsCount; i++) {
-        const bool previousDifferent =
-            i == 0 ? true : (items.at(i)->getHash() != items.at(i - 1)->getHash());
-        const bool nextDifferent =
-            i == itemsCount - 1 ? true : (items.at(i)->getHash() != items.at(i + 1)->getHash());
-        if (previousDifferent && nextDifferent) {
-            items.erase(items.begin() + i);
-            i--;
-            itemsCount--;
+    // compacted in place, every kept group moves towards the front
+    auto kept = items.begin();
+    auto groupBegin = items.begin();
+    for (const std::size_t range : ranges) {
+        const auto groupEnd = groupBegin + static_cast<std::ptrdiff_t>(range);
+        if (!hasDistinctFiles(groupBegin, groupEnd)) {
+            statistics.addDropped((*groupBegin)->getSizeInBytes(), stage, stages);
+        } else if (references != nullptr && !spansReferences(groupBegin, groupEnd, *references)) {
+            const std::size_t files = countDistinctFiles({groupBegin, groupEnd});
+            for (std::size_t file = 0; file < files; file++) {
+                statistics.addDropped((*groupBegin)->getSizeInBytes(), stage, stages);
+            }
+        } else {
+            kept = std::move(groupBegin, groupEnd, kept);
         }
+        groupBegin = groupEnd;
     }
+    items.erase(kept, items.end());
 }
 
-std::vector<std::size_t> extractDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items) {
-    COMMON::onlyFiles(items);
-    COMMON::removeEmptyFiles(items);
-    removeFilesWithUniqueSize(items);
-    calculateHashValues(items);
-    removeFilesWithUniqueHash(items);
+class LockstepFile {
+  public:
+    explicit LockstepFile(FileSystemItem *item) : m_item(item) {}
 
+    FileSystemItem *getItem() const { return m_item; }
+
+    // Reads the chunk at offset, the file stays open for the next chunk if keepOpen. Returns false
+    // if the chunk could not be read completely or the file no longer has the size it was grouped
+    // by, the file is closed then.
+    bool readChunk(std::uintmax_t offset, std::size_t length, char *chunk, bool keepOpen) {
+        if (!m_stream) {
+            m_stream = std::make_unique<std::ifstream>(m_item->getPath(),
+                                                       std::ios::binary | std::ios::ate);
+            if (static_cast<std::uintmax_t>(m_stream->tellg()) != m_item->getSizeInBytes()) {
+                m_stream.reset();
+                return false;
+            }
+            m_stream->seekg(static_cast<std::streamoff>(offset));
+        }
+        m_stream->read(chunk, static_cast<std::streamsize>(length));
+        const bool complete = static_cast<std::size_t>(m_stream->gcount()) == length;
+        if (!keepOpen || !complete) {
+            m_stream.reset();
+        }
+        return complete;
+    }
+
+    void close() { m_stream.reset(); }
+
+  private:
+    FileSystemItem *m_item;
+    std::unique_ptr<std::ifstream> m_stream;
+};
+
+// files of a size group with the same bytes so far, hash is chained over all of their chunks
+struct LockstepPart {
+    std::uint64_t hash;
+    std::vector<std::size_t> files;
+};
+
+// Appends the parts of part that share the chunk at offset to parts. Files are bucketed by the hash
+// of their chunk and only compared byte by byte with the one reference chunk of every part within
+// their bucket. Files that can not be read are dropped.
+void splitByChunk(std::vector<LockstepFile> &files,
+                  const LockstepPart &part,
+                  std::uintmax_t offset,
+                  std::size_t length,
+                  bool keepOpen,
+                  std::vector<char> &chunk,
+                  std::vector<LockstepPart> &parts) {
+    const std::size_t first = parts.size();
+    std::vector<std::vector<char>> references;
+    std::unordered_multimap<std::uint64_t, std::size_t> buckets;
+    for (const std::size_t file : part.files) {
+        if (!files[file].readChunk(offset, length, chunk.data(), keepOpen)) {
+            continue;
+        }
+        const std::uint64_t hash =
+            HASH::XXH3_64Policy::hash(chunk.data(), length, part.hash).low;
+        const auto [bucketBegin, bucketEnd] = buckets.equal_range(hash);
+        const auto match = std::find_if(bucketBegin, bucketEnd, [&](const auto &bucket) {
+            return std::memcmp(references[bucket.second].data(), chunk.data(), length) == 0;
+        });
+        if (match != bucketEnd) {
+            parts[first + match->second].files.push_back(file);
+        } else {
+            buckets.emplace(hash, references.size());
+            references.emplace_back(chunk.begin(), chunk.begin() + length);
+            parts.push_back({hash, {file}});
+        }
+    }
+}
+
+// Compares all files of parts chunk by chunk from offset to the end while keeping them open.
+// Parts of a single file are dropped as soon as they occur unless keepSingles.
+std::vector<LockstepPart> compareInLockstep(std::vector<LockstepFile> &files,
+                                            std::vector<LockstepPart> parts,
+                                            std::uintmax_t offset,
+                                            std::uintmax_t size,
+                                            bool keepSingles,
+                                            std::vector<char> &chunk) {
+    for (; offset < size && !parts.empty(); offset += LOCKSTEP_CHUNK_SIZE) {
+        const std::size_t length =
+            static_cast<std::size_t>(std::min<std::uintmax_t>(LOCKSTEP_CHUNK_SIZE, size - offset));
+
+        std::vector<LockstepPart> splitParts;
+        for (const LockstepPart &part : parts) {
+            splitByChunk(files, part, offset, length, true, chunk, splitParts);
+        }
+        if (!keepSingles) {
+            for (const LockstepPart &part : splitParts) {
+                if (part.files.size() == 1) {
+                    files[part.files.front()].close();
+                }
+            }
+            splitParts.erase(std::remove_if(splitParts.begin(), splitParts.end(),
+                                            [](const LockstepPart &part) {
+                                                return part.files.size() == 1;
+                                            }),
+                             splitParts.end());
+        }
+        parts = std::move(splitParts);
+    }
+
+    for (const LockstepPart &part : parts) {
+        for (const std::size_t file : part.files) {
+            files[file].close();
+        }
+    }
+    return parts;
+}
+
+// Compares the files of a part with more files than can be open in batches that fit. Every batch
+// is read to the end including its parts of a single file, parts of different batches with the
+// same hash are merged once the bytes of their first files are verified to be equal.
+std::vector<LockstepPart> compareInBatches(std::vector<LockstepFile> &files,
+                                           const LockstepPart &part,
+                                           std::uintmax_t offset,
+                                           std::uintmax_t size,
+                                           std::size_t maxOpenFiles,
+                                           std::vector<char> &chunk) {
+    std::vector<LockstepPart> merged;
+    std::unordered_multimap<std::uint64_t, std::size_t> mergedByHash;
+    for (std::size_t begin = 0; begin < part.files.size(); begin += maxOpenFiles) {
+        const std::size_t end = std::min(begin + maxOpenFiles, part.files.size());
+        LockstepPart batch{part.hash, {part.files.begin() + begin, part.files.begin() + end}};
+        for (LockstepPart &batchPart :
+             compareInLockstep(files, {std::move(batch)}, offset, size, true, chunk)) {
+            const auto [mergedBegin, mergedEnd] = mergedByHash.equal_range(batchPart.hash);
+            const auto match = std::find_if(mergedBegin, mergedEnd, [&](const auto &candidate) {
+                return VERIFY::equalFiles(
+                    files[merged[candidate.second].files.front()].getItem()->getPath(),
+                    files[batchPart.files.front()].getItem()->getPath());
+            });
+            if (match != mergedEnd) {
+                std::vector<std::size_t> &mergedFiles = merged[match->second].files;
+                mergedFiles.insert(mergedFiles.end(), batchPart.files.begin(),
+                                   batchPart.files.end());
+            } else {
+                mergedByHash.emplace(batchPart.hash, merged.size());
+                merged.push_back(std::move(batchPart));
+            }
+        }
+    }
+    return merged;
+}
+
+// sets of files with identical content among files of equal size
+std::vector<std::vector<FileSystemItem *>> compareInLockstep(
+    const std::vector<FileSystemItem *> &items, std::size_t maxOpenFiles) {
+    const std::uintmax_t size = items.front()->getSizeInBytes();
+    const std::size_t length =
+        static_cast<std::size_t>(std::min<std::uintmax_t>(LOCKSTEP_CHUNK_SIZE, size));
+    std::vector<LockstepFile> files(items.begin(), items.end());
+    std::vector<char> chunk(length);
+    LockstepPart all{0, std::vector<std::size_t>(files.size())};
+    std::iota(all.files.begin(), all.files.end(), 0);
+
+    std::vector<LockstepPart> parts;
+    if (files.size() <= maxOpenFiles) {
+        parts = compareInLockstep(files, {std::move(all)}, 0, size, false, chunk);
+    } else {
+        // every file is opened once for its first chunk, only parts that still do not fit are
+        // compared in batches
+        std::vector<LockstepPart> firstParts;
+        splitByChunk(files, all, 0, length, false, chunk, firstParts);
+        for (LockstepPart &part : firstParts) {
+            if (part.files.size() == 1) {
+                continue;
+            }
+            std::vector<LockstepPart> split =
+                part.files.size() <= maxOpenFiles || length == size
+                    ? compareInLockstep(files, {std::move(part)}, length, size, false, chunk)
+                    : compareInBatches(files, part, length, size, maxOpenFiles, chunk);
+            std::move(split.begin(), split.end(), std::back_inserter(parts));
+        }
+    }
+
+    std::vector<std::vector<FileSystemItem *>> duplicates;
+    for (const LockstepPart &part : parts) {
+        if (part.files.size() < 2) {
+            continue;
+        }
+        std::vector<FileSystemItem *> duplicate;
+        for (const std::size_t file : part.files) {
+            duplicate.push_back(files[file].getItem());
+        }
+        duplicates.push_back(std::move(duplicate));
+    }
+    return duplicates;
+}
+
+// items have to be grouped by size
+void compareFilesInLockstep(std::vector<FileSystemItem *> &items,
+                            PARALLEL::WorkStealingPool *pool) {
+    struct SizeGroup {
+        std::uintmax_t size;
+        // first links only, all links of a file share their content
+        std::vector<FileSystemItem *> files;
+        std::vector<std::pair<FileSystemItem *, const FileSystemItem *>> links;
+        std::vector<std::vector<FileSystemItem *>> duplicates;
+    };
+    std::vector<SizeGroup> groups;
+
+    auto groupBegin = items.begin();
+    while (groupBegin != items.end()) {
+        const std::uintmax_t size = (*groupBegin)->getSizeInBytes();
+        const auto groupEnd = std::find_if(groupBegin, items.end(), [size](const auto item) {
+            return item->getSizeInBytes() != size;
+        });
+
+        SizeGroup group{size, {}, {}, {}};
+        std::unordered_map<SCAN::FileId, const FileSystemItem *, SCAN::FileIdHash> firstLinks;
+        for (auto item = groupBegin; item != groupEnd; item++) {
+            const SCAN::FileId fileId = (*item)->getFileId();
+            if (fileId.isHardlinked()) {
+                const auto [firstLink, added] = firstLinks.try_emplace(fileId, *item);
+                if (!added) {
+                    group.links.emplace_back(*item, firstLink->second);
+                    continue;
+                }
+            }
+            // hash 0 marks files without duplicates, ids start at 1
+            (*item)->setHash(0);
+            group.files.push_back(*item);
+        }
+        if (group.files.size() > 1) {
+            groups.push_back(std::move(group));
+        }
+        groupBegin = groupEnd;
+    }
+
+    // larger files first, see the ids below
+    std::sort(groups.begin(), groups.end(),
+              [](const SizeGroup &lhs, const SizeGroup &rhs) { return lhs.size > rhs.size; });
+
+    // size groups are independent of each other and share the open files
+    const std::size_t threads = pool != nullptr ? pool->getThreadsCount() : 1;
+    const std::size_t maxOpenFiles = std::max<std::size_t>(2, MAX_LOCKSTEP_OPEN_FILES / threads);
+    for (SizeGroup &group : groups) {
+        const auto compare = [&group, maxOpenFiles]() {
+            group.duplicates = compareInLockstep(group.files, maxOpenFiles);
+        };
+        if (pool != nullptr) {
+            pool->submit(compare);
+        } else {
+            compare();
+        }
+    }
+    if (pool != nullptr) {
+        pool->wait();
+    }
+
+    // ids descend like the sizes, so sorting by hash keeps larger files first
+    std::uint64_t id = 0;
+    for (const SizeGroup &group : groups) {
+        id += group.duplicates.size();
+    }
+    std::vector<FileSystemItem *> duplicates;
+    for (const SizeGroup &group : groups) {
+        for (const std::vector<FileSystemItem *> &duplicate : group.duplicates) {
+            for (FileSystemItem *const file : duplicate) {
+                file->setHash(id);
+            }
+            duplicates.insert(duplicates.end(), duplicate.begin(), duplicate.end());
+            id--;
+        }
+        for (const auto &[link, firstLink] : group.links) {
+            if (firstLink->getHash() != 0) {
+                link->setHash(firstLink->getHash());
+                duplicates.push_back(link);
+            }
+        }
+    }
+    items = std::move(duplicates);
+}
+
+template <typename SameGroup>
+std::vector<std::size_t> getRanges(const std::vector<FileSystemItem *> &items,
+                                   SameGroup sameGroup) {
     std::vector<std::size_t> ranges{};
 
     for (std::size_t i = 0; i < items.size(); i++) {
         std::size_t range_end = i;
-        while (range_end < items.size() - 1 &&
-               items.at(i)->getHash() == items.at(range_end + 1)->getHash()) {
+        while (range_end < items.size() - 1 && sameGroup(items.at(i), items.at(range_end + 1))) {
             range_end++;
         }
         // +1 because we want to count the start item as well and range shoud start counting with 1
@@ -77,56 +811,285 @@ std::vector<std::size_t> extractDuplicatesAndGetRanges(std::vector<FileSystemIte
     return ranges;
 }
 
-void removeDuplicatesNotContainingDuplicatesFromBothPaths(
-    std::vector<std::vector<FileSystemItem *>> &duplicates,
-    const std::filesystem::path &p1,
-    const std::filesystem::path &p2) {
-    // compared to itself
-    if (p1 == p2) {
+// references is nullptr or the origins of the reference files, see joinDuplicatesAndGetRanges()
+std::vector<std::size_t> extractDuplicates(std::vector<FileSystemItem *> &items,
+                                           const HashStages &stages,
+                                           HashStatistics *statistics,
+                                           std::size_t threads,
+                                           Engine engine,
+                                           const FileTable::Origins *references) {
+    COMMON::onlyFiles(items);
+    COMMON::removeEmptyFiles(items);
+    if (references != nullptr) {
+        joinFilesBySize(items, *references);
+    } else {
+        removeFilesWithUniqueSize(items);
+    }
+
+    std::unique_ptr<PARALLEL::WorkStealingPool> pool;
+    const std::size_t hashingThreads =
+        std::min(PARALLEL::resolveThreadsCount(threads), MAX_HASHING_THREADS);
+    if (hashingThreads > 1 && !items.empty()) {
+        pool = std::make_unique<PARALLEL::WorkStealingPool>(hashingThreads);
+    }
+
+    if (engine == Engine::LOCKSTEP) {
+        compareFilesInLockstep(items, pool.get());
+        if (references != nullptr) {
+            // no statistics are counted for byte by byte comparisons
+            HashStatistics ignored;
+            removeFilesWithUniqueHash(items, HashStage::FULL, stages, ignored, references);
+        }
+    } else {
+        // every stage only reads files that still collide after the previous one
+        HashStatistics stageStatistics;
+        for (const HashStage stage : {HashStage::HEAD, HashStage::TAIL, HashStage::FULL}) {
+            calculateHashValues(items, stage, stages, stageStatistics, pool.get());
+            removeFilesWithUniqueHash(items, stage, stages, stageStatistics, references);
+        }
+        if (statistics != nullptr) {
+            statistics->add(stageStatistics);
+        }
+    }
+
+    pool.reset();
+    COMMON::sortFSitemsByHash(items, threads);
+    return getRanges(items, [](const auto lhs, const auto rhs) {
+        return lhs->getHash() == rhs->getHash();
+    });
+}
+} // namespace
+
+std::uintmax_t HashStages::getStageBytes(std::uintmax_t size, HashStage stage) const {
+    // the last stage hashes the whole content
+    if (stage == getLastHashStage(size, *this)) {
+        return size;
+    }
+    return stage == HashStage::HEAD ? headBytes : tailBytes;
+}
+
+void HashStatistics::addHashed(std::uintmax_t size, HashStage stage, const HashStages &stages) {
+    hashedFiles[static_cast<std::size_t>(stage)]++;
+    hashedBytes[static_cast<std::size_t>(stage)] += stages.getStageBytes(size, stage);
+}
+
+void HashStatistics::addDropped(std::uintmax_t size, HashStage stage, const HashStages &stages) {
+    // the whole content was read
+    if (stage >= getLastHashStage(size, stages)) {
         return;
     }
+    const std::uintmax_t read =
+        stage == HashStage::HEAD ? stages.headBytes : stages.headBytes + stages.tailBytes;
+    savedBytes[static_cast<std::size_t>(stage)] += size - read;
+}
+
+void HashStatistics::add(const HashStatistics &other) {
+    for (std::size_t stage = 0; stage < HASH_STAGES_COUNT; stage++) {
+        hashedFiles[stage] += other.hashedFiles[stage];
+        hashedBytes[stage] += other.hashedBytes[stage];
+        savedBytes[stage] += other.savedBytes[stage];
+    }
+}
+
+HASH::Hash hashMappedMemory(const std::filesystem::path &path, HASH::Algorithm algorithm) {
+    const MemoryMapped file(path.string(), MemoryMapped::MapRange::WholeFile,
+                            MemoryMapped::CacheHint::SequentialScan);
+    return HASH::dispatch(algorithm, [&file](auto policy) {
+        return hashMapped<decltype(policy)>(file);
+    });
+}
+
+std::size_t getSegmentsCount(std::uintmax_t size, const HashStages &stages) {
+    if (size < stages.segmentedHashThreshold || stages.segmentSize == 0) {
+        return 0;
+    }
+    return static_cast<std::size_t>((size + stages.segmentSize - 1) / stages.segmentSize);
+}
+
+std::optional<HASH::Hash> hashSegment(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      std::size_t segment,
+                                      const HashStages &stages) {
+    return HASH::dispatch(stages.algorithm, [&](auto policy) {
+        return hashSegment<decltype(policy)>(path, size, segment, stages);
+    });
+}
+
+HASH::Hash combineSegmentHashes(const std::vector<HASH::Hash> &segmentHashes,
+                                const HashStages &stages) {
+    return HASH::dispatch(stages.algorithm, [&segmentHashes](auto policy) {
+        return combineSegmentHashes<decltype(policy)>(segmentHashes);
+    });
+}
+
+std::optional<HASH::Hash>
+combineSegmentHashes(const std::vector<std::optional<HASH::Hash>> &segmentHashes,
+                     const HashStages &stages) {
+    std::vector<HASH::Hash> hashes;
+    hashes.reserve(segmentHashes.size());
+    for (const std::optional<HASH::Hash> &segmentHash : segmentHashes) {
+        if (!segmentHash) {
+            return std::nullopt;
+        }
+        hashes.push_back(*segmentHash);
+    }
+    return combineSegmentHashes(hashes, stages);
+}
+
+std::optional<HASH::Hash> hashContent(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      const HashStages &stages) {
+    return HASH::dispatch(stages.algorithm, [&](auto policy) {
+        return hashContent<decltype(policy)>(path, size, stages);
+    });
+}
+
+HashStage getLastHashStage(std::uintmax_t size, const HashStages &stages) {
+    if (size <= std::max<std::uintmax_t>(stages.headBytes, stages.singleReadThreshold)) {
+        return HashStage::HEAD;
+    } else if (size <= stages.headBytes + stages.tailBytes) {
+        return HashStage::TAIL;
+    }
+    return HashStage::FULL;
+}
+
+std::optional<HASH::Hash> hashFileStage(const std::filesystem::path &path,
+                                        std::uintmax_t size,
+                                        HashStage stage,
+                                        const HashStages &stages,
+                                        HASH::Hash previousHash) {
+    return HASH::dispatch(stages.algorithm, [&](auto policy) {
+        return hashFileStage<decltype(policy)>(path, size, stage, stages, previousHash);
+    });
+}
 
-    const bool is_p2_base_of_p1 = COMMON::is_in_sub_directory(p1, p2);
-    const bool is_p1_base_of_p2 = COMMON::is_in_sub_directory(p2, p1);
-
-    // compared to a subdirectory
-    if (is_p1_base_of_p2 || is_p2_base_of_p1) {
-        const std::filesystem::path base_dir = is_p2_base_of_p1 ? p2 : p1;
-        const std::filesystem::path sub_dir = is_p2_base_of_p1 ? p1 : p2;
-        duplicates.erase(
-            std::remove_if(
-                duplicates.begin(), duplicates.end(),
-                [&](const auto &duplicate) {
-                    bool has_item_in_base_dir = false;
-                    bool has_item_in_sub_dir = false;
-                    for (const auto fsi : duplicate) {
-                        if (COMMON::is_in_sub_directory(fsi->getPath(), sub_dir)) {
-                            has_item_in_sub_dir = true;
-                        } else if (COMMON::is_in_sub_directory(fsi->getPath(), base_dir) &&
-                                   !COMMON::is_in_sub_directory(fsi->getPath(), sub_dir)) {
-                            has_item_in_base_dir = true;
-                        }
-                    }
-                    return !(has_item_in_sub_dir && has_item_in_base_dir);
-                }),
-            duplicates.end());
+void hashFilesStage(std::vector<HashedFile> &files, HashStage stage, const HashStages &stages) {
+    if (stages.cache == nullptr) {
+        HASH::dispatch(stages.algorithm, [&](auto policy) {
+            hashFilesStage<decltype(policy)>(files, stage, stages);
+        });
         return;
     }
 
+    std::vector<HashedFile> missingFiles;
+    std::vector<std::size_t> positions;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        if (!findCachedHash(files[i], stage, stages)) {
+            missingFiles.push_back(files[i]);
+            positions.push_back(i);
+        }
+    }
+    HASH::dispatch(stages.algorithm, [&](auto policy) {
+        hashFilesStage<decltype(policy)>(missingFiles, stage, stages);
+    });
+    for (std::size_t i = 0; i < missingFiles.size(); i++) {
+        cacheHash(missingFiles[i], stage, stages);
+        files[positions[i]].hash = missingFiles[i].hash;
+        files[positions[i]].unreadable = missingFiles[i].unreadable;
+    }
+}
+
+bool findCachedHash(HashedFile &file, HashStage stage, const HashStages &stages) {
+    if (stages.cache == nullptr) {
+        return false;
+    }
+    // files that changed since the scan are never cached
+    file.cacheKey = HASH::HashCache::getKey(file.path);
+    if (!file.cacheKey || file.cacheKey->size != file.size) {
+        file.cacheKey.reset();
+        return false;
+    }
+    const std::optional<HASH::Hash> hash =
+        stages.cache->find(*file.cacheKey, static_cast<std::size_t>(stage));
+    if (hash) {
+        file.hash = *hash;
+    }
+    return hash.has_value();
+}
+
+void cacheHash(const HashedFile &file, HashStage stage, const HashStages &stages) {
+    if (stages.cache != nullptr && file.cacheKey && !file.unreadable) {
+        stages.cache->insert(*file.cacheKey, static_cast<std::size_t>(stage), file.hash);
+    }
+}
+
+std::uint64_t getCacheConfiguration(const HashStages &stages) {
+    // everything that changes the hash of a stage
+    const std::array<std::uint64_t, 6> configuration{
+        static_cast<std::uint64_t>(stages.algorithm),
+        stages.headBytes,
+        stages.tailBytes,
+        std::max<std::uint64_t>(stages.headBytes, stages.singleReadThreshold),
+        stages.segmentSize,
+        stages.segmentedHashThreshold,
+    };
+    return HASH::XXH3_64Policy::hash(configuration.data(), sizeof(configuration), 0).low;
+}
+
+std::vector<std::size_t> extractDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items,
+                                                       const HashStages &stages,
+                                                       HashStatistics *statistics,
+                                                       std::size_t threads,
+                                                       Engine engine) {
+    return extractDuplicates(items, stages, statistics, threads, engine, nullptr);
+}
+
+std::vector<std::size_t> joinDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items,
+                                                    FileTable::Origins references,
+                                                    const HashStages &stages,
+                                                    HashStatistics *statistics,
+                                                    std::size_t threads,
+                                                    Engine engine) {
+    return extractDuplicates(items, stages, statistics, threads, engine, &references);
+}
+
+std::vector<std::size_t> extractHardlinksAndGetRanges(std::vector<FileSystemItem *> &items) {
+    COMMON::onlyFiles(items);
+    items.erase(std::remove_if(items.begin(), items.end(),
+                               [](const auto item) { return !item->getFileId().isHardlinked(); }),
+                items.end());
+    std::sort(items.begin(), items.end(), [](const auto lhs, const auto rhs) {
+        return lhs->getFileId() != rhs->getFileId() ? lhs->getFileId() < rhs->getFileId()
+                                                    : lhs->comparePath(*rhs) < 0;
+    });
+
+    const auto sameFile = [](const auto lhs, const auto rhs) {
+        return lhs->getFileId() == rhs->getFileId();
+    };
+    // links outside of the analyzed items are not reported
+    std::vector<FileSystemItem *> hardlinks;
+    std::vector<std::size_t> ranges;
+    std::size_t range_start = 0;
+    for (const std::size_t range : getRanges(items, sameFile)) {
+        if (range > 1) {
+            hardlinks.insert(hardlinks.end(), items.begin() + range_start,
+                             items.begin() + range_start + range);
+            ranges.push_back(range);
+        }
+        range_start += range;
+    }
+    items = std::move(hardlinks);
+    return ranges;
+}
+
+std::size_t countDistinctFiles(const std::vector<FileSystemItem *> &items) {
+    std::size_t count = 0;
+    std::unordered_set<SCAN::FileId, SCAN::FileIdHash> hardlinks;
+    for (const FileSystemItem *const item : items) {
+        const SCAN::FileId fileId = item->getFileId();
+        if (!fileId.isHardlinked() || hardlinks.insert(fileId).second) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void removeDuplicatesNotSpanningOrigins(std::vector<std::vector<FileSystemItem *>> &duplicates,
+                                        FileTable::Origins references) {
     duplicates.erase(std::remove_if(duplicates.begin(), duplicates.end(),
-                                    [&](const auto &duplicate) {
-                                        bool has_item_in_p1 = false;
-                                        bool has_item_in_p2 = false;
-                                        for (const auto fsi : duplicate) {
-                                            bool is_in_p1 =
-                                                COMMON::is_in_sub_directory(fsi->getPath(), p1);
-                                            if (is_in_p1) {
-                                                has_item_in_p1 = true;
-                                            } else {
-                                                has_item_in_p2 = true;
-                                            }
-                                        }
-                                        return !(has_item_in_p1 && has_item_in_p2);
+                                    [references](const auto &duplicate) {
+                                        return !spansReferences(duplicate.begin(),
+                                                                duplicate.end(), references);
                                     }),
                      duplicates.end());
 }
@@ -158,8 +1121,7 @@ std::vector<std::vector<FileSystemItem *>> getDuplicateClustersSorted(
     for (auto &cluster : clusters) {
         std::sort(cluster.begin(), cluster.end(), [](const auto lhs, const auto rhs) {
             if (lhs->getRelativeDirDepth() == rhs->getRelativeDirDepth()) {
-                return lhs->getPath().filename().string().size() >
-                       rhs->getPath().filename().string().size();
+                return lhs->getNativeItemName().size() > rhs->getNativeItemName().size();
             } else {
                 return lhs->getRelativeDirDepth() < rhs->getRelativeDirDepth();
             }
@@ -1,11 +1,163 @@
+#pragma once
+
 #include "../fsitem.hpp"
+#include "../hash/hash.hpp"
+#include "../hash/hash_cache.hpp"
+#include "../io/file_reader.hpp"
+
+#include <array>
 
 namespace DDK::FILTER::DEDUPLICATION {
-std::vector<std::size_t> extractDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items);
-void removeDuplicatesNotContainingDuplicatesFromBothPaths(
-    std::vector<std::vector<FileSystemItem *>> &duplicates,
-    const std::filesystem::path &p1,
-    const std::filesystem::path &p2);
+// Files of equal size are told apart in up to three stages, every stage only reads files that
+// still collide: a hash of the first block, a hash of the last block and finally the hash of the
+// whole content. Files that fit into the blocks of the stages so far get their content hash right
+// away, small files are hashed completely by the first stage (see HashStages).
+enum class HashStage {
+    HEAD,
+    TAIL,
+    FULL,
+};
+constexpr std::size_t HASH_STAGES_COUNT = 3;
+// every hashing thread keeps at most one file open or mapped
+constexpr std::size_t MAX_HASHING_THREADS = 64;
+
+struct HashStages {
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+    static constexpr std::uintmax_t DEFAULT_SEGMENT_SIZE = 32 * 1024 * 1024;
+    static constexpr std::uintmax_t DEFAULT_SEGMENTED_HASH_THRESHOLD = 256 * 1024 * 1024;
+    static constexpr std::uintmax_t DEFAULT_MAPPED_READ_THRESHOLD = 1024 * 1024;
+    static constexpr std::uintmax_t DEFAULT_SINGLE_READ_THRESHOLD = 64 * 1024;
+
+    std::size_t headBytes = DEFAULT_BLOCK_SIZE;
+    std::size_t tailBytes = DEFAULT_BLOCK_SIZE;
+    // Files of up to singleReadThreshold bytes get their content hash from the head stage. A
+    // single read of such a file costs about as much as a block, while every further stage would
+    // open it again.
+    std::uintmax_t singleReadThreshold = DEFAULT_SINGLE_READ_THRESHOLD;
+    // The content of files of at least segmentedHashThreshold bytes is hashed in segments of
+    // segmentSize bytes that can be hashed in parallel. Their content hash is the hash of all
+    // segment hashes, so it only depends on these sizes and never on the number of threads.
+    std::uintmax_t segmentSize = DEFAULT_SEGMENT_SIZE;
+    std::uintmax_t segmentedHashThreshold = DEFAULT_SEGMENTED_HASH_THRESHOLD;
+    HASH::Algorithm algorithm = HASH::DEFAULT_ALGORITHM;
+    // The whole content of files of at least mappedReadThreshold bytes is hashed from a memory
+    // mapping, everything else is read with IO::FileReader. Files are never mapped with direct
+    // I/O or dropped caches, since a mapping always goes through the page cache.
+    std::uintmax_t mappedReadThreshold = DEFAULT_MAPPED_READ_THRESHOLD;
+    IO::ReadOptions readOptions;
+    // Files hashed together keep up to this many reads in flight with io_uring and are never
+    // mapped. 0 or a missing io_uring reads every file on its own.
+    unsigned int ioUringQueueDepth = 0;
+    // Consulted before any file is read and updated with every new hash. The slot of a hash is
+    // its HashStage, so the cache has to be opened with getCacheConfiguration().
+    HASH::HashCache *cache = nullptr;
+
+    // bytes read by a stage for a file of the given size
+    std::uintmax_t getStageBytes(std::uintmax_t size, HashStage stage) const;
+};
+
+// how extractDuplicatesAndGetRanges tells files of equal size apart
+enum class Engine {
+    // staged hashes, see HashStage
+    HASH,
+    // Reads all files of a size group chunk by chunk in lockstep and splits the group as soon as
+    // their chunks differ. Only reports files with identical bytes and reads no more than the
+    // hashes would for groups of up to MAX_LOCKSTEP_OPEN_FILES files, which are all kept open.
+    // Duplicates get an id instead of a content hash and no HashStatistics are counted.
+    LOCKSTEP,
+};
+constexpr std::size_t LOCKSTEP_CHUNK_SIZE = 64 * 1024;
+// Larger groups are split by their first chunk, parts that still do not fit are read to the end in
+// batches of that many files.
+constexpr std::size_t MAX_LOCKSTEP_OPEN_FILES = 256;
+
+// counters per HashStage
+struct HashStatistics {
+    std::array<std::size_t, HASH_STAGES_COUNT> hashedFiles{};
+    std::array<std::uintmax_t, HASH_STAGES_COUNT> hashedBytes{};
+    // bytes that were never read because the file was told apart by this stage
+    std::array<std::uintmax_t, HASH_STAGES_COUNT> savedBytes{};
+
+    void addHashed(std::uintmax_t size, HashStage stage, const HashStages &stages);
+    void addDropped(std::uintmax_t size, HashStage stage, const HashStages &stages);
+    void add(const HashStatistics &other);
+};
+
+// hash of the whole file content
+HASH::Hash hashMappedMemory(const std::filesystem::path &path,
+                            HASH::Algorithm algorithm = HASH::DEFAULT_ALGORITHM);
+// the stage that hashes the whole content of a file of the given size
+HashStage getLastHashStage(std::uintmax_t size, const HashStages &stages);
+// number of segments of a file that is hashed in segments, 0 otherwise
+std::size_t getSegmentsCount(std::uintmax_t size, const HashStages &stages);
+// The functions below that read a file return nullopt if it could not be opened or its size is no
+// longer size. Such files must never be grouped by their hash.
+std::optional<HASH::Hash> hashSegment(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      std::size_t segment,
+                                      const HashStages &stages);
+HASH::Hash combineSegmentHashes(const std::vector<HASH::Hash> &segmentHashes,
+                                const HashStages &stages);
+// nullopt if any segment could not be read
+std::optional<HASH::Hash>
+combineSegmentHashes(const std::vector<std::optional<HASH::Hash>> &segmentHashes,
+                     const HashStages &stages);
+// content hash of a file, see HashStages
+std::optional<HASH::Hash> hashContent(const std::filesystem::path &path,
+                                      std::uintmax_t size,
+                                      const HashStages &stages);
+// hash of a file after stage, previousHash is its hash after the previous stage
+std::optional<HASH::Hash> hashFileStage(const std::filesystem::path &path,
+                                        std::uintmax_t size,
+                                        HashStage stage,
+                                        const HashStages &stages,
+                                        HASH::Hash previousHash);
+// file whose hash is replaced by hashFilesStage
+struct HashedFile {
+    std::filesystem::path path;
+    std::uintmax_t size;
+    HASH::Hash hash;
+    // state of the file before it was hashed, set by findCachedHash()
+    std::optional<HASH::HashCache::Key> cacheKey = std::nullopt;
+    // set by hashFilesStage if the file could not be read, its hash is meaningless then
+    bool unreadable = false;
+};
+// same as hashFileStage for every file, see HashStages::ioUringQueueDepth and HashStages::cache
+void hashFilesStage(std::vector<HashedFile> &files, HashStage stage, const HashStages &stages);
+// Sets the hash of file after stage from HashStages::cache and returns true if it was found.
+// Otherwise cacheHash() stores the hash once it is known.
+bool findCachedHash(HashedFile &file, HashStage stage, const HashStages &stages);
+void cacheHash(const HashedFile &file, HashStage stage, const HashStages &stages);
+// identifies the hashes produced by stages, see HASH::HashCache
+std::uint64_t getCacheConfiguration(const HashStages &stages);
+// Keeps only files with identical content stored in at least two distinct files, links of the same
+// file are never duplicates of each other on their own. threads > 1 (or 0 for all hardware threads)
+// hashes the size groups on a work-stealing thread pool of at most MAX_HASHING_THREADS threads,
+// the result does not depend on the number of threads.
+std::vector<std::size_t> extractDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items,
+                                                       const HashStages &stages = {},
+                                                       HashStatistics *statistics = nullptr,
+                                                       std::size_t threads = 1,
+                                                       Engine engine = Engine::HASH);
+// Same as extractDuplicatesAndGetRanges(), but only keeps duplicates that span reference files,
+// files with any of the references origins (see FileTable::Origins), and other files. Only the
+// sizes of the reference files are indexed and other files are only hashed if their size is found
+// in that index. Every hash stage drops the groups that no longer span both sides, so files of
+// one side are never compared among each other on their own.
+std::vector<std::size_t> joinDuplicatesAndGetRanges(std::vector<FileSystemItem *> &items,
+                                                    FileTable::Origins references,
+                                                    const HashStages &stages = {},
+                                                    HashStatistics *statistics = nullptr,
+                                                    std::size_t threads = 1,
+                                                    Engine engine = Engine::HASH);
+// Keeps only files with more than one link among the items, grouped by file.
+std::vector<std::size_t> extractHardlinksAndGetRanges(std::vector<FileSystemItem *> &items);
+// number of items that are stored separately on disk, links of the same file count once
+std::size_t countDistinctFiles(const std::vector<FileSystemItem *> &items);
+// Removes clusters without both files with any of the references origins and other files, see
+// joinDuplicatesAndGetRanges().
+void removeDuplicatesNotSpanningOrigins(std::vector<std::vector<FileSystemItem *>> &duplicates,
+                                        FileTable::Origins references);
 std::vector<std::vector<FileSystemItem *>> getDuplicateClusters(
     const std::vector<FileSystemItem *> &items);
 std::vector<std::vector<FileSystemItem *>> getDuplicateClustersSorted(
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace DDK::FILTER {
+// finalizer of MurmurHash3, spreads keys with few significant bits over all bits
+constexpr std::uint64_t mixBits(std::uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// Flat open addressing map from keys to consecutive group numbers, numbered in order of the first
+// insertion of every key. The table is sized once for maxKeys keys and never grows, lookups probe
+// linearly through two contiguous arrays.
+template <typename Key, typename KeyHash> class GroupIndex {
+  public:
+    using Group = std::uint32_t;
+    static constexpr Group NO_GROUP = std::numeric_limits<Group>::max();
+
+    explicit GroupIndex(std::size_t maxKeys) {
+        // at most two thirds of all slots are used, so probe sequences stay short
+        std::size_t capacity = 16;
+        while (capacity < maxKeys + maxKeys / 2) {
+            capacity *= 2;
+        }
+        m_keys.resize(capacity);
+        m_groups.assign(capacity, NO_GROUP);
+        m_mask = capacity - 1;
+    }
+
+    // group of key, a key that was not inserted before starts a new group
+    Group insert(const Key &key) {
+        std::size_t slot = KeyHash()(key) & m_mask;
+        while (m_groups[slot] != NO_GROUP) {
+            if (m_keys[slot] == key) {
+                return m_groups[slot];
+            }
+            slot = (slot + 1) & m_mask;
+        }
+        m_keys[slot] = key;
+        m_groups[slot] = m_size;
+        return m_size++;
+    }
+
+    // group of key, NO_GROUP if key was never inserted
+    Group find(const Key &key) const {
+        std::size_t slot = KeyHash()(key) & m_mask;
+        while (m_groups[slot] != NO_GROUP) {
+            if (m_keys[slot] == key) {
+                return m_groups[slot];
+            }
+            slot = (slot + 1) & m_mask;
+        }
+        return NO_GROUP;
+    }
+
+    // number of groups
+    std::size_t size() const { return m_size; }
+
+  private:
+    std::vector<Key> m_keys;
+    std::vector<Group> m_groups;
+    std::size_t m_mask;
+    Group m_size = 0;
+};
+} // namespace DDK::FILTER
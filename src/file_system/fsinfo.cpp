@@ -2,26 +2,23 @@
 #include "filter/common.hpp"
 #include "filter/deduplication.hpp"
 
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
 namespace DDK {
-FileSystemInfo::FileSystemInfo(const std::filesystem::path &path, bool analyzeSymLinks) :
+FileSystemInfo::FileSystemInfo(const std::filesystem::path &path,
+                               bool analyzeSymLinks,
+                               std::size_t threads,
+                               SCAN::Backend backend,
+                               SCAN::Snapshot *const snapshot) :
     m_analyzeSymLinks(analyzeSymLinks),
-    m_root(new FileSystemItem(path, nullptr, analyzeSymLinks)) {}
+    m_threads(threads),
+    m_engine(FILTER::DEDUPLICATION::Engine::HASH),
+    m_root(new FileSystemItem(path, nullptr, analyzeSymLinks, threads, backend, snapshot)) {}
 
 FileSystemInfo::~FileSystemInfo() { delete m_root; }
 
-std::vector<FileSystemItem *> FileSystemInfo::getFileSystemItemsRecursive(
-    const FileSystemItem *const item) const {
-    std::vector<FileSystemItem *> items(0);
-
-    for (FileSystemItem *const fsitem : item->getChildren()) {
-        items.push_back(fsitem);
-        std::vector<FileSystemItem *> children = getFileSystemItemsRecursive(fsitem);
-        items.insert(items.end(), children.begin(), children.end());
-    }
-
-    return items;
-}
-
 std::vector<FileSystemItem *> FileSystemInfo::getCurrentDirItems(bool sortedBySize,
                                                                  bool onlyFiles) const {
     std::vector<FileSystemItem *> items = m_root->getChildren();
@@ -31,7 +28,7 @@ std::vector<FileSystemItem *> FileSystemInfo::getCurrentDirItems(bool sortedBySi
     }
 
     if (sortedBySize) {
-        FILTER::COMMON::sortFSitemsBySize(items);
+        FILTER::COMMON::sortFSitemsBySize(items, m_threads);
     }
 
     return items;
@@ -39,15 +36,18 @@ std::vector<FileSystemItem *> FileSystemInfo::getCurrentDirItems(bool sortedBySi
 
 std::vector<FileSystemItem *> FileSystemInfo::getAllFileSystemItems(bool sortedBySize,
                                                                     bool onlyFiles) const {
-    std::vector<FileSystemItem *> items = getFileSystemItemsRecursive(m_root);
-    items.push_back(m_root);
+    std::vector<FileSystemItem *> items;
+    items.reserve(getDirectoriesCount() + getFilesCount() + getSymlinksCount());
+    forEachItem([&items](FileSystemItem *const item) { items.push_back(item); });
+    // the root comes last
+    std::rotate(items.begin(), items.begin() + 1, items.end());
 
     if (onlyFiles) {
         FILTER::COMMON::onlyFiles(items);
     }
 
     if (sortedBySize) {
-        FILTER::COMMON::sortFSitemsBySize(items);
+        FILTER::COMMON::sortFSitemsBySize(items, m_threads);
     }
 
     return items;
@@ -56,24 +56,100 @@ std::vector<FileSystemItem *> FileSystemInfo::getAllFileSystemItems(bool sortedB
 std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> FileSystemInfo::getDuplicates()
     const {
     auto items = getAllFileSystemItems();
-    auto ranges = FILTER::DEDUPLICATION::extractDuplicatesAndGetRanges(items);
+    m_hashStatistics = {};
+    auto ranges = FILTER::DEDUPLICATION::extractDuplicatesAndGetRanges(
+        items, m_hashStages, &m_hashStatistics, m_threads, m_engine);
+    return {items, ranges};
+}
+
+std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> FileSystemInfo::getHardlinks()
+    const {
+    auto items = getAllFileSystemItems();
+    auto ranges = FILTER::DEDUPLICATION::extractHardlinksAndGetRanges(items);
     return {items, ranges};
 }
 
 std::vector<std::vector<FileSystemItem *>> FileSystemInfo::getDuplicatesFromCompare(
-    const FileSystemInfo *const compare) const {
+    const std::vector<const FileSystemInfo *> &compares) const {
+    if (compares.size() > MAX_COMPARES) {
+        throw std::length_error("too many compared paths");
+    }
+    tagOrigins(compares);
+
     auto items = getAllFileSystemItems();
-    auto items_compare = compare->getAllFileSystemItems();
-    items.insert(items.end(), items_compare.begin(), items_compare.end());
+    bool comparedToItself = false;
+    for (const FileSystemInfo *const compare : compares) {
+        auto items_compare = compare->getAllFileSystemItems();
+        items.insert(items.end(), items_compare.begin(), items_compare.end());
+        comparedToItself |= getRootPath() == compare->getRootPath();
+    }
 
     FILTER::COMMON::removeFSItemsWithIdenticalPath(items);
-    FILTER::DEDUPLICATION::extractDuplicatesAndGetRanges(items);
+    m_hashStatistics = {};
+    if (comparedToItself) {
+        FILTER::DEDUPLICATION::extractDuplicatesAndGetRanges(items, m_hashStages, &m_hashStatistics,
+                                                             m_threads, m_engine);
+        return FILTER::DEDUPLICATION::getDuplicateClustersSorted(items);
+    }
+
+    // only files of the path that match files of a compared path are ever hashed
+    FILTER::DEDUPLICATION::joinDuplicatesAndGetRanges(items, COMPARE_ORIGINS, m_hashStages,
+                                                      &m_hashStatistics, m_threads, m_engine);
     auto duplicates = FILTER::DEDUPLICATION::getDuplicateClustersSorted(items);
-    FILTER::DEDUPLICATION::removeDuplicatesNotContainingDuplicatesFromBothPaths(
-        duplicates, getRootPath(), compare->getRootPath());
+    FILTER::DEDUPLICATION::removeDuplicatesNotSpanningOrigins(duplicates, COMPARE_ORIGINS);
     return duplicates;
 }
 
+std::vector<std::vector<FileSystemItem *>> FileSystemInfo::getDuplicatesFromCompare(
+    const FileSystemInfo *const compare) const {
+    return getDuplicatesFromCompare(std::vector<const FileSystemInfo *>{compare});
+}
+
+void FileSystemInfo::tagOrigins(const std::vector<const FileSystemInfo *> &compares) const {
+    std::vector<const FileSystemInfo *> roots{this};
+    roots.insert(roots.end(), compares.begin(), compares.end());
+    const auto getOrigin = [](std::size_t root) {
+        return root == 0 ? PATH_ORIGIN : getCompareOrigin(root - 1);
+    };
+
+    // a root path lies within every root whose tree contains it, including its own
+    std::vector<FileTable::Origins> rootOrigins(roots.size(), 0);
+    for (std::size_t root = 0; root < roots.size(); root++) {
+        for (std::size_t other = 0; other < roots.size(); other++) {
+            if (roots[other]->m_root->findItem(roots[root]->getRootPath()) != nullptr) {
+                rootOrigins[root] |= getOrigin(other);
+            }
+        }
+    }
+
+    // outer roots first, so the subtrees of nested roots replace their origins afterwards
+    std::vector<std::size_t> order(roots.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&roots](std::size_t lhs, std::size_t rhs) {
+        const std::filesystem::path lhsPath = roots[lhs]->getRootPath();
+        const std::filesystem::path rhsPath = roots[rhs]->getRootPath();
+        return std::distance(lhsPath.begin(), lhsPath.end()) <
+               std::distance(rhsPath.begin(), rhsPath.end());
+    });
+    for (const FileSystemInfo *const tree : roots) {
+        for (const std::size_t root : order) {
+            if (FileSystemItem *const nested = tree->m_root->findItem(roots[root]->getRootPath())) {
+                nested->setOrigins(rootOrigins[root]);
+            }
+        }
+    }
+}
+
+void FileSystemInfo::setHashStages(const FILTER::DEDUPLICATION::HashStages &stages) {
+    m_hashStages = stages;
+}
+
+void FileSystemInfo::setEngine(FILTER::DEDUPLICATION::Engine engine) { m_engine = engine; }
+
+FILTER::DEDUPLICATION::HashStatistics FileSystemInfo::getHashStatistics() const {
+    return m_hashStatistics;
+}
+
 std::size_t FileSystemInfo::getDirectoriesCount() const {
     const std::size_t root_counts =
         (m_root->getItemType() == std::filesystem::file_type::directory) ? 1 : 0;
@@ -91,6 +167,8 @@ std::size_t FileSystemInfo::getFilesCount() const {
 
 std::uintmax_t FileSystemInfo::getTotalSize() const { return m_root->getSizeInBytes(); }
 
+std::size_t FileSystemInfo::getMemoryUsage() const { return m_root->getTreeMemoryUsage(); }
+
 std::filesystem::path FileSystemInfo::getRootPath() const { return m_root->getPath(); }
 
 bool FileSystemInfo::symlinks() const { return m_analyzeSymLinks; }
@@ -1,33 +1,77 @@
 #pragma once
 
 #include "data_types.hpp"
+#include "filter/deduplication.hpp"
 #include "fsitem.hpp"
 
 namespace DDK {
 class FileSystemInfo {
   public:
-    FileSystemInfo(const std::filesystem::path &path, bool analyzeSymLinks);
+    // threads is used for scanning and for hashing the candidates of getDuplicates(). Directories
+    // that did not change since they were stored in snapshot are not listed again, the snapshot
+    // has to be opened with the same analyzeSymLinks and may be shared by several instances.
+    FileSystemInfo(const std::filesystem::path &path,
+                   bool analyzeSymLinks,
+                   std::size_t threads = 1,
+                   SCAN::Backend backend = SCAN::Backend::DEFAULT,
+                   SCAN::Snapshot *const snapshot = nullptr);
     ~FileSystemInfo();
 
     std::vector<FileSystemItem *> getCurrentDirItems(bool sortedBySize = false,
                                                      bool onlyFiles = false) const;
     std::vector<FileSystemItem *> getAllFileSystemItems(bool sortedBySize = false,
                                                         bool onlyFiles = false) const;
+    // Calls visitor with every item of the tree in depth first order, starting with the root.
+    // The tree is walked in place, nothing is allocated.
+    template <typename Visitor> void forEachItem(Visitor &&visitor) const {
+        for (FileSystemItem *item = m_root; item != nullptr; item = item->getNextInTree(*m_root)) {
+            visitor(item);
+        }
+    }
     std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> getDuplicates() const;
+    // files with more than one link within the analyzed path, same layout as getDuplicates()
+    std::tuple<std::vector<FileSystemItem *>, std::vector<std::size_t>> getHardlinks() const;
+    // Origins of the items returned by getDuplicatesFromCompare(), see
+    // FileSystemItem::getOrigins(). Every root path has its own bit, so items within nested root
+    // paths carry several of them.
+    static constexpr FileTable::Origins PATH_ORIGIN = 0x01;
+    static constexpr FileTable::Origins COMPARE_ORIGINS =
+        static_cast<FileTable::Origins>(~PATH_ORIGIN);
+    static constexpr std::size_t MAX_COMPARES = std::numeric_limits<FileTable::Origins>::digits - 1;
+    // origin of the items within the root path of compares[compare]
+    static constexpr FileTable::Origins getCompareOrigin(std::size_t compare) {
+        return static_cast<FileTable::Origins>(PATH_ORIGIN << (compare + 1));
+    }
+
+    // Clusters of duplicates that span files within the root path that are not within any root
+    // path of compares and files within at least one root path of compares. All trees are hashed
+    // together in a single pass. Throws std::length_error for more than MAX_COMPARES compares.
+    std::vector<std::vector<FileSystemItem *>> getDuplicatesFromCompare(
+        const std::vector<const FileSystemInfo *> &compares) const;
     std::vector<std::vector<FileSystemItem *>> getDuplicatesFromCompare(
         const FileSystemInfo *const compare) const;
+    void setHashStages(const FILTER::DEDUPLICATION::HashStages &stages);
+    void setEngine(FILTER::DEDUPLICATION::Engine engine);
+    // counters of the last duplicate search
+    FILTER::DEDUPLICATION::HashStatistics getHashStatistics() const;
     std::size_t getDirectoriesCount() const;
     std::size_t getSymlinksCount() const;
     std::size_t getFilesCount() const;
     std::uintmax_t getTotalSize() const;
+    // heap memory used for storing all analyzed items
+    std::size_t getMemoryUsage() const;
     std::filesystem::path getRootPath() const;
     bool symlinks() const;
 
   private:
     FileSystemItem *m_root;
     const bool m_analyzeSymLinks;
+    const std::size_t m_threads;
+    FILTER::DEDUPLICATION::HashStages m_hashStages;
+    FILTER::DEDUPLICATION::Engine m_engine;
+    mutable FILTER::DEDUPLICATION::HashStatistics m_hashStatistics;
 
-    std::vector<FileSystemItem *> getFileSystemItemsRecursive(
-        const FileSystemItem *const item) const;
+    // tags every item of all trees with the root paths it lies within
+    void tagOrigins(const std::vector<const FileSystemInfo *> &compares) const;
 };
 } // namespace DDK
@@ -1,122 +1,167 @@
-#include <array>
-
 #include "fsitem.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "scan/tree_walker.hpp"
 
 namespace DDK {
 FileSystemItem::FileSystemItem(const std::filesystem::path &path,
                                const FileSystemItem *const parent,
-                               bool analyzeSymlinks) :
-    m_path(path),
-    m_parent(parent),
-    m_analyzeSymlinks(analyzeSymlinks),
-    m_relativeDirDepth(parent != nullptr ? parent->getRelativeDirDepth() + 1 : 0) {
-    m_children = {};
-    m_duplicates = {};
-    m_potentialDuplicates = {};
-
-    m_size = 0;
-    m_childFilesCount = 0;
-    m_childSubDirectoriesCount = 0;
-    m_childSymlinksCount = std::filesystem::is_symlink(m_path) ? 1 : 0;
-    m_hash = 0;
-
-    m_type = std::filesystem::status(path).type();
-
-    if (!std::filesystem::exists(m_path) || m_type == std::filesystem::file_type::not_found) {
-        m_error = FileSystemError::PATH_DOES_NOT_EXIST;
+                               bool analyzeSymlinks,
+                               std::size_t threads,
+                               SCAN::Backend backend,
+                               SCAN::Snapshot *const snapshot) :
+    m_table(new FileTable()), m_index(0), m_ownsTable(true) {
+    const std::size_t depth = parent != nullptr ? parent->getRelativeDirDepth() + 1 : 0;
+    const bool symlink = std::filesystem::is_symlink(path);
+    const std::filesystem::file_type type = std::filesystem::status(path).type();
+
+    if (!std::filesystem::exists(path) || type == std::filesystem::file_type::not_found) {
+        m_table->addRoot(path, type, 0, symlink, FileSystemError::PATH_DOES_NOT_EXIST, depth);
+        m_table->finalize(this, parent);
         return;
     }
 
-    if (m_type == std::filesystem::file_type::directory) {
-        analyzeChildren();
-    } else {
-        m_size = std::filesystem::file_size(m_path);
+    const std::uintmax_t size =
+        type != std::filesystem::file_type::directory ? std::filesystem::file_size(path) : 0;
+    const SCAN::FileId fileId =
+        type == std::filesystem::file_type::regular ? SCAN::getFileId(path) : SCAN::FileId{};
+    m_table->addRoot(path, type, size, symlink, FileSystemError::NO_ERROR, depth, fileId);
+
+    if (type == std::filesystem::file_type::directory) {
+        FileTable &table = *m_table;
+        const SCAN::ListingHandler onListing =
+            [&table](SCAN::DirectoryId directory, const std::vector<SCAN::DirectoryEntry> &entries,
+                     std::vector<SCAN::DirectoryId> &subdirectories) {
+                const FileTable::Index firstChild = table.addChildren(directory, entries);
+                for (std::size_t i = 0; i < entries.size(); i++) {
+                    if (entries[i].type == std::filesystem::file_type::directory) {
+                        subdirectories.push_back(firstChild + static_cast<FileTable::Index>(i));
+                    }
+                }
+            };
+        // permission denied, directory deleted, etc.
+        // the table drops this directory while accumulating
+        const SCAN::ErrorHandler onError = [&table](SCAN::DirectoryId directory) {
+            table.setError(directory, FileSystemError::ACCESS_DENIED);
+        };
+
+        if (PARALLEL::resolveThreadsCount(threads) == 1) {
+            SCAN::walkTree(path, 0, analyzeSymlinks, backend, nullptr, onListing, onError,
+                           snapshot);
+        } else {
+            PARALLEL::WorkStealingPool pool(threads);
+            SCAN::walkTree(path, 0, analyzeSymlinks, backend, &pool, onListing, onError, snapshot);
+            pool.wait();
+        }
     }
 
-    m_error = FileSystemError::NO_ERROR;
+    m_table->finalize(this, parent);
 }
 
+FileSystemItem::FileSystemItem(FileTable *const table, FileTable::Index index) :
+    m_table(table), m_index(index), m_ownsTable(false) {}
+
+FileSystemItem::FileSystemItem(const FileSystemItem &other) :
+    m_table(other.m_table), m_index(other.m_index), m_ownsTable(false) {}
+
 FileSystemItem::~FileSystemItem() {
-    for (const FileSystemItem *item : m_children) {
-        delete item;
+    if (m_ownsTable) {
+        delete m_table;
     }
 }
 
-bool FileSystemItem::analyzeChildren() {
-    for (const auto &directoryEntry : std::filesystem::directory_iterator(m_path)) {
-        FileSystemItem *item;
-        try {
-            if ((!m_analyzeSymlinks && std::filesystem::is_symlink(directoryEntry)) &&
-                (std::filesystem::status(directoryEntry).type() !=
-                     std::filesystem::file_type::directory ||
-                 std::filesystem::status(directoryEntry).type() !=
-                     std::filesystem::file_type::regular)) {
-                continue;
-            }
-
-            item = new FileSystemItem(directoryEntry.path(), this, m_analyzeSymlinks);
-            m_children.push_back(item);
-        } catch (const std::exception &e) {
-            delete item;
-            // permission denied, file deleted, etc.
-            // ignore this file system entry and continue
-        }
-    }
-    for (const FileSystemItem *item : m_children) {
-        m_size += item->getSizeInBytes();
-        m_childSymlinksCount += item->m_childSymlinksCount;
-
-        if (item->getItemType() == std::filesystem::file_type::directory) {
-            m_childSubDirectoriesCount += 1 + item->m_childSubDirectoriesCount;
-            m_childFilesCount += item->m_childFilesCount;
-        } else if (item->getItemType() == std::filesystem::file_type::regular) {
-            m_childFilesCount++;
-        }
-    }
-    return true;
+const FileSystemItem *const FileSystemItem::getParent() const {
+    const FileTable::Index parent = m_table->getParent(m_index);
+    return parent != FileTable::NO_INDEX ? m_table->getItem(parent) : m_table->getRootParent();
 }
 
-const FileSystemItem *const FileSystemItem::getParent() const { return m_parent; }
+std::uintmax_t FileSystemItem::getSizeInBytes() const { return m_table->getSize(m_index); }
 
-std::uintmax_t FileSystemItem::getSizeInBytes() const { return m_size; }
+std::filesystem::path FileSystemItem::getPath() const { return m_table->getPath(m_index); }
+
+std::size_t FileSystemItem::getRelativeDirDepth() const { return m_table->getDepth(m_index); }
+
+std::filesystem::file_type FileSystemItem::getItemType() const {
+    return m_table->getType(m_index);
+}
+
+std::vector<FileSystemItem *> FileSystemItem::getChildren() const {
+    return m_table->getChildren(m_index);
+}
+
+FileTable::ChildRange FileSystemItem::getChildRange() const {
+    return m_table->getChildRange(m_index);
+}
 
-std::filesystem::path FileSystemItem::getPath() const { return m_path; }
+FileSystemItem *FileSystemItem::getNextInTree(const FileSystemItem &root) const {
+    const FileTable::Index next = m_table->getNextInTree(root.m_index, m_index);
+    return next != FileTable::NO_INDEX ? m_table->getItem(next) : nullptr;
+}
 
-std::size_t FileSystemItem::getRelativeDirDepth() const { return m_relativeDirDepth; }
+FileSystemItem *FileSystemItem::findItem(const std::filesystem::path &path) const {
+    const FileTable::Index index = m_table->find(path);
+    return index != FileTable::NO_INDEX ? m_table->getItem(index) : nullptr;
+}
 
-std::filesystem::file_type FileSystemItem::getItemType() const { return m_type; }
+void FileSystemItem::setOrigins(FileTable::Origins origins) {
+    m_table->setOrigins(m_index, origins);
+}
 
-std::vector<FileSystemItem *> FileSystemItem::getChildren() const { return m_children; }
+FileTable::Origins FileSystemItem::getOrigins() const { return m_table->getOrigins(m_index); }
 
 void FileSystemItem::addDuplicate(FileSystemItem *const duplicate) {
-    m_duplicates.insert(duplicate);
+    m_table->addDuplicate(m_index, duplicate);
 }
 
 void FileSystemItem::addPotentialDuplicate(FileSystemItem *const duplicate) {
-    m_potentialDuplicates.insert(duplicate);
+    m_table->addPotentialDuplicate(m_index, duplicate);
 }
 
-std::set<FileSystemItem *> FileSystemItem::getDuplicates() const { return m_duplicates; }
+const std::set<FileSystemItem *> &FileSystemItem::getDuplicates() const {
+    return m_table->getDuplicates(m_index);
+}
 
-std::set<FileSystemItem *> FileSystemItem::getPotentialDuplicates() const {
-    return m_potentialDuplicates;
+const std::set<FileSystemItem *> &FileSystemItem::getPotentialDuplicates() const {
+    return m_table->getPotentialDuplicates(m_index);
 }
 
-std::string FileSystemItem::getItemName() const { return m_path.filename().string(); }
+std::string FileSystemItem::getItemName() const {
+    return std::filesystem::path(getNativeItemName()).string();
+}
 
-std::string FileSystemItem::getPathAsString() const { return m_path.string(); }
+std::basic_string_view<std::filesystem::path::value_type> FileSystemItem::getNativeItemName()
+    const {
+    return m_table->getName(m_index);
+}
 
-FileSystemError FileSystemItem::getError() const { return m_error; }
+int FileSystemItem::comparePath(const FileSystemItem &other) const {
+    return m_table->comparePaths(m_index, *other.m_table, other.m_index);
+}
 
-std::size_t FileSystemItem::getChildFilesCount() const { return m_childFilesCount; }
+void FileSystemItem::getPathKey(std::filesystem::path::string_type &key) const {
+    m_table->getPathKey(m_index, key);
+}
+
+std::string FileSystemItem::getPathAsString() const { return getPath().string(); }
+
+FileSystemError FileSystemItem::getError() const { return m_table->getError(m_index); }
+
+SCAN::FileId FileSystemItem::getFileId() const { return m_table->getFileId(m_index); }
+
+std::size_t FileSystemItem::getChildFilesCount() const {
+    return m_table->getChildFilesCount(m_index);
+}
 
 std::size_t FileSystemItem::getChildSubDirectoriesCount() const {
-    return m_childSubDirectoriesCount;
+    return m_table->getChildSubDirectoriesCount(m_index);
+}
+
+std::size_t FileSystemItem::getChildSymlinksCount() const {
+    return m_table->getChildSymlinksCount(m_index);
 }
 
-std::size_t FileSystemItem::getChildSymlinksCount() const { return m_childSymlinksCount; }
+void FileSystemItem::setHash(HASH::Hash hash) { m_table->setHash(m_index, hash); }
 
-void FileSystemItem::setHash(std::uint64_t hash) { m_hash = hash; }
+HASH::Hash FileSystemItem::getHash() const { return m_table->getHash(m_index); }
 
-std::uint64_t FileSystemItem::getHash() const { return m_hash; }
+std::size_t FileSystemItem::getTreeMemoryUsage() const { return m_table->getMemoryUsage(); }
 } // namespace DDK
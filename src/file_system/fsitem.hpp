@@ -3,8 +3,13 @@
 #include <filesystem>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "file_table.hpp"
+#include "scan/directory_reader.hpp"
+#include "scan/snapshot.hpp"
+
 namespace DDK {
 // TODO: replace with std::system_error
 enum class FileSystemError {
@@ -13,11 +18,21 @@ enum class FileSystemError {
     PATH_DOES_NOT_EXIST,
 };
 
+// View of a single item of a FileTable. The item constructed through the public constructor scans
+// the whole tree and owns the table, all items returned by it stay valid as long as it exists.
 class FileSystemItem {
   public:
+    // threads > 1 (or 0 for all hardware threads) distributes the analysis of subdirectories
+    // across a work-stealing thread pool, see SCAN::walkTree() for snapshot
     FileSystemItem(const std::filesystem::path &path,
                    const FileSystemItem *const parent,
-                   bool analyzeSymlinks = false);
+                   bool analyzeSymlinks = false,
+                   std::size_t threads = 1,
+                   SCAN::Backend backend = SCAN::Backend::DEFAULT,
+                   SCAN::Snapshot *const snapshot = nullptr);
+    // copies are non owning views of the same item
+    FileSystemItem(const FileSystemItem &other);
+    FileSystemItem &operator=(const FileSystemItem &) = delete;
     ~FileSystemItem();
 
     const FileSystemItem *const getParent() const;
@@ -26,35 +41,45 @@ class FileSystemItem {
     std::filesystem::file_type getItemType() const;
     std::uintmax_t getSizeInBytes() const;
     std::string getItemName() const;
+    // name without any conversion or allocation
+    std::basic_string_view<std::filesystem::path::value_type> getNativeItemName() const;
     std::string getPathAsString() const;
+    // same result as getPath().compare(other.getPath()) without rebuilding the paths
+    int comparePath(const FileSystemItem &other) const;
+    // see FileTable::getPathKey()
+    void getPathKey(std::filesystem::path::string_type &key) const;
     FileSystemError getError() const;
+    // {0, 0} unless this is a regular file with more than one hard link
+    SCAN::FileId getFileId() const;
     std::size_t getChildFilesCount() const;
     std::size_t getChildSubDirectoriesCount() const;
     std::size_t getChildSymlinksCount() const;
     std::vector<FileSystemItem *> getChildren() const;
+    // same children as getChildren() without copying them into a vector
+    FileTable::ChildRange getChildRange() const;
+    // item following this one in depth first order within the tree of root, nullptr after the last
+    FileSystemItem *getNextInTree(const FileSystemItem &root) const;
+    // item at path within the tree of this item, nullptr if there is none
+    FileSystemItem *findItem(const std::filesystem::path &path) const;
+    // see FileTable::setOrigins()
+    void setOrigins(FileTable::Origins origins);
+    FileTable::Origins getOrigins() const;
     void addDuplicate(FileSystemItem *const duplicate);
     void addPotentialDuplicate(FileSystemItem *const duplicate);
-    std::set<FileSystemItem *> getDuplicates() const;
-    std::set<FileSystemItem *> getPotentialDuplicates() const;
-    void setHash(std::uint64_t hash);
-    std::uint64_t getHash() const;
+    const std::set<FileSystemItem *> &getDuplicates() const;
+    const std::set<FileSystemItem *> &getPotentialDuplicates() const;
+    void setHash(HASH::Hash hash);
+    HASH::Hash getHash() const;
+    // heap memory used by the whole tree this item belongs to
+    std::size_t getTreeMemoryUsage() const;
 
   private:
-    bool analyzeChildren();
-
-    const FileSystemItem *const m_parent;
-    const std::filesystem::path m_path;
-    const std::size_t m_relativeDirDepth;
-    const bool m_analyzeSymlinks;
-    std::filesystem::file_type m_type;
-    std::uintmax_t m_size;
-    std::uint64_t m_hash;
-    std::size_t m_childFilesCount;
-    std::size_t m_childSubDirectoriesCount;
-    std::size_t m_childSymlinksCount;
-    std::vector<FileSystemItem *> m_children;
-    std::set<FileSystemItem *> m_duplicates;
-    std::set<FileSystemItem *> m_potentialDuplicates;
-    FileSystemError m_error;
+    friend class FileTable;
+
+    FileSystemItem(FileTable *const table, FileTable::Index index);
+
+    FileTable *const m_table;
+    const FileTable::Index m_index;
+    const bool m_ownsTable;
 };
 } // namespace DDK
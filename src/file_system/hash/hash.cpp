@@ -0,0 +1,25 @@
+#include "hash.hpp"
+
+namespace DDK::HASH {
+std::optional<Algorithm> parseAlgorithm(const std::string &name) {
+    for (const Algorithm algorithm :
+         {Algorithm::XXHASH64, Algorithm::XXHASH3_64, Algorithm::XXHASH3_128}) {
+        if (name == getAlgorithmName(algorithm)) {
+            return algorithm;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string getAlgorithmName(Algorithm algorithm) {
+    switch (algorithm) {
+    case Algorithm::XXHASH64:
+        return "xxh64";
+    case Algorithm::XXHASH3_64:
+        return "xxh3-64";
+    case Algorithm::XXHASH3_128:
+    default:
+        return "xxh3-128";
+    }
+}
+} // namespace DDK::HASH
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace DDK::HASH {
+// Content hash of a file. 128 bits are stored for every algorithm, algorithms with 64 bit digests
+// only use low.
+struct Hash {
+    constexpr Hash(std::uint64_t low = 0, std::uint64_t high = 0) : low(low), high(high) {}
+
+    std::uint64_t low;
+    std::uint64_t high;
+};
+
+constexpr bool operator==(const Hash &lhs, const Hash &rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+constexpr bool operator!=(const Hash &lhs, const Hash &rhs) { return !(lhs == rhs); }
+constexpr bool operator<(const Hash &lhs, const Hash &rhs) {
+    return lhs.high != rhs.high ? lhs.high < rhs.high : lhs.low < rhs.low;
+}
+constexpr bool operator>(const Hash &lhs, const Hash &rhs) { return rhs < lhs; }
+
+enum class Algorithm {
+    XXHASH64,
+    XXHASH3_64,
+    XXHASH3_128,
+};
+// A 64 bit digest is likely to collide somewhere among tens of millions of files
+constexpr Algorithm DEFAULT_ALGORITHM = Algorithm::XXHASH3_128;
+
+// names used by the command line: xxh64, xxh3-64 and xxh3-128
+std::optional<Algorithm> parseAlgorithm(const std::string &name);
+std::string getAlgorithmName(Algorithm algorithm);
+} // namespace DDK::HASH
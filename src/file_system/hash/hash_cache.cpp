@@ -0,0 +1,236 @@
+#include "hash_cache.hpp"
+#include "MemoryMapped.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace DDK::HASH {
+namespace {
+constexpr char MAGIC[8] = {'D', 'D', 'K', 'C', 'A', 'C', 'H', 'E'};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entrySize;
+    std::uint64_t configuration;
+    std::uint64_t count;
+};
+
+bool sameFile(const HashCache::Key &lhs, const HashCache::Key &rhs) {
+    return lhs.device == rhs.device && lhs.inode == rhs.inode;
+}
+
+bool sameState(const HashCache::Key &lhs, const HashCache::Key &rhs) {
+    return lhs.size == rhs.size && lhs.mtime == rhs.mtime && lhs.ctime == rhs.ctime;
+}
+
+bool lessFile(const HashCache::Key &lhs, const HashCache::Key &rhs) {
+    return lhs.device != rhs.device ? lhs.device < rhs.device : lhs.inode < rhs.inode;
+}
+} // namespace
+
+std::size_t
+HashCache::FileIdHash::operator()(const std::pair<std::uint64_t, std::uint64_t> &id) const {
+    return std::hash<std::uint64_t>()(id.second) ^ (std::hash<std::uint64_t>()(id.first) << 1);
+}
+
+HashCache::HashCache(const std::filesystem::path &path, std::uint64_t configuration)
+    : m_path(path), m_configuration(configuration),
+      m_now(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count()),
+      m_racyAfter(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch() - RACY_INTERVAL)
+                      .count()) {
+    static_assert(sizeof(Entry) == 104, "entries are stored without padding");
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        return;
+    }
+    m_file = std::make_unique<MemoryMapped>();
+    if (!m_file->open(path.string(), MemoryMapped::MapRange::WholeFile,
+                      MemoryMapped::CacheHint::RandomAccess) ||
+        m_file->size() < sizeof(Header)) {
+        return;
+    }
+
+    // a file of another version, configuration or byte order starts an empty cache
+    Header header;
+    std::memcpy(&header, m_file->getData(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.entrySize != sizeof(Entry) || header.configuration != configuration ||
+        m_file->size() != sizeof(Header) + header.count * sizeof(Entry)) {
+        return;
+    }
+    m_loaded = reinterpret_cast<const Entry *>(m_file->getData() + sizeof(Header));
+    m_loadedCount = static_cast<std::size_t>(header.count);
+}
+
+HashCache::~HashCache() = default;
+
+std::optional<HashCache::Key> HashCache::getKey(const std::filesystem::path &file) {
+#if defined(_WIN32)
+    return std::nullopt;
+#else
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0) {
+        return std::nullopt;
+    }
+#if defined(__APPLE__)
+    const timespec &mtime = status.st_mtimespec;
+    const timespec &ctime = status.st_ctimespec;
+#else
+    const timespec &mtime = status.st_mtim;
+    const timespec &ctime = status.st_ctim;
+#endif
+    constexpr std::int64_t NANOSECONDS = 1000000000;
+    return Key{static_cast<std::uint64_t>(status.st_dev), static_cast<std::uint64_t>(status.st_ino),
+               static_cast<std::uint64_t>(status.st_size),
+               static_cast<std::int64_t>(mtime.tv_sec) * NANOSECONDS + mtime.tv_nsec,
+               static_cast<std::int64_t>(ctime.tv_sec) * NANOSECONDS + ctime.tv_nsec};
+#endif
+}
+
+const HashCache::Entry *HashCache::findLoaded(const Key &key) const {
+    const Entry *const end = m_loaded + m_loadedCount;
+    const Entry *const entry =
+        std::lower_bound(m_loaded, end, key,
+                         [](const Entry &lhs, const Key &rhs) { return lessFile(lhs.key, rhs); });
+    return entry != end && sameFile(entry->key, key) ? entry : nullptr;
+}
+
+std::optional<Hash> HashCache::find(const Key &key, std::size_t slot) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    const auto updated = m_updates.find({key.device, key.inode});
+    const Entry *const entry = updated != m_updates.end() ? &updated->second : findLoaded(key);
+    if (entry == nullptr || !sameState(entry->key, key) || (entry->slots & (1u << slot)) == 0) {
+        m_misses++;
+        return std::nullopt;
+    }
+
+    m_hits++;
+    const Hash hash = entry->hashes[slot];
+    if (updated == m_updates.end()) {
+        Entry &seen = m_updates.try_emplace({key.device, key.inode}, *entry).first->second;
+        seen.lastSeen = m_now;
+    }
+    return hash;
+}
+
+void HashCache::insert(const Key &key, std::size_t slot, Hash hash) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    const auto [updated, added] = m_updates.try_emplace({key.device, key.inode});
+    Entry &entry = updated->second;
+    if (added) {
+        const Entry *const loaded = findLoaded(key);
+        entry = loaded != nullptr ? *loaded : Entry{key, 0, 0, 0, {}};
+    }
+    // the file changed since its hashes were stored
+    if (!sameState(entry.key, key)) {
+        entry = Entry{key, 0, 0, 0, {}};
+    }
+    entry.hashes[slot] = hash;
+    entry.slots |= 1u << slot;
+    entry.lastSeen = m_now;
+}
+
+bool HashCache::save() { return write(INT64_MIN).has_value(); }
+
+std::optional<std::size_t> HashCache::compact(std::chrono::seconds maxAge) {
+    return write(m_now - maxAge.count());
+}
+
+std::optional<std::size_t> HashCache::write(std::int64_t oldest) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<Entry> updates;
+    updates.reserve(m_updates.size());
+    for (const auto &[id, entry] : m_updates) {
+        updates.push_back(entry);
+    }
+    std::sort(updates.begin(), updates.end(),
+              [](const Entry &lhs, const Entry &rhs) { return lessFile(lhs.key, rhs.key); });
+
+    // written next to the cache file and renamed, so readers never see a partial file
+    std::filesystem::path temporary = m_path;
+    temporary += ".tmp";
+#if !defined(_WIN32)
+    temporary += std::to_string(getpid());
+#endif
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    Header header{{}, VERSION, sizeof(Entry), m_configuration, 0};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+
+    // both lists are sorted, updated entries replace their loaded ones
+    std::size_t dropped = 0;
+    const auto writeEntry = [this, &file, &header, &dropped, oldest](const Entry &entry) {
+        if (entry.key.mtime >= m_racyAfter || entry.key.ctime >= m_racyAfter) {
+            // the file may still change without a new mtime or ctime, its hashes are only used
+            // during this run
+            return;
+        }
+        if (entry.lastSeen >= oldest) {
+            file.write(reinterpret_cast<const char *>(&entry), sizeof(Entry));
+            header.count++;
+        } else {
+            dropped++;
+        }
+    };
+    auto update = updates.begin();
+    for (std::size_t loaded = 0; loaded < m_loadedCount; loaded++) {
+        const Entry &entry = m_loaded[loaded];
+        while (update != updates.end() && lessFile(update->key, entry.key)) {
+            writeEntry(*update++);
+        }
+        if (update != updates.end() && sameFile(update->key, entry.key)) {
+            writeEntry(*update++);
+        } else {
+            writeEntry(entry);
+        }
+    }
+    while (update != updates.end()) {
+        writeEntry(*update++);
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    file.close();
+    std::error_code error;
+    if (file) {
+        std::filesystem::rename(temporary, m_path, error);
+    }
+    if (!file || error) {
+        std::filesystem::remove(temporary, error);
+        return std::nullopt;
+    }
+    return dropped;
+}
+
+std::size_t HashCache::getHits() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+std::size_t HashCache::getMisses() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+std::size_t HashCache::size() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    std::size_t count = m_loadedCount;
+    for (const auto &[id, entry] : m_updates) {
+        count += findLoaded(entry.key) == nullptr ? 1 : 0;
+    }
+    return count;
+}
+} // namespace DDK::HASH
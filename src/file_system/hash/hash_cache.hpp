@@ -0,0 +1,99 @@
+#pragma once
+
+#include "hash.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+class MemoryMapped;
+
+namespace DDK::HASH {
+// Hashes of files from previous runs, stored in a file of entries sorted by device and inode that
+// is memory mapped for lookups. An entry is only used while size, mtime and ctime of its file are
+// unchanged. Every entry holds up to SLOTS hashes of the file, the meaning of a slot is up to the
+// caller and all entries are dropped as soon as the configuration passed by the caller changes.
+// New entries are kept in memory until save() replaces the file. All functions are thread safe.
+class HashCache {
+  public:
+    static constexpr std::size_t SLOTS = 3;
+    static constexpr std::uint32_t VERSION = 1;
+    // files changed this shortly before the cache was opened or later are never stored, a change
+    // within the same timestamp tick right after hashing would go unnoticed
+    static constexpr std::chrono::seconds RACY_INTERVAL{1};
+
+    // identity and state of a file
+    struct Key {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::int64_t ctime;
+    };
+
+    // Loads path if it exists and was written with the same version and configuration.
+    HashCache(const std::filesystem::path &path, std::uint64_t configuration);
+    ~HashCache();
+
+    HashCache(const HashCache &) = delete;
+    HashCache &operator=(const HashCache &) = delete;
+
+    // nullopt if the file can not be stat'ed or the platform has no inodes
+    static std::optional<Key> getKey(const std::filesystem::path &file);
+
+    // counts a hit or a miss
+    std::optional<Hash> find(const Key &key, std::size_t slot);
+    void insert(const Key &key, std::size_t slot, Hash hash);
+    // Atomically replaces the cache file with all loaded and inserted entries. Returns false if
+    // the file could not be written.
+    bool save();
+    // Like save(), but drops entries that were neither found nor inserted within maxAge. Returns
+    // the number of dropped entries or nullopt if the file could not be written.
+    std::optional<std::size_t> compact(std::chrono::seconds maxAge);
+
+    std::size_t getHits() const;
+    std::size_t getMisses() const;
+    // loaded and inserted entries
+    std::size_t size() const;
+
+  private:
+    struct Entry {
+        Key key;
+        // seconds since epoch of the last run that found or inserted the entry
+        std::int64_t lastSeen;
+        // bit per stored slot
+        std::uint32_t slots;
+        std::uint32_t reserved;
+        std::array<Hash, SLOTS> hashes;
+    };
+
+    struct FileIdHash {
+        std::size_t operator()(const std::pair<std::uint64_t, std::uint64_t> &id) const;
+    };
+
+    // entry of the loaded file with device and inode of key, nullptr if there is none
+    const Entry *findLoaded(const Key &key) const;
+    // writes all entries with lastSeen >= oldest, returns the number of older entries
+    std::optional<std::size_t> write(std::int64_t oldest);
+
+    const std::filesystem::path m_path;
+    const std::uint64_t m_configuration;
+    const std::int64_t m_now;
+    // nanoseconds since epoch, files with a later mtime or ctime are racy
+    const std::int64_t m_racyAfter;
+
+    mutable std::mutex m_mutex;
+    std::unique_ptr<MemoryMapped> m_file;
+    const Entry *m_loaded = nullptr;
+    std::size_t m_loadedCount = 0;
+    // entries that were found or inserted during this run, override the loaded entries
+    std::unordered_map<std::pair<std::uint64_t, std::uint64_t>, Entry, FileIdHash> m_updates;
+    std::size_t m_hits = 0;
+    std::size_t m_misses = 0;
+};
+} // namespace DDK::HASH
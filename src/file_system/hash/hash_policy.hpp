@@ -0,0 +1,82 @@
+#pragma once
+
+#include "hash.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "xxh3.h"
+
+// Hash policies used to specialize the hashing loops for every algorithm at compile time. Only
+// included by translation units that link against xxHash.
+namespace DDK::HASH {
+struct XXH64Policy {
+    class State {
+      public:
+        explicit State(std::uint64_t seed) { XXH64_reset(&m_state, seed); }
+        void update(const void *data, std::size_t size) { XXH64_update(&m_state, data, size); }
+        Hash digest() const { return XXH64_digest(&m_state); }
+
+      private:
+        XXH64_state_t m_state;
+    };
+
+    static Hash hash(const void *data, std::size_t size, std::uint64_t seed) {
+        return XXH64(data, size, seed);
+    }
+};
+
+struct XXH3_64Policy {
+    class State {
+      public:
+        explicit State(std::uint64_t seed) { XXH3_64bits_reset_withSeed(&m_state, seed); }
+        void update(const void *data, std::size_t size) {
+            XXH3_64bits_update(&m_state, data, size);
+        }
+        Hash digest() const { return XXH3_64bits_digest(&m_state); }
+
+      private:
+        XXH3_state_t m_state;
+    };
+
+    static Hash hash(const void *data, std::size_t size, std::uint64_t seed) {
+        return XXH3_64bits_withSeed(data, size, seed);
+    }
+};
+
+struct XXH3_128Policy {
+    class State {
+      public:
+        explicit State(std::uint64_t seed) { XXH3_128bits_reset_withSeed(&m_state, seed); }
+        void update(const void *data, std::size_t size) {
+            XXH3_128bits_update(&m_state, data, size);
+        }
+        Hash digest() const {
+            const XXH128_hash_t hash = XXH3_128bits_digest(&m_state);
+            return {hash.low64, hash.high64};
+        }
+
+      private:
+        XXH3_state_t m_state;
+    };
+
+    static Hash hash(const void *data, std::size_t size, std::uint64_t seed) {
+        const XXH128_hash_t hash = XXH3_128bits_withSeed(data, size, seed);
+        return {hash.low64, hash.high64};
+    }
+};
+
+// calls function with a default constructed policy of algorithm
+template <typename Function>
+auto dispatch(Algorithm algorithm, Function &&function) {
+    switch (algorithm) {
+    case Algorithm::XXHASH64:
+        return function(XXH64Policy{});
+    case Algorithm::XXHASH3_64:
+        return function(XXH3_64Policy{});
+    case Algorithm::XXHASH3_128:
+        return function(XXH3_128Policy{});
+    }
+    throw std::invalid_argument("unknown hash algorithm");
+}
+} // namespace DDK::HASH
@@ -0,0 +1,202 @@
+#include "async_reader.hpp"
+
+#if defined(DDK_HAS_IO_URING)
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace DDK::IO {
+namespace {
+// file of a request that is currently read into one of the registered buffers
+struct Slot {
+    std::size_t request;
+    int fd;
+    bool directIo;
+    // next byte of the request and the bytes of the request that are still missing
+    std::uintmax_t offset;
+    std::uintmax_t remaining;
+    // bytes in front of offset read by an aligned direct read
+    std::size_t skip;
+    // bytes of the request within the current read
+    std::size_t wanted;
+};
+
+int openFile(const std::filesystem::path &path, bool &directIo) {
+    if (directIo) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if (fd >= 0) {
+            return fd;
+        }
+        // file systems without direct I/O reject O_DIRECT with EINVAL
+        directIo = false;
+    }
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+bool hasSize(int fd, std::uintmax_t size) {
+    struct stat status;
+    return fstat(fd, &status) == 0 && static_cast<std::uintmax_t>(status.st_size) == size;
+}
+
+void closeFile(Slot &slot, const ReadOptions &options) {
+    if (options.dropCache) {
+        posix_fadvise(slot.fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    close(slot.fd);
+    slot.fd = -1;
+}
+
+void prepareRead(io_uring_sqe *entry, Slot &slot, unsigned int index, const iovec &buffer) {
+    std::uintmax_t begin = slot.offset;
+    slot.skip = 0;
+    if (slot.directIo) {
+        begin &= ~std::uintmax_t{FileReader::ALIGNMENT - 1};
+        slot.skip = static_cast<std::size_t>(slot.offset - begin);
+    }
+    slot.wanted = static_cast<std::size_t>(
+        std::min<std::uintmax_t>(slot.remaining, AsyncReader::CHUNK_SIZE - slot.skip));
+    std::size_t length = slot.skip + slot.wanted;
+    if (slot.directIo) {
+        length = (length + FileReader::ALIGNMENT - 1) & ~(FileReader::ALIGNMENT - 1);
+    }
+
+    entry->opcode = IORING_OP_READ_FIXED;
+    entry->fd = slot.fd;
+    entry->addr = reinterpret_cast<std::uint64_t>(buffer.iov_base);
+    entry->len = static_cast<unsigned int>(length);
+    entry->off = begin;
+    entry->buf_index = static_cast<std::uint16_t>(index);
+    entry->user_data = index;
+}
+} // namespace
+
+std::unique_ptr<AsyncReader> AsyncReader::create(unsigned int queueDepth) {
+    queueDepth = std::clamp(queueDepth, 1u, MAX_QUEUE_DEPTH);
+    std::unique_ptr<AsyncReader> reader(new AsyncReader());
+    reader->m_ring = IoUring::create(queueDepth, {IORING_OP_READ_FIXED});
+    if (!reader->m_ring) {
+        return nullptr;
+    }
+
+    reader->m_memory.reset(new char[queueDepth * CHUNK_SIZE + FileReader::ALIGNMENT]);
+    const auto address = reinterpret_cast<std::uintptr_t>(reader->m_memory.get());
+    const std::uintptr_t aligned =
+        (address + FileReader::ALIGNMENT - 1) & ~std::uintptr_t{FileReader::ALIGNMENT - 1};
+    char *const memory = reader->m_memory.get() + (aligned - address);
+    for (unsigned int buffer = 0; buffer < queueDepth; buffer++) {
+        reader->m_buffers.push_back({memory + buffer * CHUNK_SIZE, CHUNK_SIZE});
+    }
+    if (!reader->m_ring->registerBuffers(reader->m_buffers.data(), queueDepth)) {
+        return nullptr;
+    }
+    return reader;
+}
+
+AsyncReader::~AsyncReader() = default;
+
+unsigned int AsyncReader::getQueueDepth() const {
+    return static_cast<unsigned int>(m_buffers.size());
+}
+
+bool AsyncReader::read(const std::vector<ReadRequest> &requests,
+                       const ReadOptions &options,
+                       const Consumer &consumer) {
+    std::vector<Slot> slots(m_buffers.size(), Slot{0, -1, false, 0, 0, 0, 0});
+    std::vector<unsigned int> freeSlots;
+    for (unsigned int index = getQueueDepth(); index > 0; index--) {
+        freeSlots.push_back(index - 1);
+    }
+    std::size_t nextRequest = 0;
+    std::size_t inFlight = 0;
+
+    // opens the next readable request in the slot
+    const auto startRequest = [&](unsigned int index) {
+        while (nextRequest < requests.size()) {
+            const ReadRequest &request = requests[nextRequest];
+            Slot &slot = slots[index];
+            slot = {nextRequest++, -1, options.directIo, request.offset, request.length, 0, 0};
+            if (slot.remaining == 0) {
+                continue;
+            }
+            slot.fd = openFile(*request.path, slot.directIo);
+            if (slot.fd < 0) {
+                continue;
+            }
+            if (request.fileSize && !hasSize(slot.fd, *request.fileSize)) {
+                closeFile(slot, options);
+                continue;
+            }
+            // a slot has at most one read in flight, so the submission queue never overflows
+            prepareRead(m_ring->getSubmissionEntry(), slot, index, m_buffers[index]);
+            return true;
+        }
+        return false;
+    };
+
+    bool failed = false;
+    while (true) {
+        while (!freeSlots.empty() && startRequest(freeSlots.back())) {
+            freeSlots.pop_back();
+            inFlight++;
+        }
+        if (inFlight == 0) {
+            break;
+        }
+        if (!m_ring->submitAndWait(1)) {
+            // Reads already taken by the kernel still write into the registered buffers and
+            // their completions would end up in the slots of the next call, so wait for them.
+            failed = true;
+            inFlight -= m_ring->discardSubmissions();
+            while (inFlight > 0) {
+                m_ring->submitAndWait(1);
+                inFlight -= m_ring->forEachCompletion([](std::uint64_t, int) {});
+            }
+            break;
+        }
+
+        m_ring->forEachCompletion([&](std::uint64_t user, int result) {
+            const auto index = static_cast<unsigned int>(user);
+            Slot &slot = slots[index];
+            if (result == -EINTR || result == -EAGAIN) {
+                prepareRead(m_ring->getSubmissionEntry(), slot, index, m_buffers[index]);
+                return;
+            }
+            // some file systems accept O_DIRECT when opening but not when reading
+            if (result == -EINVAL && slot.directIo) {
+                slot.directIo = false;
+                fcntl(slot.fd, F_SETFL, fcntl(slot.fd, F_GETFL) & ~O_DIRECT);
+                prepareRead(m_ring->getSubmissionEntry(), slot, index, m_buffers[index]);
+                return;
+            }
+
+            const std::size_t bytes = result > 0 ? static_cast<std::size_t>(result) : 0;
+            if (bytes > slot.skip) {
+                const auto *const data = static_cast<const char *>(m_buffers[index].iov_base);
+                const std::size_t size = std::min(bytes - slot.skip, slot.wanted);
+                consumer(slot.request, data + slot.skip, size);
+                slot.offset += size;
+                slot.remaining -= size;
+                if (slot.remaining > 0) {
+                    prepareRead(m_ring->getSubmissionEntry(), slot, index, m_buffers[index]);
+                    return;
+                }
+            }
+
+            // complete, at the end of the file or failed
+            closeFile(slot, options);
+            freeSlots.push_back(index);
+            inFlight--;
+        });
+    }
+
+    for (Slot &slot : slots) {
+        if (slot.fd >= 0) {
+            closeFile(slot, options);
+        }
+    }
+    return !failed;
+}
+} // namespace DDK::IO
+#endif
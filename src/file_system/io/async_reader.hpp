@@ -0,0 +1,60 @@
+#pragma once
+
+#include "file_reader.hpp"
+#include "io_uring.hpp"
+
+#if defined(DDK_HAS_IO_URING)
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace DDK::IO {
+// range of a file that is read by AsyncReader
+struct ReadRequest {
+    const std::filesystem::path *path;
+    std::uintmax_t offset;
+    std::uintmax_t length;
+    // the request is skipped like a missing file if the file no longer has this size
+    std::optional<std::uintmax_t> fileSize = std::nullopt;
+};
+
+// Keeps reads of up to queue depth files in flight with io_uring. Every file in flight owns one
+// registered buffer of CHUNK_SIZE bytes, its chunks are read one after another. A reader is not
+// thread safe, use one reader per thread.
+class AsyncReader {
+  public:
+    static constexpr std::size_t CHUNK_SIZE = 128 * 1024;
+    static constexpr unsigned int DEFAULT_QUEUE_DEPTH = 32;
+    // the kernel registers at most UIO_MAXIOV buffers at once
+    static constexpr unsigned int MAX_QUEUE_DEPTH = 1024;
+
+    using Consumer = std::function<void(std::size_t request, const char *data, std::size_t size)>;
+
+    // queueDepth is limited to MAX_QUEUE_DEPTH. Returns nullptr if io_uring, IORING_OP_READ_FIXED
+    // or registered buffers are not usable.
+    static std::unique_ptr<AsyncReader> create(unsigned int queueDepth);
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader &) = delete;
+    AsyncReader &operator=(const AsyncReader &) = delete;
+
+    unsigned int getQueueDepth() const;
+    // Calls consumer(request, data, size) for consecutive chunks of every request, chunks of
+    // different requests are interleaved. Like FileReader a request stops early at the end of its
+    // file or on read errors. Returns false if the ring failed, the consumer may have been called
+    // for some requests already.
+    bool read(const std::vector<ReadRequest> &requests,
+              const ReadOptions &options,
+              const Consumer &consumer);
+
+  private:
+    AsyncReader() = default;
+
+    std::unique_ptr<IoUring> m_ring;
+    // queue depth buffers of CHUNK_SIZE bytes, aligned for O_DIRECT
+    std::unique_ptr<char[]> m_memory;
+    std::vector<iovec> m_buffers;
+};
+} // namespace DDK::IO
+#endif
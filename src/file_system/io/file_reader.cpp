@@ -0,0 +1,148 @@
+#include "file_reader.hpp"
+
+#include <memory>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace DDK::IO {
+namespace {
+// room for aligning the start of the buffer and both ends of a direct read
+constexpr std::size_t BUFFER_CAPACITY = FileReader::BUFFER_SIZE + 3 * FileReader::ALIGNMENT;
+
+char *getThreadBuffer() {
+    thread_local const std::unique_ptr<char[]> buffer(new char[BUFFER_CAPACITY]);
+    const auto address = reinterpret_cast<std::uintptr_t>(buffer.get());
+    const std::uintptr_t aligned =
+        (address + FileReader::ALIGNMENT - 1) & ~std::uintptr_t{FileReader::ALIGNMENT - 1};
+    return buffer.get() + (aligned - address);
+}
+
+#if !defined(_WIN32)
+// reads until length bytes or the end of the file were read, returns -1 on errors
+ssize_t readFully(int fd, char *buffer, std::size_t length, std::uintmax_t offset) {
+    std::size_t total = 0;
+    while (total < length) {
+        const ssize_t result =
+            pread(fd, buffer + total, length - total, static_cast<off_t>(offset + total));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            return total > 0 ? static_cast<ssize_t>(total) : -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        total += static_cast<std::size_t>(result);
+    }
+    return static_cast<ssize_t>(total);
+}
+#endif
+} // namespace
+
+#if defined(_WIN32)
+FileReader::FileReader(const std::filesystem::path &path, const ReadOptions &)
+    : m_file(path, std::ios::binary) {}
+
+FileReader::~FileReader() = default;
+
+bool FileReader::isOpen() const { return m_file.is_open(); }
+
+std::optional<std::uintmax_t> FileReader::getSize() {
+    if (!m_file.is_open()) {
+        return std::nullopt;
+    }
+    m_file.clear();
+    m_file.seekg(0, std::ios::end);
+    const std::streamoff size = m_file.tellg();
+    return size >= 0 ? std::optional<std::uintmax_t>(static_cast<std::uintmax_t>(size))
+                     : std::nullopt;
+}
+
+std::size_t FileReader::readChunk(std::uintmax_t offset, std::size_t length, const char *&data) {
+    char *const buffer = getThreadBuffer();
+    m_file.clear();
+    m_file.seekg(static_cast<std::streamoff>(offset));
+    m_file.read(buffer, static_cast<std::streamsize>(length));
+    data = buffer;
+    return static_cast<std::size_t>(m_file.gcount());
+}
+#else
+FileReader::FileReader(const std::filesystem::path &path, const ReadOptions &options)
+    : m_dropCache(options.dropCache) {
+#if defined(O_DIRECT)
+    if (options.directIo) {
+        m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        m_directIo = m_fd >= 0;
+    }
+#endif
+    // file systems without direct I/O reject O_DIRECT with EINVAL
+    if (m_fd < 0) {
+        m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+}
+
+FileReader::~FileReader() {
+    if (m_fd < 0) {
+        return;
+    }
+#if defined(POSIX_FADV_DONTNEED)
+    if (m_dropCache) {
+        posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+    close(m_fd);
+}
+
+bool FileReader::isOpen() const { return m_fd >= 0; }
+
+std::optional<std::uintmax_t> FileReader::getSize() {
+    struct stat status;
+    if (m_fd < 0 || fstat(m_fd, &status) != 0) {
+        return std::nullopt;
+    }
+    return static_cast<std::uintmax_t>(status.st_size);
+}
+
+std::size_t FileReader::readChunk(std::uintmax_t offset, std::size_t length, const char *&data) {
+    if (m_fd < 0) {
+        return 0;
+    }
+    char *const buffer = getThreadBuffer();
+
+#if defined(O_DIRECT)
+    if (m_directIo) {
+        const std::uintmax_t begin = offset & ~std::uintmax_t{ALIGNMENT - 1};
+        const std::size_t skip = static_cast<std::size_t>(offset - begin);
+        const std::size_t alignedLength = (skip + length + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        const ssize_t result = readFully(m_fd, buffer, alignedLength, begin);
+        if (result >= 0) {
+            if (static_cast<std::size_t>(result) <= skip) {
+                return 0;
+            }
+            data = buffer + skip;
+            return std::min(length, static_cast<std::size_t>(result) - skip);
+        }
+        if (errno != EINVAL) {
+            return 0;
+        }
+        // some file systems accept O_DIRECT when opening but not when reading
+        m_directIo = false;
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+
+    const ssize_t result = readFully(m_fd, buffer, length, offset);
+    if (result <= 0) {
+        return 0;
+    }
+    data = buffer;
+    return static_cast<std::size_t>(result);
+}
+#endif
+} // namespace DDK::IO
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#if defined(_WIN32)
+#include <fstream>
+#endif
+
+namespace DDK::IO {
+struct ReadOptions {
+    // bypasses the page cache with O_DIRECT where the file system supports it (Linux only)
+    bool directIo = false;
+    // asks the kernel to drop the pages of a file from the page cache once it is closed
+    bool dropCache = false;
+};
+
+// Sequential reader that copies ranges of a file with pread into an aligned buffer owned by the
+// calling thread, so reading many small files neither maps nor allocates anything per file.
+class FileReader {
+  public:
+    static constexpr std::size_t BUFFER_SIZE = 1024 * 1024;
+    // alignment of offsets, sizes and buffer required by O_DIRECT
+    static constexpr std::size_t ALIGNMENT = 4096;
+
+    FileReader(const std::filesystem::path &path, const ReadOptions &options = {});
+    ~FileReader();
+
+    FileReader(const FileReader &) = delete;
+    FileReader &operator=(const FileReader &) = delete;
+
+    bool isOpen() const;
+    // current size of the open file, nullopt if it is not open
+    std::optional<std::uintmax_t> getSize();
+    // Calls consumer(data, size) for consecutive chunks of at most BUFFER_SIZE bytes of the
+    // range. Stops at the end of the file and returns false if the range could not be read
+    // completely. data is only valid until the next read of the calling thread.
+    template <typename Consumer>
+    bool read(std::uintmax_t offset, std::uintmax_t length, Consumer &&consumer);
+
+  private:
+    // reads at most BUFFER_SIZE bytes at offset, returns the number of bytes read, 0 at the end of
+    // the file or on errors
+    std::size_t readChunk(std::uintmax_t offset, std::size_t length, const char *&data);
+
+#if defined(_WIN32)
+    std::ifstream m_file;
+#else
+    int m_fd = -1;
+    bool m_directIo = false;
+    bool m_dropCache = false;
+#endif
+};
+
+template <typename Consumer>
+bool FileReader::read(std::uintmax_t offset, std::uintmax_t length, Consumer &&consumer) {
+    while (length > 0) {
+        const char *data = nullptr;
+        const std::size_t chunk = readChunk(
+            offset, static_cast<std::size_t>(std::min<std::uintmax_t>(length, BUFFER_SIZE)), data);
+        if (chunk == 0) {
+            return false;
+        }
+        consumer(data, chunk);
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+} // namespace DDK::IO
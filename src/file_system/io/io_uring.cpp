@@ -0,0 +1,173 @@
+#include "io_uring.hpp"
+
+#if defined(DDK_HAS_IO_URING)
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#if !defined(__NR_io_uring_setup)
+#define __NR_io_uring_setup 425
+#endif
+#if !defined(__NR_io_uring_enter)
+#define __NR_io_uring_enter 426
+#endif
+#if !defined(__NR_io_uring_register)
+#define __NR_io_uring_register 427
+#endif
+
+namespace DDK::IO {
+namespace {
+constexpr unsigned int PROBE_OPERATIONS = 256;
+
+bool supportsOperations(int fd, std::initializer_list<int> operations) {
+    std::vector<unsigned char> buffer(sizeof(io_uring_probe) +
+                                      PROBE_OPERATIONS * sizeof(io_uring_probe_op));
+    auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, PROBE_OPERATIONS) < 0) {
+        return false;
+    }
+    return std::all_of(operations.begin(), operations.end(), [&](int operation) {
+        return operation <= probe->last_op &&
+               (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) != 0;
+    });
+}
+
+void *mapRing(int fd, std::size_t size, off_t offset) {
+    void *ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ring == MAP_FAILED ? nullptr : ring;
+}
+
+unsigned int *ringField(void *ring, unsigned int offset) {
+    return reinterpret_cast<unsigned int *>(static_cast<char *>(ring) + offset);
+}
+} // namespace
+
+std::unique_ptr<IoUring> IoUring::create(unsigned int queueDepth,
+                                         std::initializer_list<int> requiredOperations) {
+    io_uring_params parameters{};
+    const int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &parameters));
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<IoUring> ring(new IoUring());
+    ring->m_fd = fd;
+    ring->m_queueDepth = parameters.sq_entries;
+
+    if (!supportsOperations(fd, requiredOperations)) {
+        return nullptr;
+    }
+
+    ring->m_submissionRingSize =
+        parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned int);
+    ring->m_completionRingSize =
+        parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMapping = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping) {
+        ring->m_submissionRingSize = ring->m_completionRingSize =
+            std::max(ring->m_submissionRingSize, ring->m_completionRingSize);
+    }
+
+    ring->m_submissionRing = mapRing(fd, ring->m_submissionRingSize, IORING_OFF_SQ_RING);
+    if (ring->m_submissionRing == nullptr) {
+        return nullptr;
+    }
+    if (singleMapping) {
+        ring->m_completionRing = ring->m_submissionRing;
+    } else {
+        ring->m_completionRing = mapRing(fd, ring->m_completionRingSize, IORING_OFF_CQ_RING);
+        if (ring->m_completionRing == nullptr) {
+            return nullptr;
+        }
+    }
+
+    ring->m_submissionEntriesSize = parameters.sq_entries * sizeof(io_uring_sqe);
+    ring->m_submissionEntries = static_cast<io_uring_sqe *>(
+        mapRing(fd, ring->m_submissionEntriesSize, IORING_OFF_SQES));
+    if (ring->m_submissionEntries == nullptr) {
+        return nullptr;
+    }
+
+    ring->m_submissionHead = ringField(ring->m_submissionRing, parameters.sq_off.head);
+    ring->m_submissionTail = ringField(ring->m_submissionRing, parameters.sq_off.tail);
+    ring->m_submissionMask = ringField(ring->m_submissionRing, parameters.sq_off.ring_mask);
+    ring->m_submissionArray = ringField(ring->m_submissionRing, parameters.sq_off.array);
+    ring->m_completionHead = ringField(ring->m_completionRing, parameters.cq_off.head);
+    ring->m_completionTail = ringField(ring->m_completionRing, parameters.cq_off.tail);
+    ring->m_completionMask = ringField(ring->m_completionRing, parameters.cq_off.ring_mask);
+    ring->m_completionEntries = reinterpret_cast<io_uring_cqe *>(
+        static_cast<char *>(ring->m_completionRing) + parameters.cq_off.cqes);
+    ring->m_submissionTailLocal = *ring->m_submissionTail;
+
+    return ring;
+}
+
+IoUring::~IoUring() {
+    if (m_submissionEntries != nullptr) {
+        munmap(m_submissionEntries, m_submissionEntriesSize);
+    }
+    if (m_completionRing != nullptr && m_completionRing != m_submissionRing) {
+        munmap(m_completionRing, m_completionRingSize);
+    }
+    if (m_submissionRing != nullptr) {
+        munmap(m_submissionRing, m_submissionRingSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+unsigned int IoUring::getQueueDepth() const { return m_queueDepth; }
+
+bool IoUring::registerBuffers(const iovec *buffers, unsigned int count) {
+    return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+io_uring_sqe *IoUring::getSubmissionEntry() {
+    const unsigned int head = __atomic_load_n(m_submissionHead, __ATOMIC_ACQUIRE);
+    if (m_submissionTailLocal - head >= m_queueDepth) {
+        return nullptr;
+    }
+
+    const unsigned int index = m_submissionTailLocal & *m_submissionMask;
+    io_uring_sqe *entry = &m_submissionEntries[index];
+    std::memset(entry, 0, sizeof(io_uring_sqe));
+    m_submissionArray[index] = index;
+    m_submissionTailLocal++;
+    m_pendingSubmissions++;
+    return entry;
+}
+
+bool IoUring::submitAndWait(unsigned int minCompletions) {
+    // publish the prepared entries to the kernel
+    __atomic_store_n(m_submissionTail, m_submissionTailLocal, __ATOMIC_RELEASE);
+
+    while (true) {
+        const long submitted =
+            syscall(__NR_io_uring_enter, m_fd, m_pendingSubmissions, minCompletions,
+                    minCompletions > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (submitted >= 0) {
+            m_pendingSubmissions -= std::min<unsigned int>(m_pendingSubmissions, submitted);
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+unsigned int IoUring::discardSubmissions() {
+    // the kernel only consumes entries within io_uring_enter, so the tail can be moved back
+    const unsigned int head = __atomic_load_n(m_submissionHead, __ATOMIC_ACQUIRE);
+    const unsigned int discarded = m_submissionTailLocal - head;
+    m_submissionTailLocal = head;
+    __atomic_store_n(m_submissionTail, head, __ATOMIC_RELEASE);
+    m_pendingSubmissions = 0;
+    return discarded;
+}
+} // namespace DDK::IO
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// IORING_OP_STATX, IORING_OP_OPENAT and IORING_REGISTER_PROBE require kernel headers >= 5.7
+#if defined(IORING_FEAT_FAST_POLL)
+#define DDK_HAS_IO_URING 1
+#endif
+#endif
+
+#if defined(DDK_HAS_IO_URING)
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <sys/uio.h>
+
+namespace DDK::IO {
+// Minimal io_uring wrapper built directly on the raw system calls, so no liburing is required.
+// A ring is not thread safe, use one ring per thread.
+class IoUring {
+  public:
+    // Returns nullptr if io_uring is not usable at runtime (old kernel, disabled by sysctl or
+    // seccomp) or if any of the required operations is not supported.
+    static std::unique_ptr<IoUring> create(unsigned int queueDepth,
+                                           std::initializer_list<int> requiredOperations);
+    ~IoUring();
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    unsigned int getQueueDepth() const;
+    // Registers buffers for IORING_OP_READ_FIXED, buf_index of an entry is the position within
+    // buffers. Fails if the buffers exceed RLIMIT_MEMLOCK on older kernels.
+    bool registerBuffers(const iovec *buffers, unsigned int count);
+    // Returns a zeroed submission queue entry or nullptr if the submission queue is full.
+    io_uring_sqe *getSubmissionEntry();
+    // Submits all prepared entries and waits until at least minCompletions are available.
+    // Returns false on errors other than EINTR.
+    bool submitAndWait(unsigned int minCompletions);
+    // Drops the prepared entries that were not taken by the kernel yet, for example after
+    // submitAndWait() failed, and returns their count.
+    unsigned int discardSubmissions();
+    // Calls handler(user_data, res) for every available completion and returns their count.
+    template <typename Handler>
+    unsigned int forEachCompletion(Handler handler);
+
+  private:
+    IoUring() = default;
+
+    int m_fd = -1;
+    unsigned int m_queueDepth = 0;
+    unsigned int m_pendingSubmissions = 0;
+    // prepared but not yet published submission queue tail
+    unsigned int m_submissionTailLocal = 0;
+
+    void *m_submissionRing = nullptr;
+    std::size_t m_submissionRingSize = 0;
+    void *m_completionRing = nullptr;
+    std::size_t m_completionRingSize = 0;
+    io_uring_sqe *m_submissionEntries = nullptr;
+    std::size_t m_submissionEntriesSize = 0;
+
+    unsigned int *m_submissionHead = nullptr;
+    unsigned int *m_submissionTail = nullptr;
+    unsigned int *m_submissionMask = nullptr;
+    unsigned int *m_submissionArray = nullptr;
+    unsigned int *m_completionHead = nullptr;
+    unsigned int *m_completionTail = nullptr;
+    unsigned int *m_completionMask = nullptr;
+    io_uring_cqe *m_completionEntries = nullptr;
+};
+
+template <typename Handler>
+unsigned int IoUring::forEachCompletion(Handler handler) {
+    unsigned int head = *m_completionHead;
+    const unsigned int tail = __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE);
+    unsigned int count = 0;
+
+    for (; head != tail; head++, count++) {
+        const io_uring_cqe &completion = m_completionEntries[head & *m_completionMask];
+        handler(completion.user_data, completion.res);
+    }
+
+    __atomic_store_n(m_completionHead, head, __ATOMIC_RELEASE);
+    return count;
+}
+} // namespace DDK::IO
+#endif
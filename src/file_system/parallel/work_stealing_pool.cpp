@@ -0,0 +1,160 @@
+#include "work_stealing_pool.hpp"
+
+namespace DDK::PARALLEL {
+namespace {
+struct WorkerIdentity {
+    const WorkStealingPool *pool = nullptr;
+    std::size_t index = 0;
+};
+
+thread_local WorkerIdentity currentWorker{};
+} // namespace
+
+std::size_t resolveThreadsCount(std::size_t threads) {
+    if (threads != 0) {
+        return threads;
+    }
+    const std::size_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads == 0 ? 1 : hardwareThreads;
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) :
+    m_pendingTasks(0), m_queuedTasks(0), m_sleepingWorkers(0), m_nextQueue(0), m_stop(false) {
+    const std::size_t threadsCount = resolveThreadsCount(threads);
+
+    for (std::size_t i = 0; i < threadsCount; i++) {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+    // queue 0 belongs to the thread calling wait()
+    for (std::size_t i = 1; i < threadsCount; i++) {
+        m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_stop = true;
+    }
+    m_taskAvailable.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    const std::size_t index = currentWorker.pool == this
+                                  ? currentWorker.index
+                                  : m_nextQueue.fetch_add(1) % m_queues.size();
+
+    m_pendingTasks.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_queuedTasks.fetch_add(1);
+
+    if (m_sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_taskAvailable.notify_one();
+    }
+}
+
+void WorkStealingPool::wait() {
+    const WorkerIdentity previousWorker = currentWorker;
+    currentWorker = {this, 0};
+
+    while (m_pendingTasks.load() > 0) {
+        if (runPendingTask(0)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_stateMutex);
+        m_sleepingWorkers.fetch_add(1);
+        m_taskAvailable.wait(lock,
+                             [&] { return m_pendingTasks.load() == 0 || m_queuedTasks.load() > 0; });
+        m_sleepingWorkers.fetch_sub(1);
+    }
+
+    currentWorker = previousWorker;
+
+    std::exception_ptr exception = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        std::swap(exception, m_exception);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+std::size_t WorkStealingPool::getThreadsCount() const { return m_queues.size(); }
+
+void WorkStealingPool::workerLoop(std::size_t index) {
+    currentWorker = {this, index};
+
+    while (true) {
+        if (runPendingTask(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_stateMutex);
+        m_sleepingWorkers.fetch_add(1);
+        m_taskAvailable.wait(lock, [&] { return m_stop.load() || m_queuedTasks.load() > 0; });
+        m_sleepingWorkers.fetch_sub(1);
+        if (m_stop.load()) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::runPendingTask(std::size_t index) {
+    std::function<void()> task;
+    if (popTask(index, task) || stealTask(index, task)) {
+        execute(task);
+        return true;
+    }
+    return false;
+}
+
+bool WorkStealingPool::popTask(std::size_t index, std::function<void()> &task) {
+    TaskQueue &queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    m_queuedTasks.fetch_sub(1);
+    return true;
+}
+
+bool WorkStealingPool::stealTask(std::size_t index, std::function<void()> &task) {
+    for (std::size_t offset = 1; offset < m_queues.size(); offset++) {
+        TaskQueue &queue = *m_queues[(index + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        m_queuedTasks.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::execute(std::function<void()> &task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (!m_exception) {
+            m_exception = std::current_exception();
+        }
+    }
+
+    if (m_pendingTasks.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_taskAvailable.notify_all();
+    }
+}
+} // namespace DDK::PARALLEL
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DDK::PARALLEL {
+// Resolves a user supplied thread count. 0 selects all available hardware threads.
+std::size_t resolveThreadsCount(std::size_t threads);
+
+// Thread pool with one task deque per worker. Workers pop their own tasks LIFO (depth first, keeps
+// the working set small) and steal from the front of other deques FIFO (oldest tasks usually
+// describe the largest remaining subtrees). The thread calling wait() participates as worker 0,
+// so a pool with a single thread never spawns any additional threads.
+class WorkStealingPool {
+  public:
+    explicit WorkStealingPool(std::size_t threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Tasks submitted from a worker are pushed to the worker's own deque, tasks submitted from any
+    // other thread are distributed round robin.
+    void submit(std::function<void()> task);
+    // Blocks until all submitted tasks, including tasks spawned by tasks, are finished. Rethrows
+    // the first exception thrown by a task.
+    void wait();
+    std::size_t getThreadsCount() const;
+
+  private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool runPendingTask(std::size_t index);
+    bool popTask(std::size_t index, std::function<void()> &task);
+    bool stealTask(std::size_t index, std::function<void()> &task);
+    void execute(std::function<void()> &task);
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    // submitted but not yet finished tasks
+    std::atomic<std::size_t> m_pendingTasks;
+    // submitted but not yet started tasks
+    std::atomic<std::size_t> m_queuedTasks;
+    std::atomic<std::size_t> m_sleepingWorkers;
+    std::atomic<std::size_t> m_nextQueue;
+    std::atomic<bool> m_stop;
+    std::mutex m_stateMutex;
+    std::condition_variable m_taskAvailable;
+    std::exception_ptr m_exception;
+};
+} // namespace DDK::PARALLEL
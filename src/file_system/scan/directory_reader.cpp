@@ -0,0 +1,583 @@
+#include "directory_reader.hpp"
+#include "io/io_uring.hpp"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace DDK::SCAN {
+#if defined(__linux__)
+namespace {
+// large buffers keep the number of getdents64 calls low for huge directories
+constexpr std::size_t DIRECTORY_BUFFER_SIZE = 256 * 1024;
+
+#if defined(STATX_TYPE)
+// size and hard link identity of regular files
+constexpr unsigned int STATX_MASK_FILE = STATX_SIZE | STATX_NLINK | STATX_INO;
+constexpr unsigned int STATX_MASK_TYPE_AND_FILE = STATX_TYPE | STATX_MASK_FILE;
+
+// statx is not available on kernels older than 4.11
+std::atomic<bool> statxSupported{true};
+#else
+constexpr unsigned int STATX_MASK_FILE = 0;
+constexpr unsigned int STATX_MASK_TYPE_AND_FILE = 0;
+#endif
+
+// upper bound of directories opened ahead of their listing, keeps us far away from RLIMIT_NOFILE
+constexpr int MAX_PREOPENED_DIRECTORIES = 256;
+std::atomic<int> preopenedDirectories{0};
+
+// layout of the records returned by getdents64
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256];
+};
+
+struct EntryStatus {
+    std::filesystem::file_type type;
+    std::uintmax_t size;
+    FileId fileId;
+};
+
+FileId makeFileId(std::uint64_t links, std::uint64_t device, std::uint64_t inode) {
+    return links > 1 ? FileId{device, inode} : FileId{};
+}
+
+class FileDescriptor {
+  public:
+    explicit FileDescriptor(int fd) : m_fd(fd) {}
+    ~FileDescriptor() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+    int get() const { return m_fd; }
+
+  private:
+    const int m_fd;
+};
+
+[[noreturn]] void throwError(const std::filesystem::path &directory, int error) {
+    throw std::filesystem::filesystem_error("readDirectory", directory,
+                                            std::error_code(error, std::generic_category()));
+}
+
+int openDirectory(const std::filesystem::path &directory, int directoryFd) {
+    if (directoryFd >= 0) {
+        return directoryFd;
+    }
+    return open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+void releasePreopenedDirectory() { preopenedDirectories.fetch_sub(1); }
+
+bool isDotOrDotDot(const char *name) {
+    return std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0;
+}
+
+std::filesystem::file_type fileType(mode_t mode) {
+    if (S_ISREG(mode)) {
+        return std::filesystem::file_type::regular;
+    } else if (S_ISDIR(mode)) {
+        return std::filesystem::file_type::directory;
+    } else if (S_ISLNK(mode)) {
+        return std::filesystem::file_type::symlink;
+    } else if (S_ISBLK(mode)) {
+        return std::filesystem::file_type::block;
+    } else if (S_ISCHR(mode)) {
+        return std::filesystem::file_type::character;
+    } else if (S_ISFIFO(mode)) {
+        return std::filesystem::file_type::fifo;
+    } else if (S_ISSOCK(mode)) {
+        return std::filesystem::file_type::socket;
+    }
+    return std::filesystem::file_type::unknown;
+}
+
+// only regular files and directories are analyzed
+bool makeEntry(const char *name, const EntryStatus &status, bool symlink, DirectoryEntry &entry) {
+    if (status.type == std::filesystem::file_type::regular) {
+        entry = {name, status.type, status.size, symlink};
+        entry.fileId = status.fileId;
+        return true;
+    } else if (status.type == std::filesystem::file_type::directory) {
+        // the size of a directory is accumulated from its children
+        entry = {name, status.type, 0, symlink};
+        return true;
+    }
+    return false;
+}
+
+bool isBrokenSymlink(int error) { return error == ENOENT || error == ENOTDIR; }
+
+// One statx call relative to the directory fd, only requesting the fields in mask.
+// Returns 0 on success, errno otherwise.
+int statEntry(int directoryFd,
+              const char *name,
+              bool follow,
+              unsigned int mask,
+              EntryStatus &status) {
+    const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+#if defined(STATX_TYPE)
+    if (statxSupported.load(std::memory_order_relaxed)) {
+        struct statx buffer;
+        if (statx(directoryFd, name, flags, mask, &buffer) == 0) {
+            status = {fileType(buffer.stx_mode), buffer.stx_size,
+                      makeFileId(buffer.stx_nlink,
+                                 makedev(buffer.stx_dev_major, buffer.stx_dev_minor),
+                                 buffer.stx_ino)};
+            return 0;
+        }
+        if (errno != ENOSYS) {
+            return errno;
+        }
+        statxSupported.store(false, std::memory_order_relaxed);
+    }
+#endif
+    struct stat buffer;
+    if (fstatat(directoryFd, name, &buffer, flags) != 0) {
+        return errno;
+    }
+    status = {fileType(buffer.st_mode), static_cast<std::uintmax_t>(buffer.st_size),
+              makeFileId(buffer.st_nlink, buffer.st_dev, buffer.st_ino)};
+    return 0;
+}
+
+bool analyzeSymlinkTarget(int directoryFd, const char *name, DirectoryEntry &entry) {
+    EntryStatus status{};
+    const int error = statEntry(directoryFd, name, true, STATX_MASK_TYPE_AND_FILE, status);
+    if (isBrokenSymlink(error)) {
+        entry = {name, std::filesystem::file_type::not_found, 0, true};
+        return true;
+    }
+    return error == 0 && makeEntry(name, status, true, entry);
+}
+
+bool analyzeEntry(int directoryFd,
+                  const char *name,
+                  unsigned char type,
+                  bool followSymlinks,
+                  DirectoryEntry &entry) {
+    EntryStatus status{};
+    switch (type) {
+    case DT_DIR:
+        // no system call required
+        entry = {name, std::filesystem::file_type::directory, 0, false};
+        return true;
+    case DT_REG:
+        if (statEntry(directoryFd, name, false, STATX_MASK_FILE, status) != 0) {
+            return false;
+        }
+        entry = {name, std::filesystem::file_type::regular, status.size, false};
+        entry.fileId = status.fileId;
+        return true;
+    case DT_LNK:
+        return followSymlinks && analyzeSymlinkTarget(directoryFd, name, entry);
+    case DT_UNKNOWN:
+        // some file systems do not report d_type
+        if (statEntry(directoryFd, name, false, STATX_MASK_TYPE_AND_FILE, status) != 0) {
+            return false;
+        }
+        if (status.type == std::filesystem::file_type::symlink) {
+            return followSymlinks && analyzeSymlinkTarget(directoryFd, name, entry);
+        }
+        return makeEntry(name, status, false, entry);
+    default:
+        // sockets, fifos and devices
+        return false;
+    }
+}
+
+#if defined(DDK_HAS_IO_URING)
+constexpr unsigned int SCAN_QUEUE_DEPTH = 256;
+
+IO::IoUring *getThreadIoUring() {
+    thread_local bool initialized = false;
+    thread_local std::unique_ptr<IO::IoUring> ring;
+    if (!initialized) {
+        initialized = true;
+        ring = IO::IoUring::create(SCAN_QUEUE_DEPTH, {IORING_OP_STATX, IORING_OP_OPENAT});
+    }
+    return ring.get();
+}
+
+bool reservePreopenedDirectory() {
+    if (preopenedDirectories.fetch_add(1) < MAX_PREOPENED_DIRECTORIES) {
+        return true;
+    }
+    preopenedDirectories.fetch_sub(1);
+    return false;
+}
+
+struct MetadataRequest {
+    enum class Operation { NONE, STATX, OPENAT };
+
+    const char *name;
+    unsigned char type;
+    Operation operation;
+    // the request describes the target of a symlink
+    bool followSymlink;
+    // completion result: >= 0 on success (the fd for OPENAT), -errno otherwise, -ECANCELED if
+    // the request never ran
+    int result;
+    struct statx status;
+};
+
+void prepareRequest(io_uring_sqe *entry, int directoryFd, MetadataRequest &request) {
+    entry->fd = directoryFd;
+    entry->addr = reinterpret_cast<std::uint64_t>(request.name);
+    if (request.operation == MetadataRequest::Operation::OPENAT) {
+        entry->opcode = IORING_OP_OPENAT;
+        entry->open_flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    } else {
+        entry->opcode = IORING_OP_STATX;
+        entry->len = request.type == DT_REG ? STATX_MASK_FILE : STATX_MASK_TYPE_AND_FILE;
+        entry->off = reinterpret_cast<std::uint64_t>(&request.status);
+        entry->statx_flags = request.followSymlink ? 0 : AT_SYMLINK_NOFOLLOW;
+    }
+}
+
+// Keeps the ring filled with the pending requests until all of them completed. On errors the
+// requests already taken by the kernel are waited for, since they write into requests and the
+// names, and the ring is left empty for the next directory.
+void runRequests(IO::IoUring &ring,
+                 const std::filesystem::path &directory,
+                 int directoryFd,
+                 std::vector<MetadataRequest> &requests,
+                 const std::vector<std::size_t> &pending) {
+    std::size_t submitted = 0;
+    std::size_t inFlight = 0;
+    const auto complete = [&](std::uint64_t index, int result) { requests[index].result = result; };
+
+    while (submitted < pending.size() || inFlight > 0) {
+        while (submitted < pending.size()) {
+            io_uring_sqe *entry = ring.getSubmissionEntry();
+            if (entry == nullptr) {
+                break;
+            }
+            prepareRequest(entry, directoryFd, requests[pending[submitted]]);
+            entry->user_data = pending[submitted];
+            submitted++;
+            inFlight++;
+        }
+
+        // io_uring_enter fails for invalid arguments but also with EAGAIN, EBUSY or ENOMEM
+        if (!ring.submitAndWait(1)) {
+            const int error = errno;
+            inFlight -= ring.discardSubmissions();
+            while (inFlight > 0) {
+                // a failed wait is retried, returning earlier would hand out memory still in use
+                ring.submitAndWait(1);
+                inFlight -= ring.forEachCompletion(complete);
+            }
+            throwError(directory, error);
+        }
+
+        inFlight -= ring.forEachCompletion(complete);
+    }
+}
+
+bool makeEntry(const MetadataRequest &request, DirectoryEntry &entry) {
+    if (request.type == DT_DIR) {
+        entry = {request.name, std::filesystem::file_type::directory, 0, false};
+        if (request.operation == MetadataRequest::Operation::OPENAT) {
+            if (request.result >= 0) {
+                entry.directoryFd = request.result;
+            } else {
+                // listing the directory by path later reports the actual error
+                releasePreopenedDirectory();
+            }
+        }
+        return true;
+    }
+
+    if (request.result < 0) {
+        if (request.followSymlink && isBrokenSymlink(-request.result)) {
+            entry = {request.name, std::filesystem::file_type::not_found, 0, true};
+            return true;
+        }
+        return false;
+    }
+
+    const FileId fileId =
+        makeFileId(request.status.stx_nlink,
+                   makedev(request.status.stx_dev_major, request.status.stx_dev_minor),
+                   request.status.stx_ino);
+    if (request.type == DT_REG) {
+        entry = {request.name, std::filesystem::file_type::regular, request.status.stx_size, false};
+        entry.fileId = fileId;
+        return true;
+    }
+
+    // unfollowed symlinks without d_type are rejected here as well
+    const EntryStatus status{fileType(request.status.stx_mode), request.status.stx_size, fileId};
+    return makeEntry(request.name, status, request.followSymlink, entry);
+}
+
+// Releases the directories opened ahead of their listing when the listing fails.
+void releasePreopenedDirectories(std::vector<DirectoryEntry> &entries,
+                                 const std::vector<MetadataRequest> &requests) {
+    for (DirectoryEntry &entry : entries) {
+        releaseDirectory(entry.directoryFd);
+        entry.directoryFd = -1;
+    }
+    for (const MetadataRequest &request : requests) {
+        if (request.operation == MetadataRequest::Operation::OPENAT) {
+            releaseDirectory(request.result);
+            if (request.result < 0) {
+                releasePreopenedDirectory();
+            }
+        }
+    }
+}
+
+void readDirectoryIoUring(IO::IoUring &ring,
+                          const std::filesystem::path &directory,
+                          bool followSymlinks,
+                          std::vector<DirectoryEntry> &entries,
+                          int directoryFd) {
+    entries.clear();
+
+    const FileDescriptor fd(openDirectory(directory, directoryFd));
+    if (fd.get() < 0) {
+        throwError(directory, errno);
+    }
+
+    thread_local std::vector<char> buffer(DIRECTORY_BUFFER_SIZE);
+    std::vector<MetadataRequest> requests;
+    std::vector<std::size_t> pending;
+
+    try {
+        while (true) {
+            const long bytes = syscall(SYS_getdents64, fd.get(), buffer.data(), buffer.size());
+            if (bytes < 0) {
+                throwError(directory, errno);
+            } else if (bytes == 0) {
+                break;
+            }
+
+            // names point into the buffer, all requests of a buffer complete before the next read
+            for (long offset = 0; offset < bytes;) {
+                const auto *record =
+                    reinterpret_cast<const LinuxDirent64 *>(buffer.data() + offset);
+                offset += record->d_reclen;
+
+                if (isDotOrDotDot(record->d_name)) {
+                    continue;
+                }
+
+                MetadataRequest request{};
+                request.name = record->d_name;
+                request.type = record->d_type;
+                request.result = -ECANCELED;
+                switch (record->d_type) {
+                case DT_DIR:
+                    request.operation = reservePreopenedDirectory()
+                                            ? MetadataRequest::Operation::OPENAT
+                                            : MetadataRequest::Operation::NONE;
+                    break;
+                case DT_LNK:
+                    if (!followSymlinks) {
+                        continue;
+                    }
+                    request.operation = MetadataRequest::Operation::STATX;
+                    request.followSymlink = true;
+                    break;
+                case DT_REG:
+                case DT_UNKNOWN:
+                    request.operation = MetadataRequest::Operation::STATX;
+                    break;
+                default:
+                    // sockets, fifos and devices
+                    continue;
+                }
+                requests.push_back(request);
+            }
+
+            pending.clear();
+            for (std::size_t i = 0; i < requests.size(); i++) {
+                if (requests[i].operation != MetadataRequest::Operation::NONE) {
+                    pending.push_back(i);
+                }
+            }
+            runRequests(ring, directory, fd.get(), requests, pending);
+
+            // entries without d_type that turned out to be followed symlinks need a second round
+            pending.clear();
+            for (std::size_t i = 0; i < requests.size(); i++) {
+                MetadataRequest &request = requests[i];
+                if (followSymlinks && request.type == DT_UNKNOWN && request.result == 0 &&
+                    S_ISLNK(request.status.stx_mode)) {
+                    request.followSymlink = true;
+                    pending.push_back(i);
+                }
+            }
+            runRequests(ring, directory, fd.get(), requests, pending);
+
+            for (const MetadataRequest &request : requests) {
+                DirectoryEntry entry;
+                if (makeEntry(request, entry)) {
+                    entries.push_back(std::move(entry));
+                }
+            }
+            requests.clear();
+        }
+    } catch (...) {
+        // the subdirectories opened so far are never walked
+        releasePreopenedDirectories(entries, requests);
+        entries.clear();
+        throw;
+    }
+}
+#endif
+} // namespace
+#endif
+
+void readDirectory(const std::filesystem::path &directory,
+                   bool followSymlinks,
+                   std::vector<DirectoryEntry> &entries,
+                   Backend backend,
+                   int directoryFd) {
+#if defined(__linux__)
+    if (directoryFd >= 0) {
+        releasePreopenedDirectory();
+    }
+#if defined(DDK_HAS_IO_URING)
+    if (backend == Backend::IO_URING) {
+        if (IO::IoUring *ring = getThreadIoUring()) {
+            readDirectoryIoUring(*ring, directory, followSymlinks, entries, directoryFd);
+            return;
+        }
+    }
+#endif
+    if (backend != Backend::PORTABLE) {
+        readDirectoryLinux(directory, followSymlinks, entries, directoryFd);
+        return;
+    }
+    if (directoryFd >= 0) {
+        close(directoryFd);
+    }
+#endif
+    readDirectoryPortable(directory, followSymlinks, entries);
+}
+
+void releaseDirectory(int directoryFd) {
+#if defined(__linux__)
+    if (directoryFd >= 0) {
+        releasePreopenedDirectory();
+        close(directoryFd);
+    }
+#endif
+}
+
+bool isIoUringAvailable() {
+#if defined(DDK_HAS_IO_URING)
+    return getThreadIoUring() != nullptr;
+#else
+    return false;
+#endif
+}
+
+FileId getFileId(const std::filesystem::path &file) {
+#if !defined(_WIN32)
+    struct stat buffer;
+    if (stat(file.c_str(), &buffer) == 0 && S_ISREG(buffer.st_mode) && buffer.st_nlink > 1) {
+        return {static_cast<std::uint64_t>(buffer.st_dev),
+                static_cast<std::uint64_t>(buffer.st_ino)};
+    }
+#endif
+    return {};
+}
+
+void readDirectoryPortable(const std::filesystem::path &directory,
+                           bool followSymlinks,
+                           std::vector<DirectoryEntry> &entries) {
+    entries.clear();
+
+    // directory_entry caches the file type reported by the directory listing where possible
+    for (const auto &directoryEntry : std::filesystem::directory_iterator(directory)) {
+        try {
+            const bool symlink = directoryEntry.is_symlink();
+            if (symlink && !followSymlinks) {
+                continue;
+            }
+
+            const std::filesystem::file_type type = directoryEntry.status().type();
+            const std::string name = directoryEntry.path().filename().u8string();
+            switch (type) {
+            case std::filesystem::file_type::regular:
+                entries.push_back({name, type, directoryEntry.file_size(), symlink});
+                if (directoryEntry.hard_link_count() > 1) {
+                    entries.back().fileId = getFileId(directoryEntry.path());
+                }
+                break;
+            case std::filesystem::file_type::directory:
+            case std::filesystem::file_type::not_found:
+                entries.push_back({name, type, 0, symlink});
+                break;
+            default:
+                break;
+            }
+        } catch (const std::exception &e) {
+            // permission denied, file deleted, etc.
+            // ignore this file system entry and continue
+        }
+    }
+}
+
+#if defined(__linux__)
+void readDirectoryLinux(const std::filesystem::path &directory,
+                        bool followSymlinks,
+                        std::vector<DirectoryEntry> &entries,
+                        int directoryFd) {
+    entries.clear();
+
+    const FileDescriptor fd(openDirectory(directory, directoryFd));
+    if (fd.get() < 0) {
+        throwError(directory, errno);
+    }
+
+    thread_local std::vector<char> buffer(DIRECTORY_BUFFER_SIZE);
+    while (true) {
+        const long bytes = syscall(SYS_getdents64, fd.get(), buffer.data(), buffer.size());
+        if (bytes < 0) {
+            throwError(directory, errno);
+        } else if (bytes == 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < bytes;) {
+            const auto *record = reinterpret_cast<const LinuxDirent64 *>(buffer.data() + offset);
+            offset += record->d_reclen;
+
+            if (isDotOrDotDot(record->d_name)) {
+                continue;
+            }
+
+            DirectoryEntry entry;
+            if (analyzeEntry(fd.get(), record->d_name, record->d_type, followSymlinks, entry)) {
+                entries.push_back(std::move(entry));
+            }
+        }
+    }
+}
+#endif
+} // namespace DDK::SCAN
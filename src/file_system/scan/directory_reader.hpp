@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace DDK::SCAN {
+enum class Backend {
+    // getdents64 + statx on Linux, std::filesystem on every other platform
+    DEFAULT,
+    // std::filesystem on every platform
+    PORTABLE,
+    // batched statx/openat requests through io_uring, uses DEFAULT if io_uring is not available
+    IO_URING,
+};
+
+// Identifies a file with more than one hard link. All links share the same content, so they are
+// never duplicates of each other. Files with a single link keep the default {0, 0}.
+struct FileId {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+
+    bool isHardlinked() const { return inode != 0; }
+    bool operator==(const FileId &other) const {
+        return device == other.device && inode == other.inode;
+    }
+    bool operator!=(const FileId &other) const { return !(*this == other); }
+    bool operator<(const FileId &other) const {
+        return device != other.device ? device < other.device : inode < other.inode;
+    }
+};
+
+struct FileIdHash {
+    std::size_t operator()(const FileId &id) const {
+        return std::hash<std::uint64_t>()(id.inode) ^ (std::hash<std::uint64_t>()(id.device) << 1);
+    }
+};
+
+// Metadata of a single directory entry. For followed symlinks type and size describe the target.
+struct DirectoryEntry {
+    // UTF-8 encoded file name
+    std::string name;
+    std::filesystem::file_type type;
+    std::uintmax_t size;
+    bool symlink;
+    // Already opened directory (IO_URING backend only). Ownership passes to the readDirectory()
+    // call that lists this entry.
+    int directoryFd = -1;
+    // regular files only
+    FileId fileId = {};
+};
+
+// Lists the entries of a directory together with all metadata FileSystemItem needs. Symlinks are
+// only listed if followSymlinks is set, broken symlinks are listed with file_type::not_found.
+// Entries that cannot be analyzed (sockets, fifos, devices, vanished entries) are skipped.
+// directoryFd is either -1 or DirectoryEntry::directoryFd of the listed directory.
+// Throws std::filesystem::filesystem_error if the directory itself cannot be read.
+void readDirectory(const std::filesystem::path &directory,
+                   bool followSymlinks,
+                   std::vector<DirectoryEntry> &entries,
+                   Backend backend = Backend::DEFAULT,
+                   int directoryFd = -1);
+
+// Closes DirectoryEntry::directoryFd of a directory that is not passed to readDirectory().
+void releaseDirectory(int directoryFd);
+
+// true if the IO_URING backend is supported by the running kernel
+bool isIoUringAvailable();
+
+// FileId of a single (followed) file, {0, 0} if it has a single link or the platform does not
+// provide file ids
+FileId getFileId(const std::filesystem::path &file);
+
+// std::filesystem based implementation, available on every platform
+void readDirectoryPortable(const std::filesystem::path &directory,
+                           bool followSymlinks,
+                           std::vector<DirectoryEntry> &entries);
+
+#if defined(__linux__)
+// getdents64 + statx based implementation, needs at most one statx call per listed entry
+void readDirectoryLinux(const std::filesystem::path &directory,
+                        bool followSymlinks,
+                        std::vector<DirectoryEntry> &entries,
+                        int directoryFd = -1);
+#endif
+} // namespace DDK::SCAN
@@ -0,0 +1,269 @@
+#include "snapshot.hpp"
+#include "MemoryMapped.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace DDK::SCAN {
+namespace {
+constexpr char MAGIC[8] = {'D', 'D', 'K', 'S', 'N', 'A', 'P', 'S'};
+constexpr std::uint32_t FLAG_FOLLOW_SYMLINKS = 0x01;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t count;
+};
+
+// followed by the path and the entries of the directory
+struct Record {
+    Snapshot::State state;
+    std::uint64_t pathSize;
+    std::uint64_t entriesCount;
+    std::uint64_t entriesBytes;
+};
+
+// followed by the name
+struct Entry {
+    std::uint64_t size;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint32_t nameSize;
+    std::uint8_t type;
+    std::uint8_t symlink;
+    std::uint16_t reserved;
+};
+
+constexpr std::size_t PATH_CHAR_SIZE = sizeof(std::filesystem::path::value_type);
+
+template <typename T> void append(std::string &record, const T &value) {
+    record.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// true if a record is stored at begin and ends before end
+bool isRecord(const char *begin, const char *end) {
+    Record record;
+    if (static_cast<std::size_t>(end - begin) < sizeof(Record)) {
+        return false;
+    }
+    std::memcpy(&record, begin, sizeof(Record));
+    const std::size_t available = static_cast<std::size_t>(end - begin) - sizeof(Record);
+    return record.pathSize <= available / PATH_CHAR_SIZE &&
+           record.entriesBytes <= available - record.pathSize * PATH_CHAR_SIZE;
+}
+
+std::size_t getRecordSize(const char *record) {
+    Record header;
+    std::memcpy(&header, record, sizeof(Record));
+    return sizeof(Record) + header.pathSize * PATH_CHAR_SIZE + header.entriesBytes;
+}
+
+// false if the entries of record are malformed
+bool readEntries(const char *record, std::vector<DirectoryEntry> &entries) {
+    Record header;
+    std::memcpy(&header, record, sizeof(Record));
+    const char *position = record + sizeof(Record) + header.pathSize * PATH_CHAR_SIZE;
+    const char *const end = position + header.entriesBytes;
+
+    entries.clear();
+    for (std::uint64_t i = 0; i < header.entriesCount; i++) {
+        Entry entry;
+        if (static_cast<std::size_t>(end - position) < sizeof(Entry)) {
+            return false;
+        }
+        std::memcpy(&entry, position, sizeof(Entry));
+        position += sizeof(Entry);
+        if (static_cast<std::size_t>(end - position) < entry.nameSize) {
+            return false;
+        }
+        entries.push_back({std::string(position, entry.nameSize),
+                           static_cast<std::filesystem::file_type>(entry.type), entry.size,
+                           entry.symlink != 0, -1, FileId{entry.device, entry.inode}});
+        position += entry.nameSize;
+    }
+    return position == end;
+}
+} // namespace
+
+bool Snapshot::State::operator==(const State &other) const {
+    return device == other.device && inode == other.inode && mtime == other.mtime &&
+           ctime == other.ctime;
+}
+
+Snapshot::Snapshot(const std::filesystem::path &path, bool followSymlinks)
+    : m_path(path), m_followSymlinks(followSymlinks),
+      m_racyAfter(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch() - RACY_INTERVAL)
+                      .count()) {
+    static_assert(sizeof(Record) == 56 && sizeof(Entry) == 32,
+                  "records are stored without padding");
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        return;
+    }
+    m_file = std::make_unique<MemoryMapped>();
+    if (!m_file->open(path.string(), MemoryMapped::MapRange::WholeFile,
+                      MemoryMapped::CacheHint::SequentialScan) ||
+        m_file->size() < sizeof(Header)) {
+        return;
+    }
+
+    // a file of another version, symlink handling or byte order starts an empty snapshot
+    Header header;
+    std::memcpy(&header, m_file->getData(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.flags != (followSymlinks ? FLAG_FOLLOW_SYMLINKS : 0)) {
+        return;
+    }
+
+    const char *position = reinterpret_cast<const char *>(m_file->getData()) + sizeof(Header);
+    const char *const end = reinterpret_cast<const char *>(m_file->getData()) + m_file->size();
+    for (std::uint64_t i = 0; i < header.count; i++) {
+        if (!isRecord(position, end)) {
+            m_loaded.clear();
+            return;
+        }
+        Record record;
+        std::memcpy(&record, position, sizeof(Record));
+        const KeyView key(
+            reinterpret_cast<const std::filesystem::path::value_type *>(position + sizeof(Record)),
+            static_cast<std::size_t>(record.pathSize));
+        m_loaded.emplace(key, position);
+        position += getRecordSize(position);
+    }
+}
+
+Snapshot::~Snapshot() = default;
+
+std::optional<Snapshot::State> Snapshot::getState(const std::filesystem::path &directory,
+                                                  int directoryFd) {
+#if defined(_WIN32)
+    return std::nullopt;
+#else
+    struct stat status;
+    if ((directoryFd >= 0 ? fstat(directoryFd, &status) : stat(directory.c_str(), &status)) != 0) {
+        return std::nullopt;
+    }
+#if defined(__APPLE__)
+    const timespec &mtime = status.st_mtimespec;
+    const timespec &ctime = status.st_ctimespec;
+#else
+    const timespec &mtime = status.st_mtim;
+    const timespec &ctime = status.st_ctim;
+#endif
+    constexpr std::int64_t NANOSECONDS = 1000000000;
+    return State{static_cast<std::uint64_t>(status.st_dev),
+                 static_cast<std::uint64_t>(status.st_ino),
+                 static_cast<std::int64_t>(mtime.tv_sec) * NANOSECONDS + mtime.tv_nsec,
+                 static_cast<std::int64_t>(ctime.tv_sec) * NANOSECONDS + ctime.tv_nsec};
+#endif
+}
+
+bool Snapshot::find(const std::filesystem::path &directory,
+                    const State &state,
+                    std::vector<DirectoryEntry> &entries) {
+    // the loaded records are never modified, only the counters and records need the lock
+    const auto loaded = m_loaded.find(KeyView(directory.native()));
+    bool found = false;
+    if (loaded != m_loaded.end()) {
+        Record record;
+        std::memcpy(&record, loaded->second, sizeof(Record));
+        found = record.state == state && readEntries(loaded->second, entries);
+    }
+    if (!found) {
+        entries.clear();
+    }
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if (!found) {
+        m_listed++;
+        return false;
+    }
+    m_reused++;
+    m_records.insert_or_assign(directory.native(),
+                               std::string(loaded->second, getRecordSize(loaded->second)));
+    return true;
+}
+
+void Snapshot::insert(const std::filesystem::path &directory,
+                      const State &state,
+                      const std::vector<DirectoryEntry> &entries) {
+    if (state.mtime >= m_racyAfter || state.ctime >= m_racyAfter) {
+        return;
+    }
+
+    std::string record;
+    const Key &key = directory.native();
+    append(record, Record{state, key.size(), entries.size(), 0});
+    record.append(reinterpret_cast<const char *>(key.data()), key.size() * PATH_CHAR_SIZE);
+    const std::size_t entriesBegin = record.size();
+    for (const DirectoryEntry &entry : entries) {
+        // the targets of followed symlinks change without touching the directory
+        if (m_followSymlinks && entry.symlink) {
+            return;
+        }
+        append(record, Entry{entry.size, entry.fileId.device, entry.fileId.inode,
+                             static_cast<std::uint32_t>(entry.name.size()),
+                             static_cast<std::uint8_t>(entry.type),
+                             static_cast<std::uint8_t>(entry.symlink ? 1 : 0), 0});
+        record += entry.name;
+    }
+    const std::uint64_t entriesBytes = record.size() - entriesBegin;
+    std::memcpy(&record[offsetof(Record, entriesBytes)], &entriesBytes, sizeof(entriesBytes));
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_records.insert_or_assign(key, std::move(record));
+}
+
+bool Snapshot::save() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    // written next to the snapshot file and renamed, so readers never see a partial file
+    std::filesystem::path temporary = m_path;
+    temporary += ".tmp";
+#if !defined(_WIN32)
+    temporary += std::to_string(getpid());
+#endif
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    Header header{{}, VERSION, m_followSymlinks ? FLAG_FOLLOW_SYMLINKS : 0, m_records.size()};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    for (const auto &[directory, record] : m_records) {
+        file.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+    file.close();
+
+    std::error_code error;
+    if (file) {
+        std::filesystem::rename(temporary, m_path, error);
+    }
+    if (!file || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+std::size_t Snapshot::getReusedCount() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reused;
+}
+
+std::size_t Snapshot::getListedCount() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_listed;
+}
+
+std::size_t Snapshot::size() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records.size();
+}
+} // namespace DDK::SCAN
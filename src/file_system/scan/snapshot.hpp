@@ -0,0 +1,90 @@
+#pragma once
+
+#include "directory_reader.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class MemoryMapped;
+
+namespace DDK::SCAN {
+// Directory listings of a previous scan, stored in a file that is memory mapped for lookups. A
+// listing is only reused while mtime and ctime of its directory are unchanged, which holds as long
+// as no entry was added, removed or renamed. Every directory is still checked on its own, since
+// changes deep within a tree never reach the timestamps of its ancestors. Files that were modified
+// in place keep the size of their listing until their directory changes, hashing checks the size
+// of every file it opens, so such files are never reported as duplicates.
+// Listings read during this run are kept in memory until save() replaces the file with all
+// listings found or inserted during this run. All functions are thread safe.
+class Snapshot {
+  public:
+    static constexpr std::uint32_t VERSION = 1;
+    // directories changed this shortly before the snapshot was opened are never stored, a change
+    // within the same timestamp tick would go unnoticed
+    static constexpr std::chrono::seconds RACY_INTERVAL{1};
+
+    // identity and state of a directory
+    struct State {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::int64_t mtime;
+        std::int64_t ctime;
+
+        bool operator==(const State &other) const;
+    };
+
+    // Loads path if it exists and was written with the same version and symlink handling.
+    Snapshot(const std::filesystem::path &path, bool followSymlinks);
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    // directoryFd is either -1 or an open descriptor of directory, nullopt if the directory can
+    // not be stat'ed or the platform has no inodes
+    static std::optional<State> getState(const std::filesystem::path &directory,
+                                         int directoryFd = -1);
+
+    // Replaces entries with the stored listing of directory and returns true if directory is
+    // still in state. Counts a reused or a listed directory.
+    bool find(const std::filesystem::path &directory,
+              const State &state,
+              std::vector<DirectoryEntry> &entries);
+    // state has to be taken before the directory was listed
+    void insert(const std::filesystem::path &directory,
+                const State &state,
+                const std::vector<DirectoryEntry> &entries);
+    // Atomically replaces the snapshot file. Returns false if the file could not be written.
+    bool save();
+
+    std::size_t getReusedCount() const;
+    std::size_t getListedCount() const;
+    // listings found or inserted during this run
+    std::size_t size() const;
+
+  private:
+    using Key = std::basic_string<std::filesystem::path::value_type>;
+    using KeyView = std::basic_string_view<std::filesystem::path::value_type>;
+
+    const std::filesystem::path m_path;
+    const bool m_followSymlinks;
+    const std::int64_t m_racyAfter;
+
+    mutable std::mutex m_mutex;
+    std::unique_ptr<MemoryMapped> m_file;
+    // directory path -> record within the mapped file
+    std::unordered_map<KeyView, const char *> m_loaded;
+    // directory path -> serialized record, written by save()
+    std::unordered_map<Key, std::string> m_records;
+    std::size_t m_reused = 0;
+    std::size_t m_listed = 0;
+};
+} // namespace DDK::SCAN
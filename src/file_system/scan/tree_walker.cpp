@@ -0,0 +1,80 @@
+#include "tree_walker.hpp"
+#include "parallel/work_stealing_pool.hpp"
+
+#include <memory>
+
+namespace DDK::SCAN {
+namespace {
+struct WalkContext {
+    const bool followSymlinks;
+    const Backend backend;
+    PARALLEL::WorkStealingPool *const pool;
+    const ListingHandler &onListing;
+    const ErrorHandler &onError;
+    Snapshot *const snapshot;
+};
+
+// directoryFd is the already opened directory handed out by the scan backend or -1
+void walkDirectory(const std::shared_ptr<const WalkContext> &context,
+                   DirectoryId directory,
+                   const std::filesystem::path &path,
+                   int directoryFd) {
+    std::vector<DirectoryEntry> entries;
+    // taken before listing, a change while listing has to invalidate the stored listing
+    const std::optional<Snapshot::State> state =
+        context->snapshot != nullptr ? Snapshot::getState(path, directoryFd) : std::nullopt;
+    if (state && context->snapshot->find(path, *state, entries)) {
+        releaseDirectory(directoryFd);
+    } else {
+        try {
+            readDirectory(path, context->followSymlinks, entries, context->backend, directoryFd);
+        } catch (const std::exception &e) {
+            context->onError(directory);
+            return;
+        }
+        if (state) {
+            context->snapshot->insert(path, *state, entries);
+        }
+    }
+
+    std::vector<DirectoryId> subdirectories;
+    context->onListing(directory, entries, subdirectories);
+
+    std::size_t subdirectory = 0;
+    for (const DirectoryEntry &entry : entries) {
+        if (entry.type != std::filesystem::file_type::directory) {
+            continue;
+        }
+
+        const DirectoryId child = subdirectories.at(subdirectory++);
+        std::filesystem::path childPath = path / std::filesystem::u8path(entry.name);
+        if (context->pool != nullptr) {
+            // tasks share the context, it lives until the last task finished
+            context->pool->submit([context, child, childPath = std::move(childPath),
+                                   fd = entry.directoryFd]() {
+                walkDirectory(context, child, childPath, fd);
+            });
+        } else {
+            walkDirectory(context, child, childPath, entry.directoryFd);
+        }
+    }
+}
+} // namespace
+
+void walkTree(const std::filesystem::path &root,
+              DirectoryId rootId,
+              bool followSymlinks,
+              Backend backend,
+              PARALLEL::WorkStealingPool *const pool,
+              const ListingHandler &onListing,
+              const ErrorHandler &onError,
+              Snapshot *const snapshot) {
+    const auto context = std::make_shared<const WalkContext>(
+        WalkContext{followSymlinks, backend, pool, onListing, onError, snapshot});
+    if (pool != nullptr) {
+        pool->submit([context, rootId, root]() { walkDirectory(context, rootId, root, -1); });
+    } else {
+        walkDirectory(context, rootId, root, -1);
+    }
+}
+} // namespace DDK::SCAN
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "directory_reader.hpp"
+#include "snapshot.hpp"
+
+namespace DDK {
+namespace PARALLEL {
+class WorkStealingPool;
+}
+
+namespace SCAN {
+// caller defined id of a directory, passed back to the handlers
+using DirectoryId = std::uint32_t;
+
+// Receives the listing of a directory and appends the ids of all listed subdirectories in listing
+// order to subdirectories.
+using ListingHandler = std::function<void(DirectoryId directory,
+                                          const std::vector<DirectoryEntry> &entries,
+                                          std::vector<DirectoryId> &subdirectories)>;
+// Receives directories that could not be listed (permission denied, deleted, etc.).
+using ErrorHandler = std::function<void(DirectoryId directory)>;
+
+// Lists root and all of its subdirectories. Without a pool the tree is walked depth first on the
+// calling thread. With a pool every subdirectory is listed by its own task, the handlers are
+// called concurrently and the walk is finished once pool->wait() returns. The handlers have to
+// outlive the walk. Directories that did not change since the listing stored in snapshot are not
+// read again and every listing that was read is inserted into snapshot.
+void walkTree(const std::filesystem::path &root,
+              DirectoryId rootId,
+              bool followSymlinks,
+              Backend backend,
+              PARALLEL::WorkStealingPool *const pool,
+              const ListingHandler &onListing,
+              const ErrorHandler &onError,
+              Snapshot *const snapshot = nullptr);
+} // namespace SCAN
+} // namespace DDK
@@ -0,0 +1,444 @@
+#include "streaming_deduplication.hpp"
+#include "parallel/work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace DDK::STREAM {
+StreamingDeduplication::StreamingDeduplication(const std::filesystem::path &path,
+                                               bool analyzeSymLinks,
+                                               std::size_t threads,
+                                               SCAN::Backend backend,
+                                               const FILTER::DEDUPLICATION::HashStages &stages,
+                                               SCAN::Snapshot *const snapshot) :
+    m_root(path),
+    m_analyzeSymLinks(analyzeSymLinks),
+    m_hashStages(stages),
+    m_directoriesCount(0),
+    m_symlinksCount(0),
+    m_filesCount(0),
+    m_totalSize(0),
+    m_candidatesCount(0) {
+    const bool symlink = std::filesystem::is_symlink(path);
+    const std::filesystem::file_type type = std::filesystem::status(path).type();
+
+    if (!std::filesystem::exists(path) || type == std::filesystem::file_type::not_found) {
+        return;
+    }
+
+    // a single file can not have any duplicates
+    if (type != std::filesystem::file_type::directory) {
+        m_symlinksCount = symlink ? 1 : 0;
+        if (type == std::filesystem::file_type::regular) {
+            m_filesCount = 1;
+            m_totalSize = std::filesystem::file_size(path);
+        }
+        return;
+    }
+
+    m_directoriesCount = 1;
+    m_names = path.native();
+    m_directories.push_back({{0, m_names.size()}, NO_INDEX});
+
+    // the pool hashes as well, so it is bounded like the hashing of FileSystemInfo
+    std::unique_ptr<PARALLEL::WorkStealingPool> pool;
+    const std::size_t poolThreads = std::min(PARALLEL::resolveThreadsCount(threads),
+                                             FILTER::DEDUPLICATION::MAX_HASHING_THREADS);
+    if (poolThreads > 1) {
+        pool = std::make_unique<PARALLEL::WorkStealingPool>(poolThreads);
+    }
+
+    PARALLEL::WorkStealingPool *const hashPool = pool.get();
+    const SCAN::ListingHandler onListing =
+        [this, hashPool](SCAN::DirectoryId directory,
+                         const std::vector<SCAN::DirectoryEntry> &entries,
+                         std::vector<SCAN::DirectoryId> &subdirectories) {
+            std::vector<FileToHash> filesToHash;
+            addListing(directory, entries, subdirectories, filesToHash);
+            // small files are hashed right away by the scanning thread, a task per file would
+            // cost more than reading them
+            const auto small = std::stable_partition(
+                filesToHash.begin(), filesToHash.end(), [this](const FileToHash &file) {
+                    return file.second > m_hashStages.singleReadThreshold;
+                });
+            const std::vector<FileToHash> smallFiles(small, filesToHash.end());
+            filesToHash.erase(small, filesToHash.end());
+            hashFiles(filesToHash, FILTER::DEDUPLICATION::HashStage::HEAD, hashPool);
+            if (!smallFiles.empty()) {
+                hashTask(smallFiles, FILTER::DEDUPLICATION::HashStage::HEAD);
+            }
+        };
+    // directories that could not be listed are skipped like in FileSystemInfo
+    const SCAN::ErrorHandler onError = [](SCAN::DirectoryId) {};
+
+    SCAN::walkTree(path, 0, analyzeSymLinks, backend, pool.get(), onListing, onError, snapshot);
+    if (pool) {
+        pool->wait();
+    }
+
+    hashStage(FILTER::DEDUPLICATION::HashStage::TAIL, pool.get());
+    hashStage(FILTER::DEDUPLICATION::HashStage::FULL, pool.get());
+    collectDuplicates();
+}
+
+void StreamingDeduplication::addListing(SCAN::DirectoryId directory,
+                                        const std::vector<SCAN::DirectoryEntry> &entries,
+                                        std::vector<SCAN::DirectoryId> &subdirectories,
+                                        std::vector<FileToHash> &filesToHash) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_directories.size() + m_files.size() + entries.size() >= NO_INDEX) {
+        throw std::length_error("too many file system items");
+    }
+
+    // the directory itself only counts once its content is known
+    if (directory != 0) {
+        m_directoriesCount++;
+    }
+
+    for (const SCAN::DirectoryEntry &entry : entries) {
+        if (entry.type == std::filesystem::file_type::directory) {
+            subdirectories.push_back(static_cast<Index>(m_directories.size()));
+        } else {
+            m_symlinksCount += entry.symlink ? 1 : 0;
+            if (entry.type != std::filesystem::file_type::regular) {
+                continue;
+            }
+            m_filesCount++;
+            m_totalSize += entry.size;
+            // empty files are never listed as duplicates
+            if (entry.size == 0) {
+                continue;
+            }
+        }
+
+        const std::size_t offset = m_names.size();
+#if defined(_WIN32)
+        m_names += std::filesystem::u8path(entry.name).native();
+#else
+        m_names += entry.name;
+#endif
+        const Name name{offset, m_names.size() - offset};
+
+        if (entry.type == std::filesystem::file_type::directory) {
+            m_directories.push_back({name, directory});
+            continue;
+        }
+
+        const Index file = static_cast<Index>(m_files.size());
+        m_files.push_back({name, 0, directory, NO_INDEX, NO_INDEX, false});
+
+        // further links of a file share the hash of the first one
+        if (entry.fileId.isHardlinked()) {
+            const auto [hardlink, added] = m_hardlinks.try_emplace(entry.fileId, file);
+            if (!added) {
+                File &first = m_files[hardlink->second];
+                m_files[file].link = first.link;
+                first.link = file;
+                continue;
+            }
+        }
+
+        const auto [bucket, inserted] = m_buckets.try_emplace(entry.size, file);
+        if (inserted) {
+            continue;
+        }
+
+        // the first member of a bucket is hashed as soon as the second one shows up
+        const Index head = bucket->second;
+        if (m_files[head].next == NO_INDEX) {
+            filesToHash.emplace_back(head, entry.size);
+            m_candidatesCount++;
+        }
+        m_files[file].next = head;
+        bucket->second = file;
+        filesToHash.emplace_back(file, entry.size);
+        m_candidatesCount++;
+    }
+}
+
+void StreamingDeduplication::hashTask(const std::vector<FileToHash> &files,
+                                      FILTER::DEDUPLICATION::HashStage stage) {
+    std::vector<FILTER::DEDUPLICATION::HashedFile> hashedFiles;
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &[file, size] : files) {
+            hashedFiles.push_back({getFilePath(file), size, m_files[file].hash});
+        }
+    }
+
+    FILTER::DEDUPLICATION::hashFilesStage(hashedFiles, stage, m_hashStages);
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::size_t i = 0; i < files.size(); i++) {
+        m_files[files[i].first].hash = hashedFiles[i].hash;
+        m_files[files[i].first].unreadable = hashedFiles[i].unreadable;
+        m_hashStatistics.addHashed(files[i].second, stage, m_hashStages);
+    }
+}
+
+void StreamingDeduplication::hashFiles(const std::vector<FileToHash> &files,
+                                       FILTER::DEDUPLICATION::HashStage stage,
+                                       PARALLEL::WorkStealingPool *pool) {
+    // with io_uring the reads of all files of a task are in flight together
+    const std::size_t taskFiles = std::max<std::size_t>(1, m_hashStages.ioUringQueueDepth);
+    for (std::size_t begin = 0; begin < files.size(); begin += taskFiles) {
+        std::vector<FileToHash> task(files.begin() + begin,
+                                     files.begin() + std::min(files.size(), begin + taskFiles));
+        if (pool != nullptr) {
+            pool->submit([this, task = std::move(task), stage]() { hashTask(task, stage); });
+        } else {
+            hashTask(task, stage);
+        }
+    }
+}
+
+void StreamingDeduplication::hashStage(FILTER::DEDUPLICATION::HashStage stage,
+                                       PARALLEL::WorkStealingPool *pool) {
+    const auto previousStage =
+        static_cast<FILTER::DEDUPLICATION::HashStage>(static_cast<int>(stage) - 1);
+
+    std::vector<FileToHash> filesToHash;
+    std::vector<Index> members;
+    for (auto &[size, head] : m_buckets) {
+        if (head == NO_INDEX || m_files[head].next == NO_INDEX) {
+            continue;
+        }
+
+        members.clear();
+        for (Index file = head; file != NO_INDEX; file = m_files[file].next) {
+            if (m_files[file].unreadable) {
+                m_hashStatistics.addDropped(size, previousStage, m_hashStages);
+            } else {
+                members.push_back(file);
+            }
+        }
+        std::sort(members.begin(), members.end(), [this](const Index lhs, const Index rhs) {
+            return m_files[lhs].hash < m_files[rhs].hash;
+        });
+
+        // the bucket is rebuilt from the members that still collide
+        head = NO_INDEX;
+        auto groupBegin = members.begin();
+        while (groupBegin != members.end()) {
+            const HASH::Hash hash = m_files[*groupBegin].hash;
+            const auto groupEnd =
+                std::find_if(groupBegin, members.end(),
+                             [this, hash](const Index file) { return m_files[file].hash != hash; });
+            if (groupEnd - groupBegin == 1) {
+                m_hashStatistics.addDropped(size, previousStage, m_hashStages);
+                groupBegin = groupEnd;
+                continue;
+            }
+            for (auto file = groupBegin; file != groupEnd; file++) {
+                m_files[*file].next = head;
+                head = *file;
+                // the content hash of smaller files is already known
+                if (FILTER::DEDUPLICATION::getLastHashStage(size, m_hashStages) >= stage) {
+                    filesToHash.emplace_back(*file, size);
+                }
+            }
+            groupBegin = groupEnd;
+        }
+    }
+
+    // the segments of large files are hashed by separate tasks and combined afterwards
+    struct SegmentedFile {
+        Index index;
+        FILTER::DEDUPLICATION::HashedFile file;
+        std::vector<std::optional<HASH::Hash>> segmentHashes;
+    };
+    std::vector<SegmentedFile> segmentedFiles;
+    if (pool != nullptr && stage == FILTER::DEDUPLICATION::HashStage::FULL) {
+        const auto segmented = std::stable_partition(
+            filesToHash.begin(), filesToHash.end(), [this](const FileToHash &file) {
+                return FILTER::DEDUPLICATION::getSegmentsCount(file.second, m_hashStages) == 0;
+            });
+        for (auto file = segmented; file != filesToHash.end(); file++) {
+            FILTER::DEDUPLICATION::HashedFile hashedFile{getFilePath(file->first), file->second,
+                                                         m_files[file->first].hash};
+            if (FILTER::DEDUPLICATION::findCachedHash(hashedFile, stage, m_hashStages)) {
+                m_files[file->first].hash = hashedFile.hash;
+                m_hashStatistics.addHashed(file->second, stage, m_hashStages);
+                continue;
+            }
+            const std::size_t segments =
+                FILTER::DEDUPLICATION::getSegmentsCount(file->second, m_hashStages);
+            segmentedFiles.push_back({file->first, std::move(hashedFile),
+                                      std::vector<std::optional<HASH::Hash>>(segments)});
+        }
+        filesToHash.erase(segmented, filesToHash.end());
+    }
+    for (SegmentedFile &segmentedFile : segmentedFiles) {
+        for (std::size_t segment = 0; segment < segmentedFile.segmentHashes.size(); segment++) {
+            pool->submit([this, &segmentedFile, segment]() {
+                segmentedFile.segmentHashes[segment] = FILTER::DEDUPLICATION::hashSegment(
+                    segmentedFile.file.path, segmentedFile.file.size, segment, m_hashStages);
+            });
+        }
+    }
+
+    hashFiles(filesToHash, stage, pool);
+    if (pool != nullptr) {
+        pool->wait();
+    }
+
+    for (SegmentedFile &segmentedFile : segmentedFiles) {
+        const std::optional<HASH::Hash> hash =
+            FILTER::DEDUPLICATION::combineSegmentHashes(segmentedFile.segmentHashes, m_hashStages);
+        segmentedFile.file.hash = hash.value_or(HASH::Hash{});
+        segmentedFile.file.unreadable = !hash;
+        FILTER::DEDUPLICATION::cacheHash(segmentedFile.file, stage, m_hashStages);
+        m_files[segmentedFile.index].hash = segmentedFile.file.hash;
+        m_files[segmentedFile.index].unreadable = segmentedFile.file.unreadable;
+        m_hashStatistics.addHashed(segmentedFile.file.size, stage, m_hashStages);
+    }
+}
+
+std::filesystem::path StreamingDeduplication::getFilePath(Index file) const {
+    thread_local std::vector<const Name *> names;
+    names.clear();
+    names.push_back(&m_files[file].name);
+    for (Index directory = m_files[file].directory; directory != NO_INDEX;
+         directory = m_directories[directory].parent) {
+        names.push_back(&m_directories[directory].name);
+    }
+
+    std::size_t size = 0;
+    for (const Name *const name : names) {
+        size += 1 + name->size;
+    }
+
+    // same as FileTable::getPath(), the root directory holds the full path
+    std::filesystem::path::string_type path;
+    path.reserve(size);
+    for (auto name = names.rbegin(); name != names.rend(); name++) {
+        if (!path.empty() && path.back() != std::filesystem::path::preferred_separator) {
+            path += std::filesystem::path::preferred_separator;
+        }
+        path.append(m_names, (*name)->offset, (*name)->size);
+    }
+    return path;
+}
+
+void StreamingDeduplication::collectDuplicates() {
+    struct Group {
+        HASH::Hash hash;
+        std::uintmax_t size;
+        std::vector<Index> files;
+    };
+    std::vector<Group> groups;
+
+    std::vector<Index> members;
+    std::vector<std::pair<std::filesystem::path, Index>> sortedMembers;
+    for (const auto &[size, head] : m_buckets) {
+        if (head == NO_INDEX || m_files[head].next == NO_INDEX) {
+            continue;
+        }
+
+        members.clear();
+        for (Index file = head; file != NO_INDEX; file = m_files[file].next) {
+            if (!m_files[file].unreadable) {
+                members.push_back(file);
+            }
+        }
+        std::sort(members.begin(), members.end(), [this](const Index lhs, const Index rhs) {
+            return m_files[lhs].hash < m_files[rhs].hash;
+        });
+
+        auto groupBegin = members.begin();
+        while (groupBegin != members.end()) {
+            const HASH::Hash hash = m_files[*groupBegin].hash;
+            const auto groupEnd =
+                std::find_if(groupBegin, members.end(),
+                             [this, hash](const Index file) { return m_files[file].hash != hash; });
+            // links of a single file are no duplicates
+            if (groupEnd - groupBegin > 1) {
+                sortedMembers.clear();
+                for (auto file = groupBegin; file != groupEnd; file++) {
+                    for (Index link = *file; link != NO_INDEX; link = m_files[link].link) {
+                        sortedMembers.emplace_back(getFilePath(link), link);
+                    }
+                }
+                std::sort(sortedMembers.begin(), sortedMembers.end());
+
+                Group group{hash, size, {}};
+                for (const auto &member : sortedMembers) {
+                    group.files.push_back(member.second);
+                }
+                groups.push_back(std::move(group));
+            }
+            groupBegin = groupEnd;
+        }
+    }
+
+    // same order as FileSystemInfo::getDuplicates()
+    std::sort(groups.begin(), groups.end(), [](const Group &lhs, const Group &rhs) {
+        return lhs.hash != rhs.hash ? lhs.hash > rhs.hash : lhs.size > rhs.size;
+    });
+
+    // only directories and duplicates are kept, files are stored in the order they are listed
+    std::filesystem::path::string_type names;
+    const auto keepName = [this, &names](Name &name) {
+        const std::size_t offset = names.size();
+        names.append(m_names, name.offset, name.size);
+        name.offset = offset;
+    };
+    for (Directory &directory : m_directories) {
+        keepName(directory.name);
+    }
+
+    std::vector<File> duplicates;
+    for (const Group &group : groups) {
+        m_ranges.push_back(group.files.size());
+        for (const Index file : group.files) {
+            duplicates.push_back(m_files[file]);
+            keepName(duplicates.back().name);
+        }
+    }
+
+    m_names = std::move(names);
+    m_names.shrink_to_fit();
+    m_directories.shrink_to_fit();
+    m_files = std::move(duplicates);
+    m_buckets = std::unordered_map<std::uintmax_t, Index>();
+    m_hardlinks = std::unordered_map<SCAN::FileId, Index, SCAN::FileIdHash>();
+}
+
+std::tuple<std::vector<std::filesystem::path>, std::vector<std::size_t>>
+StreamingDeduplication::getDuplicates() const {
+    std::vector<std::filesystem::path> duplicates;
+    duplicates.reserve(m_files.size());
+    for (Index file = 0; file < m_files.size(); file++) {
+        duplicates.push_back(getFilePath(file));
+    }
+    return {duplicates, m_ranges};
+}
+
+std::size_t StreamingDeduplication::getDuplicatesCount() const { return m_files.size(); }
+
+std::filesystem::path StreamingDeduplication::getDuplicatePath(std::size_t duplicate) const {
+    return getFilePath(static_cast<Index>(duplicate));
+}
+
+std::vector<std::size_t> StreamingDeduplication::getDuplicateRanges() const { return m_ranges; }
+
+std::size_t StreamingDeduplication::getDirectoriesCount() const { return m_directoriesCount; }
+
+std::size_t StreamingDeduplication::getSymlinksCount() const { return m_symlinksCount; }
+
+std::size_t StreamingDeduplication::getFilesCount() const { return m_filesCount; }
+
+std::uintmax_t StreamingDeduplication::getTotalSize() const { return m_totalSize; }
+
+std::size_t StreamingDeduplication::getCandidatesCount() const { return m_candidatesCount; }
+
+FILTER::DEDUPLICATION::HashStatistics StreamingDeduplication::getHashStatistics() const {
+    return m_hashStatistics;
+}
+
+std::filesystem::path StreamingDeduplication::getRootPath() const { return m_root; }
+
+bool StreamingDeduplication::symlinks() const { return m_analyzeSymLinks; }
+} // namespace DDK::STREAM
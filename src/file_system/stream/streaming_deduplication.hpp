@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "filter/deduplication.hpp"
+#include "scan/tree_walker.hpp"
+
+namespace DDK::PARALLEL {
+class WorkStealingPool;
+}
+
+namespace DDK::STREAM {
+// Duplicate search that never builds the item tree. The scan pushes every non empty regular file
+// straight into the bucket of its size and the head blocks of the members of a bucket are hashed
+// as soon as the bucket has two of them, so hashing overlaps with scanning. The remaining hash
+// stages run after the scan for the files that still collide. Hard links of a file enter the
+// bucket only once. Only directories and non empty files are stored while scanning and only
+// directories and duplicates are kept afterwards.
+class StreamingDeduplication {
+  public:
+    // threads > 1 (or 0 for all hardware threads) scans and hashes on a work-stealing thread pool,
+    // see FileSystemInfo for snapshot
+    StreamingDeduplication(const std::filesystem::path &path,
+                           bool analyzeSymLinks,
+                           std::size_t threads = 1,
+                           SCAN::Backend backend = SCAN::Backend::DEFAULT,
+                           const FILTER::DEDUPLICATION::HashStages &stages = {},
+                           SCAN::Snapshot *const snapshot = nullptr);
+
+    // Same layout as FileSystemInfo::getDuplicates(): duplicates ordered by descending hash and
+    // the number of files of every group. Files within a group are ordered by path.
+    std::tuple<std::vector<std::filesystem::path>, std::vector<std::size_t>> getDuplicates()
+        const;
+    // Accessors for the same list without building all paths at once. duplicate is the position
+    // within the list returned by getDuplicates().
+    std::size_t getDuplicatesCount() const;
+    std::filesystem::path getDuplicatePath(std::size_t duplicate) const;
+    std::vector<std::size_t> getDuplicateRanges() const;
+    std::size_t getDirectoriesCount() const;
+    std::size_t getSymlinksCount() const;
+    std::size_t getFilesCount() const;
+    std::uintmax_t getTotalSize() const;
+    // files that share their size with at least one other file and had to be hashed
+    std::size_t getCandidatesCount() const;
+    FILTER::DEDUPLICATION::HashStatistics getHashStatistics() const;
+    std::filesystem::path getRootPath() const;
+    bool symlinks() const;
+
+  private:
+    using Index = std::uint32_t;
+    static constexpr Index NO_INDEX = UINT32_MAX;
+
+    struct Name {
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    struct Directory {
+        Name name;
+        Index parent;
+    };
+
+    struct File {
+        Name name;
+        HASH::Hash hash;
+        Index directory;
+        // next file of the same size bucket
+        Index next;
+        // next link of the same file, only the first link of a file is added to a bucket
+        Index link;
+        // the file could not be read, so its hash is meaningless and it is never a duplicate
+        bool unreadable;
+    };
+
+    // file and its size
+    using FileToHash = std::pair<Index, std::uintmax_t>;
+
+    void addListing(SCAN::DirectoryId directory,
+                    const std::vector<SCAN::DirectoryEntry> &entries,
+                    std::vector<SCAN::DirectoryId> &subdirectories,
+                    std::vector<FileToHash> &filesToHash);
+    void hashTask(const std::vector<FileToHash> &files, FILTER::DEDUPLICATION::HashStage stage);
+    void hashFiles(const std::vector<FileToHash> &files,
+                   FILTER::DEDUPLICATION::HashStage stage,
+                   PARALLEL::WorkStealingPool *pool);
+    // drops the bucket members that were told apart by the previous stage or could not be read
+    // and hashes the others
+    void hashStage(FILTER::DEDUPLICATION::HashStage stage, PARALLEL::WorkStealingPool *pool);
+    std::filesystem::path getFilePath(Index file) const;
+    // groups the hashed buckets and releases everything that was only needed while scanning
+    void collectDuplicates();
+
+    const std::filesystem::path m_root;
+    const bool m_analyzeSymLinks;
+    const FILTER::DEDUPLICATION::HashStages m_hashStages;
+
+    // guards everything below while scanning
+    mutable std::mutex m_mutex;
+
+    std::filesystem::path::string_type m_names;
+    std::vector<Directory> m_directories;
+    std::vector<File> m_files;
+    // file size -> most recently added file of that size, NO_INDEX once all members were told
+    // apart
+    std::unordered_map<std::uintmax_t, Index> m_buckets;
+    // first link of every file with more than one hard link
+    std::unordered_map<SCAN::FileId, Index, SCAN::FileIdHash> m_hardlinks;
+
+    std::size_t m_directoriesCount;
+    std::size_t m_symlinksCount;
+    std::size_t m_filesCount;
+    std::uintmax_t m_totalSize;
+    std::size_t m_candidatesCount;
+    FILTER::DEDUPLICATION::HashStatistics m_hashStatistics;
+
+    // number of duplicates of every group, m_files only holds duplicates after the scan
+    std::vector<std::size_t> m_ranges;
+};
+} // namespace DDK::STREAM
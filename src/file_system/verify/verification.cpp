@@ -0,0 +1,186 @@
+#include "verification.hpp"
+#include "parallel/work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define DDK_VERIFY_SSE2 1
+// the AVX2 kernel is compiled for its own target and only used if the CPU supports it
+#if defined(__GNUC__)
+#define DDK_VERIFY_AVX2 1
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DDK_VERIFY_NEON 1
+#endif
+
+namespace DDK::VERIFY {
+namespace {
+// per file and thread
+constexpr std::size_t READ_BUFFER_SIZE = 4 * 1024 * 1024;
+
+#if defined(DDK_VERIFY_AVX2)
+__attribute__((target("avx2"))) bool equalBytesAvx2(const char *lhs,
+                                                    const char *rhs,
+                                                    std::size_t size) {
+    std::size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i differences = _mm256_setzero_si256();
+        for (std::size_t j = 0; j < 128; j += 32) {
+            const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i + j));
+            const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i + j));
+            differences = _mm256_or_si256(differences, _mm256_xor_si256(l, r));
+        }
+        if (!_mm256_testz_si256(differences, differences)) {
+            return false;
+        }
+    }
+    for (; i + 32 <= size; i += 32) {
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r)) != -1) {
+            return false;
+        }
+    }
+    return std::memcmp(lhs + i, rhs + i, size - i) == 0;
+}
+#endif
+
+bool equalBytesVector(const char *lhs, const char *rhs, std::size_t size) {
+    std::size_t i = 0;
+#if defined(DDK_VERIFY_SSE2)
+    for (; i + 16 <= size; i += 16) {
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(DDK_VERIFY_NEON)
+    for (; i + 16 <= size; i += 16) {
+        const uint8x16_t l = vld1q_u8(reinterpret_cast<const std::uint8_t *>(lhs + i));
+        const uint8x16_t r = vld1q_u8(reinterpret_cast<const std::uint8_t *>(rhs + i));
+        if (vminvq_u8(vceqq_u8(l, r)) != 0xFF) {
+            return false;
+        }
+    }
+#endif
+    return std::memcmp(lhs + i, rhs + i, size - i) == 0;
+}
+
+using EqualBytesKernel = bool (*)(const char *, const char *, std::size_t);
+
+EqualBytesKernel selectKernel() {
+#if defined(DDK_VERIFY_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return equalBytesAvx2;
+    }
+#endif
+    return equalBytesVector;
+}
+} // namespace
+
+bool equalBytes(const char *lhs, const char *rhs, std::size_t size) {
+    static const EqualBytesKernel kernel = selectKernel();
+    return kernel(lhs, rhs, size);
+}
+
+bool equalFiles(const std::filesystem::path &lhs, const std::filesystem::path &rhs) {
+    std::error_code error;
+    const std::uintmax_t size = std::filesystem::file_size(lhs, error);
+    if (error || size != std::filesystem::file_size(rhs, error) || error) {
+        return false;
+    }
+
+    thread_local std::vector<char> lhsBuffer(READ_BUFFER_SIZE);
+    thread_local std::vector<char> rhsBuffer(READ_BUFFER_SIZE);
+    std::ifstream lhsFile(lhs, std::ios::binary);
+    std::ifstream rhsFile(rhs, std::ios::binary);
+    if (!lhsFile || !rhsFile) {
+        return false;
+    }
+
+    std::uintmax_t remaining = size;
+    while (remaining > 0) {
+        const std::size_t chunk =
+            static_cast<std::size_t>(std::min<std::uintmax_t>(remaining, READ_BUFFER_SIZE));
+        lhsFile.read(lhsBuffer.data(), static_cast<std::streamsize>(chunk));
+        rhsFile.read(rhsBuffer.data(), static_cast<std::streamsize>(chunk));
+        if (static_cast<std::size_t>(lhsFile.gcount()) != chunk ||
+            static_cast<std::size_t>(rhsFile.gcount()) != chunk ||
+            !equalBytes(lhsBuffer.data(), rhsBuffer.data(), chunk)) {
+            return false;
+        }
+        remaining -= chunk;
+    }
+    // neither file grew since its size was read
+    return lhsFile.peek() == std::ifstream::traits_type::eof() &&
+           rhsFile.peek() == std::ifstream::traits_type::eof();
+}
+
+std::size_t selectKeeper(const std::vector<std::filesystem::path> &files) {
+    for (std::size_t file = 0; file < files.size(); file++) {
+        std::error_code error;
+        if (!std::filesystem::is_symlink(files[file], error) && !error) {
+            return file;
+        }
+    }
+    return 0;
+}
+
+Verification verifyDuplicates(const std::vector<DuplicateGroup> &groups, std::size_t threads) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // verified[group][candidate], every entry is written by exactly one task
+    std::vector<std::vector<bool>> verified(groups.size());
+    const auto verifyGroup = [&groups, &verified](std::size_t group) {
+        const std::filesystem::path &keeper = groups[group].keeper;
+        for (const std::filesystem::path &candidate : groups[group].candidates) {
+            // removing a file that shares its device and inode with the keeper removes the data
+            // of the keeper, or the target of a symlink keeper
+            std::error_code error;
+            const bool sameFile = candidate == keeper ||
+                                  std::filesystem::equivalent(keeper, candidate, error) || error;
+            verified[group].push_back(!sameFile && equalFiles(keeper, candidate));
+        }
+    };
+
+    std::unique_ptr<PARALLEL::WorkStealingPool> pool;
+    if (PARALLEL::resolveThreadsCount(threads) > 1 && groups.size() > 1) {
+        pool = std::make_unique<PARALLEL::WorkStealingPool>(threads);
+    }
+    for (std::size_t group = 0; group < groups.size(); group++) {
+        if (pool) {
+            pool->submit([&verifyGroup, group]() { verifyGroup(group); });
+        } else {
+            verifyGroup(group);
+        }
+    }
+    if (pool) {
+        pool->wait();
+    }
+
+    Verification verification;
+    for (std::size_t group = 0; group < groups.size(); group++) {
+        for (std::size_t candidate = 0; candidate < groups[group].candidates.size(); candidate++) {
+            const std::filesystem::path &path = groups[group].candidates[candidate];
+            if (verified[group][candidate]) {
+                verification.verified.push_back(path);
+                std::error_code error;
+                const std::uintmax_t size = std::filesystem::file_size(path, error);
+                verification.verifiedBytes += error ? 0 : size;
+            } else {
+                verification.rejected.push_back(path);
+            }
+        }
+    }
+    verification.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return verification;
+}
+} // namespace DDK::VERIFY
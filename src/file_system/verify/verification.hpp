@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace DDK::VERIFY {
+// Byte equality of two memory ranges. Compares 32 bytes at a time with AVX2 if the CPU supports
+// it, otherwise 16 bytes at a time with SSE2 or NEON.
+bool equalBytes(const char *lhs, const char *rhs, std::size_t size);
+// Streams both files through large buffers and compares them byte by byte. Files that can not be
+// read are never equal.
+bool equalFiles(const std::filesystem::path &lhs, const std::filesystem::path &rhs);
+
+struct DuplicateGroup {
+    // file that is kept
+    std::filesystem::path keeper;
+    // files that are about to be removed
+    std::vector<std::filesystem::path> candidates;
+};
+
+// Index of the file of a group that should be kept, the first file that is no symlink or the
+// first file if all of them are symlinks. A kept symlink would dangle once its target is removed.
+std::size_t selectKeeper(const std::vector<std::filesystem::path> &files);
+
+struct Verification {
+    // candidates with the same content as the keeper of their group
+    std::vector<std::filesystem::path> verified;
+    // candidates that differ from the keeper of their group, could not be read or are the same
+    // file as the keeper (the keeper itself, a symlink to it, its target or a hard link of it)
+    std::vector<std::filesystem::path> rejected;
+    // size of all verified candidates
+    std::uintmax_t verifiedBytes = 0;
+    double seconds = 0.0;
+};
+
+// Compares every candidate with the keeper of its group before anything is removed. threads > 1
+// (or 0 for all hardware threads) verifies the groups on a work-stealing thread pool, the order of
+// the results does not depend on the number of threads.
+Verification verifyDuplicates(const std::vector<DuplicateGroup> &groups, std::size_t threads = 1);
+} // namespace DDK::VERIFY
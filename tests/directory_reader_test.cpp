@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include "scan/directory_reader.hpp"
+#include "test_data.hpp"
+
+#include "gtest/gtest.h"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace DDK {
+namespace Test {
+
+class DirectoryReaderTest : public testing::TestWithParam<bool> {
+  protected:
+    DirectoryReaderTest() {
+        std::filesystem::create_directory(base_path);
+        Data::setupDirectory(base_path, 2, 3, 1);
+
+        std::ofstream outfile(base_path / file_name);
+        outfile << "Testing..." << std::endl;
+        outfile.close();
+
+        try {
+            std::filesystem::create_directory_symlink(base_path / "dir_0", base_path / "dir_link");
+            std::filesystem::create_symlink(base_path / file_name, base_path / "file_link");
+            std::filesystem::create_symlink(base_path / "missing", base_path / "broken_link");
+        } catch (const std::system_error &e) {
+            // Windows requires elevated privileges for symlinks
+            can_create_symlinks = false;
+        }
+
+#if !defined(_WIN32)
+        // entries that ddk does not analyze
+        mkfifo((base_path / "fifo").c_str(), 0600);
+#endif
+    }
+
+    ~DirectoryReaderTest() override { std::filesystem::remove_all(base_path); }
+
+    static void sortByName(std::vector<SCAN::DirectoryEntry> &entries) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const auto &lhs, const auto &rhs) { return lhs.name < rhs.name; });
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const std::string file_name = "Όταν λείπει η γάτα.txt";
+    const bool follow_symlinks = GetParam();
+    bool can_create_symlinks = true;
+};
+
+TEST_P(DirectoryReaderTest, ListsAnalyzableEntries) {
+    std::vector<SCAN::DirectoryEntry> entries;
+    SCAN::readDirectory(base_path, follow_symlinks, entries);
+    sortByName(entries);
+
+    std::vector<std::string> names;
+    for (const auto &entry : entries) {
+        names.push_back(entry.name);
+    }
+
+    std::vector<std::string> expected = {"dir_0",      "dir_1",      "file_0.txt",
+                                         "file_1.txt", "file_2.txt", file_name};
+    if (follow_symlinks && can_create_symlinks) {
+        expected.insert(expected.end(), {"broken_link", "dir_link", "file_link"});
+    }
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(names, expected);
+
+    for (const auto &entry : entries) {
+        if (entry.name == "broken_link") {
+            EXPECT_EQ(entry.type, std::filesystem::file_type::not_found);
+            EXPECT_TRUE(entry.symlink);
+        } else if (entry.name == "dir_link") {
+            EXPECT_EQ(entry.type, std::filesystem::file_type::directory);
+            EXPECT_TRUE(entry.symlink);
+        } else if (entry.name == "file_link") {
+            EXPECT_EQ(entry.type, std::filesystem::file_type::regular);
+            EXPECT_EQ(entry.size, std::filesystem::file_size(base_path / file_name));
+            EXPECT_TRUE(entry.symlink);
+        } else {
+            EXPECT_FALSE(entry.symlink);
+            EXPECT_EQ(entry.type, std::filesystem::status(base_path / entry.name).type());
+            if (entry.type == std::filesystem::file_type::regular) {
+                EXPECT_EQ(entry.size, std::filesystem::file_size(base_path / entry.name));
+            }
+        }
+    }
+}
+
+TEST_P(DirectoryReaderTest, IdenticalToPortableImplementation) {
+    std::vector<SCAN::DirectoryEntry> entries;
+    std::vector<SCAN::DirectoryEntry> portable_entries;
+    SCAN::readDirectory(base_path, follow_symlinks, entries);
+    SCAN::readDirectoryPortable(base_path, follow_symlinks, portable_entries);
+    sortByName(entries);
+    sortByName(portable_entries);
+
+    ASSERT_EQ(entries.size(), portable_entries.size());
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        EXPECT_EQ(entries.at(i).name, portable_entries.at(i).name);
+        EXPECT_EQ(entries.at(i).type, portable_entries.at(i).type);
+        EXPECT_EQ(entries.at(i).size, portable_entries.at(i).size);
+        EXPECT_EQ(entries.at(i).symlink, portable_entries.at(i).symlink);
+    }
+}
+
+TEST_P(DirectoryReaderTest, IoUringIdenticalToPortableImplementation) {
+    // without kernel support the IO_URING backend falls back to the default backend
+    std::vector<SCAN::DirectoryEntry> entries;
+    std::vector<SCAN::DirectoryEntry> portable_entries;
+    SCAN::readDirectory(base_path, follow_symlinks, entries, SCAN::Backend::IO_URING);
+    SCAN::readDirectory(base_path, follow_symlinks, portable_entries, SCAN::Backend::PORTABLE);
+    sortByName(entries);
+    sortByName(portable_entries);
+
+    ASSERT_EQ(entries.size(), portable_entries.size());
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        EXPECT_EQ(entries.at(i).name, portable_entries.at(i).name);
+        EXPECT_EQ(entries.at(i).type, portable_entries.at(i).type);
+        EXPECT_EQ(entries.at(i).size, portable_entries.at(i).size);
+        EXPECT_EQ(entries.at(i).symlink, portable_entries.at(i).symlink);
+
+        // subdirectories may be handed out already opened, listing them consumes the handle
+        if (entries.at(i).type == std::filesystem::file_type::directory) {
+            std::vector<SCAN::DirectoryEntry> children;
+            std::vector<SCAN::DirectoryEntry> portable_children;
+            SCAN::readDirectory(base_path / entries.at(i).name, follow_symlinks, children,
+                                SCAN::Backend::IO_URING, entries.at(i).directoryFd);
+            SCAN::readDirectory(base_path / entries.at(i).name, follow_symlinks,
+                                portable_children, SCAN::Backend::PORTABLE);
+            EXPECT_EQ(children.size(), portable_children.size());
+        }
+    }
+}
+
+TEST_P(DirectoryReaderTest, IdentifiesHardlinks) {
+    try {
+        std::filesystem::create_hard_link(base_path / file_name, base_path / "hardlink");
+    } catch (const std::system_error &e) {
+        GTEST_SKIP() << e.what();
+    }
+
+    for (const auto backend :
+         {SCAN::Backend::DEFAULT, SCAN::Backend::PORTABLE, SCAN::Backend::IO_URING}) {
+        std::vector<SCAN::DirectoryEntry> entries;
+        SCAN::readDirectory(base_path, follow_symlinks, entries, backend);
+        sortByName(entries);
+
+        SCAN::FileId hardlink_id{};
+        for (const auto &entry : entries) {
+            if (entry.name == "hardlink") {
+                hardlink_id = entry.fileId;
+            }
+        }
+#if !defined(_WIN32)
+        EXPECT_TRUE(hardlink_id.isHardlinked());
+#endif
+        EXPECT_EQ(hardlink_id, SCAN::getFileId(base_path / "hardlink"));
+
+        for (const auto &entry : entries) {
+            if (entry.name == file_name || entry.name == "hardlink" ||
+                (entry.name == "file_link" && follow_symlinks)) {
+                EXPECT_EQ(entry.fileId, hardlink_id) << entry.name;
+            } else {
+                EXPECT_FALSE(entry.fileId.isHardlinked()) << entry.name;
+            }
+            if (entry.directoryFd >= 0) {
+                std::vector<SCAN::DirectoryEntry> children;
+                SCAN::readDirectory(base_path / entry.name, follow_symlinks, children, backend,
+                                    entry.directoryFd);
+            }
+        }
+    }
+}
+
+TEST_P(DirectoryReaderTest, ThrowsForMissingDirectory) {
+    std::vector<SCAN::DirectoryEntry> entries;
+    EXPECT_THROW(SCAN::readDirectory(base_path / "missing", follow_symlinks, entries),
+                 std::filesystem::filesystem_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(DirectoryReaderTestWithParameter,
+                         DirectoryReaderTest,
+                         testing::Values(false, true) // follow symlinks
+);
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
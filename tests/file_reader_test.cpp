@@ -0,0 +1,130 @@
+#include "io/async_reader.hpp"
+#include "io/file_reader.hpp"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+
+namespace DDK {
+namespace Test {
+
+class FileReaderTest : public testing::TestWithParam<IO::ReadOptions> {
+  protected:
+    FileReaderTest() {
+        std::filesystem::create_directory(base_path);
+        // spans several buffers and ends within a block
+        for (std::size_t i = 0; i < 2 * IO::FileReader::BUFFER_SIZE + 1000; i++) {
+            content.push_back(static_cast<char>(i * 7 + i / 251));
+        }
+        std::ofstream outfile(base_path / "file.bin", std::ios::binary);
+        outfile << content;
+    }
+
+    ~FileReaderTest() override { std::filesystem::remove_all(base_path); }
+
+    std::string readRange(std::uintmax_t offset, std::uintmax_t length, bool &complete) {
+        IO::FileReader file(base_path / "file.bin", GetParam());
+        std::string result;
+        complete = file.read(offset, length, [&result](const char *data, std::size_t size) {
+            EXPECT_LE(size, IO::FileReader::BUFFER_SIZE);
+            result.append(data, size);
+        });
+        return result;
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    std::string content;
+};
+
+TEST_P(FileReaderTest, ReadsRanges) {
+    bool complete = false;
+    EXPECT_EQ(readRange(0, content.size(), complete), content);
+    EXPECT_TRUE(complete);
+
+    // offsets and lengths that are not aligned to blocks
+    for (const std::uintmax_t offset : {1, 4095, 4097, 1024 * 1024 - 3}) {
+        for (const std::uintmax_t length : {1, 100, 8191, 1024 * 1024 + 5}) {
+            EXPECT_EQ(readRange(offset, length, complete), content.substr(offset, length));
+            EXPECT_TRUE(complete);
+        }
+    }
+}
+
+TEST_P(FileReaderTest, StopsAtEndOfFile) {
+    bool complete = true;
+    EXPECT_EQ(readRange(content.size() - 10, 100, complete), content.substr(content.size() - 10));
+    EXPECT_FALSE(complete);
+    EXPECT_EQ(readRange(content.size() + 10, 100, complete), "");
+    EXPECT_FALSE(complete);
+}
+
+TEST_P(FileReaderTest, FailsForMissingFile) {
+    IO::FileReader file(base_path / "missing.bin", GetParam());
+    EXPECT_FALSE(file.isOpen());
+    EXPECT_FALSE(file.getSize());
+    EXPECT_FALSE(file.read(0, 1, [](const char *, std::size_t) { FAIL(); }));
+}
+
+TEST_P(FileReaderTest, ReportsCurrentSize) {
+    IO::FileReader file(base_path / "file.bin", GetParam());
+    EXPECT_EQ(file.getSize(), content.size());
+
+    std::ofstream(base_path / "file.bin", std::ios::binary | std::ios::app) << "grown";
+    EXPECT_EQ(file.getSize(), content.size() + 5);
+    bool complete = false;
+    EXPECT_EQ(readRange(content.size(), 5, complete), "grown");
+    EXPECT_TRUE(complete);
+}
+
+#if defined(DDK_HAS_IO_URING)
+TEST_P(FileReaderTest, ReadsAsynchronously) {
+    const std::unique_ptr<IO::AsyncReader> reader = IO::AsyncReader::create(2);
+    if (!reader) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    // more requests than reads in flight, including an empty range, a missing file and a file
+    // that no longer has the expected size
+    const std::filesystem::path path = base_path / "file.bin";
+    const std::filesystem::path missing = base_path / "missing.bin";
+    const std::vector<IO::ReadRequest> requests{
+        {&path, 0, content.size()},
+        {&path, 4097, 1024 * 1024 + 5},
+        {&missing, 0, 100},
+        {&path, 0, 0},
+        {&path, content.size() - 10, 100},
+        {&path, 1, 8191},
+        {&path, 0, 100, content.size()},
+        {&path, 0, 100, content.size() - 1},
+    };
+    std::vector<std::string> results(requests.size());
+    ASSERT_TRUE(reader->read(requests, GetParam(),
+                             [&results](std::size_t request, const char *data, std::size_t size) {
+                                 EXPECT_LE(size, IO::AsyncReader::CHUNK_SIZE);
+                                 results[request].append(data, size);
+                             }));
+
+    for (std::size_t request = 0; request < requests.size(); request++) {
+        const bool skipped = *requests[request].path == missing ||
+                             requests[request].fileSize.value_or(content.size()) != content.size();
+        const std::string expected =
+            skipped ? "" : content.substr(requests[request].offset, requests[request].length);
+        EXPECT_EQ(results[request], expected) << "request " << request;
+    }
+}
+#endif
+
+INSTANTIATE_TEST_SUITE_P(ReadOptions,
+                         FileReaderTest,
+                         testing::Values(IO::ReadOptions{false, false},
+                                         IO::ReadOptions{true, false},
+                                         IO::ReadOptions{false, true}));
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,332 @@
+#include "file_table.hpp"
+#include "filter/common.hpp"
+#include "filter/deduplication.hpp"
+#include "fsitem.hpp"
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace DDK {
+namespace Test {
+
+class FileTableTest : public testing::Test {
+  protected:
+    FileTableTest() {
+        // root/
+        //   a.txt (10 bytes)
+        //   dir/
+        //     b.txt (20 bytes)
+        //     link.txt -> b.txt
+        //   locked/
+        //   broken -> missing
+        table.addRoot(root_path, std::filesystem::file_type::directory, 0, false,
+                      FileSystemError::NO_ERROR, 0);
+        const std::vector<SCAN::DirectoryEntry> root_entries = {
+            {"a.txt", std::filesystem::file_type::regular, 10, false},
+            {"dir", std::filesystem::file_type::directory, 0, false},
+            {"locked", std::filesystem::file_type::directory, 0, false},
+            {"broken", std::filesystem::file_type::not_found, 0, true}};
+        const FileTable::Index first = table.addChildren(0, root_entries);
+        const std::vector<SCAN::DirectoryEntry> dir_entries = {
+            {"b.txt", std::filesystem::file_type::regular, 20, false},
+            {"link.txt", std::filesystem::file_type::regular, 20, true}};
+        table.addChildren(first + 1, dir_entries);
+        table.setError(first + 2, FileSystemError::ACCESS_DENIED);
+        table.finalize(nullptr, nullptr);
+    }
+
+    const std::filesystem::path root_path = std::filesystem::path("root");
+    FileTable table;
+};
+
+TEST_F(FileTableTest, StoresChildrenAsContiguousBlocks) {
+    ASSERT_EQ(table.size(), 7);
+    EXPECT_EQ(table.getParent(0), FileTable::NO_INDEX);
+    for (FileTable::Index index = 1; index <= 4; index++) {
+        EXPECT_EQ(table.getParent(index), 0);
+        EXPECT_EQ(table.getDepth(index), 1);
+    }
+    EXPECT_EQ(table.getParent(5), 2);
+    EXPECT_EQ(table.getParent(6), 2);
+    EXPECT_EQ(table.getDepth(6), 2);
+
+    EXPECT_EQ(table.getPath(0), root_path);
+    EXPECT_EQ(table.getPath(1), root_path / "a.txt");
+    EXPECT_EQ(table.getPath(6), root_path / "dir" / "link.txt");
+}
+
+TEST_F(FileTableTest, StoresNamesOnly) {
+    EXPECT_EQ(std::filesystem::path(table.getName(0)), root_path.filename());
+    EXPECT_EQ(std::filesystem::path(table.getName(2)), "dir");
+    EXPECT_EQ(std::filesystem::path(table.getName(6)), "link.txt");
+}
+
+TEST_F(FileTableTest, ComparesPathsLikeStdFilesystem) {
+    const auto sign = [](int value) { return value < 0 ? -1 : (value > 0 ? 1 : 0); };
+
+    // overlapping tree with a root inside of the first tree
+    FileTable other;
+    other.addRoot(root_path / "dir", std::filesystem::file_type::directory, 0, false,
+                  FileSystemError::NO_ERROR, 0);
+    other.addChildren(0, {{"b.txt", std::filesystem::file_type::regular, 20, false},
+                          {"c.txt", std::filesystem::file_type::regular, 20, false}});
+    other.finalize(nullptr, nullptr);
+
+    for (FileTable::Index lhs = 0; lhs < table.size(); lhs++) {
+        for (FileTable::Index rhs = 0; rhs < table.size(); rhs++) {
+            EXPECT_EQ(table.comparePaths(lhs, table, rhs),
+                      sign(table.getPath(lhs).compare(table.getPath(rhs))))
+                << table.getPath(lhs) << " " << table.getPath(rhs);
+        }
+        for (FileTable::Index rhs = 0; rhs < other.size(); rhs++) {
+            EXPECT_EQ(table.comparePaths(lhs, other, rhs),
+                      sign(table.getPath(lhs).compare(other.getPath(rhs))))
+                << table.getPath(lhs) << " " << other.getPath(rhs);
+            EXPECT_EQ(other.comparePaths(rhs, table, lhs),
+                      sign(other.getPath(rhs).compare(table.getPath(lhs))))
+                << other.getPath(rhs) << " " << table.getPath(lhs);
+        }
+    }
+}
+
+TEST_F(FileTableTest, DropsDirectoriesThatCouldNotBeListed) {
+    // "locked" is skipped
+    EXPECT_EQ(table.getChildren(0).size(), 3);
+    EXPECT_EQ(table.getChildren(2).size(), 2);
+    EXPECT_TRUE(table.getChildren(1).empty());
+    EXPECT_EQ(table.getError(3), FileSystemError::ACCESS_DENIED);
+    EXPECT_EQ(table.getError(4), FileSystemError::PATH_DOES_NOT_EXIST);
+}
+
+TEST_F(FileTableTest, WalksTreesInPlace) {
+    std::vector<FileSystemItem *> children;
+    for (FileSystemItem *const child : table.getChildRange(0)) {
+        children.push_back(child);
+    }
+    EXPECT_EQ(children, table.getChildren(0));
+    EXPECT_TRUE(table.getChildRange(1).empty());
+
+    // depth first, "locked" is skipped
+    std::vector<FileTable::Index> order;
+    for (FileTable::Index index = 0; index != FileTable::NO_INDEX;
+         index = table.getNextInTree(0, index)) {
+        order.push_back(index);
+    }
+    EXPECT_EQ(order, (std::vector<FileTable::Index>{0, 1, 2, 5, 6, 4}));
+    EXPECT_EQ(table.getNextInTree(2, 2), 5);
+    EXPECT_EQ(table.getNextInTree(2, 6), FileTable::NO_INDEX);
+    EXPECT_EQ(table.getNextInTree(1, 1), FileTable::NO_INDEX);
+}
+
+TEST_F(FileTableTest, AccumulatesDirectories) {
+    EXPECT_EQ(table.getSize(0), 50);
+    EXPECT_EQ(table.getSize(2), 40);
+    EXPECT_EQ(table.getChildFilesCount(0), 3);
+    EXPECT_EQ(table.getChildFilesCount(2), 2);
+    EXPECT_EQ(table.getChildSubDirectoriesCount(0), 1);
+    EXPECT_EQ(table.getChildSubDirectoriesCount(2), 0);
+    EXPECT_EQ(table.getChildSymlinksCount(0), 2);
+    EXPECT_EQ(table.getChildSymlinksCount(2), 1);
+    EXPECT_EQ(table.getChildSymlinksCount(6), 1);
+    EXPECT_EQ(table.getChildSymlinksCount(5), 0);
+}
+
+TEST_F(FileTableTest, StoresHashes) {
+    EXPECT_EQ(table.getHash(5), 0);
+    table.setHash(5, 42);
+    EXPECT_EQ(table.getHash(5), 42);
+    EXPECT_EQ(table.getHash(6), 0);
+}
+
+TEST_F(FileTableTest, TagsOriginsOfSubtrees) {
+    EXPECT_EQ(table.find(root_path), 0);
+    EXPECT_EQ(table.find(root_path / "dir" / "link.txt"), 6);
+    EXPECT_EQ(table.find(root_path / "dir" / ""), 2);
+    EXPECT_EQ(table.find(root_path / "locked"), FileTable::NO_INDEX);
+    EXPECT_EQ(table.find(root_path / "a.txt" / "b.txt"), FileTable::NO_INDEX);
+    EXPECT_EQ(table.find("other"), FileTable::NO_INDEX);
+
+    table.setOrigins(0, 0x01);
+    table.setOrigins(table.find(root_path / "dir"), 0x03);
+    const std::vector<FileTable::Origins> origins = {0x01, 0x01, 0x03, 0x01, 0x01, 0x03, 0x03};
+    for (FileTable::Index index = 0; index < table.size(); index++) {
+        EXPECT_EQ(table.getOrigins(index), origins[index]) << table.getPath(index);
+    }
+}
+
+TEST_F(FileTableTest, ReportsMemoryUsage) {
+    const std::size_t columns_size =
+        sizeof(std::uintmax_t) + sizeof(std::uint64_t) + sizeof(FileTable::Index);
+    EXPECT_GE(table.getMemoryUsage(), table.size() * columns_size);
+}
+
+// Table of count files in 100 directories with random sizes, hashes and names, many names share
+// a prefix longer than the sort keys.
+class SortTable {
+  public:
+    SortTable(const std::filesystem::path &root, std::size_t count, std::uint32_t seed) {
+        std::mt19937_64 random(seed);
+        table.addRoot(root, std::filesystem::file_type::directory, 0, false,
+                      FileSystemError::NO_ERROR, 0);
+        std::vector<SCAN::DirectoryEntry> directories;
+        for (std::size_t i = 0; i < 100; i++) {
+            directories.push_back(
+                {"dir_" + std::to_string(i), std::filesystem::file_type::directory, 0, false});
+        }
+        const FileTable::Index first = table.addChildren(0, directories);
+        for (FileTable::Index directory = first; directory < first + 100; directory++) {
+            std::vector<SCAN::DirectoryEntry> files;
+            for (std::size_t i = 0; i < count / 100; i++) {
+                const std::string prefix = random() % 2 == 0 ? "a_long_shared_file_name_" : "";
+                files.push_back({prefix + std::to_string(random() % 1000000) + "_" +
+                                     std::to_string(i),
+                                 std::filesystem::file_type::regular, random() % 1000, false});
+            }
+            table.addChildren(directory, files);
+        }
+        table.finalize(nullptr, nullptr);
+
+        for (FileTable::Index index = first + 100; index < table.size(); index++) {
+            items.push_back(table.getItem(index));
+            items.back()->setHash(HASH::Hash(random() % 1000, random()));
+        }
+    }
+
+    FileTable table;
+    std::vector<FileSystemItem *> items;
+};
+
+TEST(FileTableSortTest, SortsLikeComparators) {
+    const SortTable table(std::filesystem::path("root") / "a", 150000, 1);
+    const SortTable other(std::filesystem::path("root") / "b", 1000, 2);
+    std::vector<FileSystemItem *> all = table.items;
+    all.insert(all.end(), other.items.begin(), other.items.end());
+
+    // equal keys may be ordered differently
+    std::vector<FileSystemItem *> expected = table.items;
+    std::sort(expected.begin(), expected.end(), [](const auto lhs, const auto rhs) {
+        return lhs->getSizeInBytes() > rhs->getSizeInBytes();
+    });
+    std::vector<std::uintmax_t> expectedSizes;
+    for (const FileSystemItem *const item : expected) {
+        expectedSizes.push_back(item->getSizeInBytes());
+    }
+    std::sort(expected.begin(), expected.end(),
+              [](const auto lhs, const auto rhs) { return lhs->getHash() > rhs->getHash(); });
+    std::vector<HASH::Hash> expectedHashes;
+    for (const FileSystemItem *const item : expected) {
+        expectedHashes.push_back(item->getHash());
+    }
+    std::vector<FileSystemItem *> expectedPaths = all;
+    std::sort(expectedPaths.begin(), expectedPaths.end(),
+              [](const auto lhs, const auto rhs) { return lhs->comparePath(*rhs) > 0; });
+
+    for (const std::size_t threads : {1, 4}) {
+        std::vector<FileSystemItem *> items = table.items;
+        FILTER::COMMON::sortFSitemsBySize(items, threads);
+        std::vector<std::uintmax_t> sizes;
+        for (const FileSystemItem *const item : items) {
+            sizes.push_back(item->getSizeInBytes());
+        }
+        EXPECT_EQ(sizes, expectedSizes);
+
+        FILTER::COMMON::sortFSitemsByHash(items, threads);
+        std::vector<HASH::Hash> hashes;
+        for (const FileSystemItem *const item : items) {
+            hashes.push_back(item->getHash());
+        }
+        EXPECT_EQ(hashes, expectedHashes);
+
+        items = all;
+        FILTER::COMMON::sortFSitemsByPathLexicographically(items, threads);
+        EXPECT_EQ(items, expectedPaths);
+    }
+}
+
+// Sort times per million items compared to std::sort with the comparators used before. Run with
+// --gtest_also_run_disabled_tests.
+TEST(FileTableSortTest, DISABLED_SortsMillionsOfItems) {
+    const SortTable table("root", 1000000, 1);
+    const auto measure = [&table](const std::string &name, const auto &sort) {
+        std::vector<FileSystemItem *> items = table.items;
+        const auto start = std::chrono::steady_clock::now();
+        sort(items);
+        const std::chrono::duration<double, std::milli> duration =
+            std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << duration.count() << " ms per million items" << std::endl;
+    };
+
+    measure("std::sort by size", [](std::vector<FileSystemItem *> &items) {
+        std::sort(items.begin(), items.end(), [](const auto lhs, const auto rhs) {
+            return lhs->getSizeInBytes() > rhs->getSizeInBytes();
+        });
+    });
+    measure("std::sort by hash", [](std::vector<FileSystemItem *> &items) {
+        std::sort(items.begin(), items.end(),
+                  [](const auto lhs, const auto rhs) { return lhs->getHash() > rhs->getHash(); });
+    });
+    measure("std::sort by path", [](std::vector<FileSystemItem *> &items) {
+        std::sort(items.begin(), items.end(),
+                  [](const auto lhs, const auto rhs) { return lhs->comparePath(*rhs) > 0; });
+    });
+    for (const std::size_t threads : {1, 0}) {
+        const std::string suffix = threads == 1 ? ", 1 thread" : ", all threads";
+        measure("radix sort by size" + suffix, [threads](std::vector<FileSystemItem *> &items) {
+            FILTER::COMMON::sortFSitemsBySize(items, threads);
+        });
+        measure("radix sort by hash" + suffix, [threads](std::vector<FileSystemItem *> &items) {
+            FILTER::COMMON::sortFSitemsByHash(items, threads);
+        });
+        measure("radix sort by path" + suffix, [threads](std::vector<FileSystemItem *> &items) {
+            FILTER::COMMON::sortFSitemsByPathLexicographically(items, threads);
+        });
+    }
+}
+
+// Scaling benchmark of the elimination of files with unique sizes, the common case of a duplicate
+// search. Run with --gtest_also_run_disabled_tests, the largest table takes about 1 GiB.
+TEST(DeduplicationScalingTest, DISABLED_RemovesUniqueSizesInLinearTime) {
+    for (const std::size_t count : {100000, 1000000, 10000000}) {
+        FileTable table;
+        table.addRoot("root", std::filesystem::file_type::directory, 0, false,
+                      FileSystemError::NO_ERROR, 0);
+        std::vector<SCAN::DirectoryEntry> entries;
+        entries.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            // sizes do not follow the listing order
+            const std::uintmax_t size = (i * 7919) % count + 1;
+            entries.push_back(
+                {std::to_string(i), std::filesystem::file_type::regular, size, false});
+        }
+        table.addChildren(0, entries);
+        entries = {};
+        table.finalize(nullptr, nullptr);
+
+        std::vector<FileSystemItem *> items;
+        items.reserve(count);
+        for (FileTable::Index index = 1; index <= count; index++) {
+            items.push_back(table.getItem(index));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<std::size_t> ranges =
+            FILTER::DEDUPLICATION::extractDuplicatesAndGetRanges(items);
+        const std::chrono::duration<double, std::milli> duration =
+            std::chrono::steady_clock::now() - start;
+        EXPECT_TRUE(items.empty());
+        EXPECT_TRUE(ranges.empty());
+        std::cout << count << " items: " << duration.count() << " ms" << std::endl;
+    }
+}
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,8 +1,13 @@
+#include "filter/deduplication.hpp"
 #include "fsinfo.hpp"
 #include "test_data.hpp"
+#include "verify/verification.hpp"
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <map>
+
 namespace DDK {
 namespace Test {
 
@@ -81,6 +86,20 @@ TEST_P(FSInfoTestFileSystemStructures, CorrectInitialized) {
     }
 }
 
+TEST_P(FSInfoTestFileSystemStructures, VisitsEveryItemOnce) {
+    std::vector<FileSystemItem *> visited;
+    fsinfo->forEachItem([&visited](FileSystemItem *const item) {
+        // parents are visited before their children
+        EXPECT_TRUE(item->getParent() == nullptr ||
+                    std::find(visited.begin(), visited.end(), item->getParent()) != visited.end());
+        visited.push_back(item);
+    });
+    auto items = fsinfo->getAllFileSystemItems();
+    std::sort(visited.begin(), visited.end());
+    std::sort(items.begin(), items.end());
+    EXPECT_EQ(visited, items);
+}
+
 TEST_P(FSInfoTestFileSystemStructures, CompareToSingleDuplicateFileInDirectory) {
     Data::setupDirectory(base_path_compare, 0, 1, 1);
     FileSystemInfo fsinfo_compare(base_path_compare, false);
@@ -287,6 +306,471 @@ INSTANTIATE_TEST_SUITE_P(
                      testing::Values(0, 1, 5)  // compare directory: files_per_directory
                      ));
 
+class FSInfoTestParallelScan : public testing::TestWithParam<std::size_t> {
+  protected:
+    FSInfoTestParallelScan() {
+        std::filesystem::create_directory(base_path);
+        Data::setupDirectory(base_path, directories_per_depth, files_per_directory,
+                             recursion_depth);
+    }
+
+    ~FSInfoTestParallelScan() override { std::filesystem::remove_all(base_path); }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const std::size_t recursion_depth = 3;
+    const std::size_t directories_per_depth = 4;
+    const std::size_t files_per_directory = 3;
+    const std::size_t threads = GetParam();
+};
+
+TEST_P(FSInfoTestParallelScan, IdenticalToSequentialScan) {
+    const FileSystemInfo sequential(base_path, false, 1);
+    const FileSystemInfo parallel(base_path, false, threads);
+
+    EXPECT_EQ(parallel.getRootPath(), sequential.getRootPath());
+    EXPECT_EQ(parallel.getTotalSize(), sequential.getTotalSize());
+    EXPECT_EQ(parallel.getFilesCount(), sequential.getFilesCount());
+    EXPECT_EQ(parallel.getDirectoriesCount(), sequential.getDirectoriesCount());
+    EXPECT_EQ(parallel.getSymlinksCount(), sequential.getSymlinksCount());
+    EXPECT_EQ(parallel.getCurrentDirItems().size(), sequential.getCurrentDirItems().size());
+    EXPECT_EQ(parallel.getAllFileSystemItems().size(), sequential.getAllFileSystemItems().size());
+    EXPECT_EQ(std::get<0>(parallel.getDuplicates()).size(),
+              std::get<0>(sequential.getDuplicates()).size());
+    EXPECT_EQ(std::get<1>(parallel.getDuplicates()), std::get<1>(sequential.getDuplicates()));
+}
+
+TEST_P(FSInfoTestParallelScan, IdenticalToSequentialHashing) {
+    // many size groups of different content, some larger than the hashed blocks
+    for (std::size_t i = 0; i < 200; i++) {
+        std::ofstream outfile(base_path / ("hashed_" + std::to_string(i) + ".txt"));
+        outfile << std::string((i % 13 + 1) * 1000, static_cast<char>('a' + i % 5));
+    }
+    FILTER::DEDUPLICATION::HashStages stages;
+    stages.headBytes = 4096;
+    stages.tailBytes = 4096;
+    stages.singleReadThreshold = 0;
+    FileSystemInfo sequential(base_path, false, 1);
+    FileSystemInfo parallel(base_path, false, threads);
+    sequential.setHashStages(stages);
+    parallel.setHashStages(stages);
+
+    const auto [items, ranges] = sequential.getDuplicates();
+    const auto [parallel_items, parallel_ranges] = parallel.getDuplicates();
+    ASSERT_EQ(parallel_ranges, ranges);
+    const auto getHashesAndPaths = [](const std::vector<FileSystemItem *> &items) {
+        std::vector<std::pair<HASH::Hash, std::filesystem::path>> result;
+        for (const FileSystemItem *const item : items) {
+            result.emplace_back(item->getHash(), item->getPath());
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+    EXPECT_EQ(getHashesAndPaths(parallel_items), getHashesAndPaths(items));
+
+    const auto statistics = sequential.getHashStatistics();
+    const auto parallel_statistics = parallel.getHashStatistics();
+    EXPECT_EQ(parallel_statistics.hashedFiles, statistics.hashedFiles);
+    EXPECT_EQ(parallel_statistics.hashedBytes, statistics.hashedBytes);
+    EXPECT_EQ(parallel_statistics.savedBytes, statistics.savedBytes);
+}
+
+INSTANTIATE_TEST_SUITE_P(FSInfoTestParallelScanWithParameter,
+                         FSInfoTestParallelScan,
+                         testing::Values(0, 2, 4, 16) // threads
+);
+
+class FSInfoTestHardlinks : public testing::Test {
+  protected:
+    FSInfoTestHardlinks() {
+        // a.txt, b.txt (link of a.txt) and c.txt share their content
+        // d.txt and dir/e.txt are links of a file with unique content
+        std::filesystem::create_directory(base_path);
+        std::filesystem::create_directory(base_path / "dir");
+        writeFile(base_path / "a.txt", "duplicate content");
+        writeFile(base_path / "c.txt", "duplicate content");
+        writeFile(base_path / "d.txt", "unique content");
+        try {
+            std::filesystem::create_hard_link(base_path / "a.txt", base_path / "b.txt");
+            std::filesystem::create_hard_link(base_path / "d.txt", base_path / "dir" / "e.txt");
+        } catch (const std::system_error &e) {
+            system_error = e.what();
+        }
+    }
+
+    ~FSInfoTestHardlinks() override { std::filesystem::remove_all(base_path); }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path);
+        outfile << content << std::endl;
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    std::string system_error;
+};
+
+TEST_F(FSInfoTestHardlinks, ReportsLinksOfOneFileSeparately) {
+    if (!system_error.empty()) {
+        GTEST_SKIP() << system_error;
+    }
+
+    const FileSystemInfo fsinfo(base_path, false);
+
+    const auto [duplicates, duplicate_ranges] = fsinfo.getDuplicates();
+    ASSERT_EQ(duplicate_ranges, std::vector<std::size_t>{3});
+    EXPECT_EQ(FILTER::DEDUPLICATION::countDistinctFiles(duplicates), 2);
+
+    const auto [hardlinks, hardlink_ranges] = fsinfo.getHardlinks();
+    ASSERT_EQ(hardlink_ranges, (std::vector<std::size_t>{2, 2}));
+    for (std::size_t i = 0; i < hardlinks.size(); i += 2) {
+        EXPECT_EQ(hardlinks.at(i)->getFileId(), hardlinks.at(i + 1)->getFileId());
+        EXPECT_NE(hardlinks.at(i)->getPath(), hardlinks.at(i + 1)->getPath());
+    }
+}
+
+TEST_F(FSInfoTestHardlinks, LinksOfOneFileAreNoDuplicates) {
+    if (!system_error.empty()) {
+        GTEST_SKIP() << system_error;
+    }
+    std::filesystem::remove(base_path / "c.txt");
+
+    const FileSystemInfo fsinfo(base_path, false);
+    EXPECT_TRUE(std::get<1>(fsinfo.getDuplicates()).empty());
+    EXPECT_EQ(std::get<1>(fsinfo.getHardlinks()).size(), 2);
+}
+
+class FSInfoTestHashStages : public testing::Test {
+  protected:
+    FSInfoTestHashStages() {
+        // files of equal size that differ in a single block
+        std::filesystem::create_directory(base_path);
+        writeFile(base_path / "original.txt", "0123456789abcdef");
+        writeFile(base_path / "copy.txt", "0123456789abcdef");
+        writeFile(base_path / "head.txt", "X123456789abcdef");
+        writeFile(base_path / "middle.txt", "01234567X9abcdef");
+        writeFile(base_path / "tail.txt", "0123456789abcdeX");
+        // fit into the head block
+        writeFile(base_path / "small_0.txt", "abc");
+        writeFile(base_path / "small_1.txt", "abc");
+
+        stages.headBytes = 4;
+        stages.tailBytes = 4;
+        stages.singleReadThreshold = 0;
+    }
+
+    ~FSInfoTestHashStages() override { std::filesystem::remove_all(base_path); }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path);
+        outfile << content;
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    FILTER::DEDUPLICATION::HashStages stages;
+};
+
+TEST_F(FSInfoTestHashStages, FindsFilesDifferingInAnyBlock) {
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+
+    const auto [items, ranges] = fsinfo.getDuplicates();
+    ASSERT_EQ(ranges, (std::vector<std::size_t>{2, 2}));
+    std::vector<std::string> names;
+    for (const FileSystemItem *const item : items) {
+        names.push_back(item->getItemName());
+        // the final hash always covers the whole content
+        EXPECT_EQ(item->getHash(), FILTER::DEDUPLICATION::hashMappedMemory(item->getPath()));
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names,
+              (std::vector<std::string>{"copy.txt", "original.txt", "small_0.txt", "small_1.txt"}));
+
+    // same result with the default block size
+    const FileSystemInfo defaults(base_path, false);
+    EXPECT_EQ(std::get<1>(defaults.getDuplicates()), ranges);
+}
+
+TEST_F(FSInfoTestHashStages, HashesIndependentlyOfReadMode) {
+    for (const std::uintmax_t mappedReadThreshold : {std::uintmax_t{0}, UINTMAX_MAX}) {
+        for (const bool directIo : {false, true}) {
+            // without io_uring every file is read on its own
+            for (const unsigned int ioUringQueueDepth : {0, 1, 3}) {
+                stages.mappedReadThreshold = mappedReadThreshold;
+                stages.readOptions = {directIo, directIo};
+                stages.ioUringQueueDepth = ioUringQueueDepth;
+                FileSystemInfo fsinfo(base_path, false);
+                fsinfo.setHashStages(stages);
+
+                const auto [items, ranges] = fsinfo.getDuplicates();
+                EXPECT_EQ(ranges, (std::vector<std::size_t>{2, 2}));
+                for (const FileSystemItem *const item : items) {
+                    EXPECT_EQ(item->getHash(),
+                              FILTER::DEDUPLICATION::hashMappedMemory(item->getPath()));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(FSInfoTestHashStages, HashesSmallFilesWithSingleRead) {
+    stages.singleReadThreshold = 16;
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+
+    const auto [items, ranges] = fsinfo.getDuplicates();
+    EXPECT_EQ(ranges, (std::vector<std::size_t>{2, 2}));
+    for (const FileSystemItem *const item : items) {
+        EXPECT_EQ(item->getHash(), FILTER::DEDUPLICATION::hashMappedMemory(item->getPath()));
+    }
+
+    // the content of every file was read by the head stage
+    const FILTER::DEDUPLICATION::HashStatistics statistics = fsinfo.getHashStatistics();
+    EXPECT_EQ(statistics.hashedFiles[0], 7);
+    EXPECT_EQ(statistics.hashedBytes[0], 5 * 16 + 2 * 3);
+    EXPECT_EQ(statistics.hashedFiles[1], 0);
+    EXPECT_EQ(statistics.hashedFiles[2], 0);
+    EXPECT_EQ(statistics.savedBytes[0], 0);
+}
+
+TEST_F(FSInfoTestHashStages, CountsReadAndSkippedData) {
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+    fsinfo.getDuplicates();
+
+    const FILTER::DEDUPLICATION::HashStatistics statistics = fsinfo.getHashStatistics();
+    // five head blocks and two small files
+    EXPECT_EQ(statistics.hashedFiles[0], 7);
+    EXPECT_EQ(statistics.hashedBytes[0], 5 * 4 + 2 * 3);
+    // head.txt is told apart after its head block
+    EXPECT_EQ(statistics.savedBytes[0], 16 - 4);
+    EXPECT_EQ(statistics.hashedFiles[1], 4);
+    EXPECT_EQ(statistics.hashedBytes[1], 4 * 4);
+    // tail.txt is told apart after its head and tail blocks
+    EXPECT_EQ(statistics.savedBytes[1], 16 - 8);
+    // middle.txt is only told apart by its content
+    EXPECT_EQ(statistics.hashedFiles[2], 3);
+    EXPECT_EQ(statistics.hashedBytes[2], 3 * 16);
+    EXPECT_EQ(statistics.savedBytes[2], 0);
+}
+
+TEST_F(FSInfoTestHashStages, NeverGroupsFilesThatCanNotBeRead) {
+    for (const std::size_t threads : {1, 4}) {
+        for (const std::uintmax_t mappedReadThreshold : {std::uintmax_t{0}, UINTMAX_MAX}) {
+            for (const unsigned int ioUringQueueDepth : {0, 3}) {
+                stages.mappedReadThreshold = mappedReadThreshold;
+                stages.ioUringQueueDepth = ioUringQueueDepth;
+                writeFile(base_path / "original.txt", "0123456789abcdef");
+                writeFile(base_path / "copy.txt", "0123456789abcdef");
+                FileSystemInfo fsinfo(base_path, false, threads);
+                fsinfo.setHashStages(stages);
+
+                // removed after the scan, every file of their size fails to open
+                for (const char *const name :
+                     {"original.txt", "copy.txt", "head.txt", "middle.txt", "tail.txt"}) {
+                    std::filesystem::remove(base_path / name);
+                }
+                const auto [items, ranges] = fsinfo.getDuplicates();
+                ASSERT_EQ(ranges, (std::vector<std::size_t>{2}));
+                EXPECT_EQ(items[0]->getSizeInBytes(), 3);
+                EXPECT_EQ(fsinfo.getHashStatistics().savedBytes[0], 5 * (16 - 4));
+
+                writeFile(base_path / "head.txt", "X123456789abcdef");
+                writeFile(base_path / "middle.txt", "01234567X9abcdef");
+                writeFile(base_path / "tail.txt", "0123456789abcdeX");
+            }
+        }
+    }
+}
+
+TEST_F(FSInfoTestHashStages, HashesOnlyFilesMatchingTheComparedPath) {
+    const std::filesystem::path compare_path =
+        std::filesystem::current_path() / "ddk_test_data_compare";
+    std::filesystem::create_directory(compare_path);
+    writeFile(compare_path / "incoming.txt", "0123456789abcdef");
+    writeFile(compare_path / "unmatched.txt", "unmatched");
+    const FileSystemInfo compare(compare_path, false);
+
+    for (const auto engine :
+         {FILTER::DEDUPLICATION::Engine::HASH, FILTER::DEDUPLICATION::Engine::LOCKSTEP}) {
+        FileSystemInfo fsinfo(base_path, false);
+        fsinfo.setHashStages(stages);
+        fsinfo.setEngine(engine);
+
+        const auto duplicates = fsinfo.getDuplicatesFromCompare(&compare);
+        ASSERT_EQ(duplicates.size(), 1);
+        std::vector<std::string> names;
+        for (const FileSystemItem *const item : duplicates.front()) {
+            names.push_back(item->getItemName());
+        }
+        std::sort(names.begin(), names.end());
+        EXPECT_EQ(names, (std::vector<std::string>{"copy.txt", "incoming.txt", "original.txt"}));
+        if (engine == FILTER::DEDUPLICATION::Engine::HASH) {
+            // the small files only share their size among each other
+            const auto statistics = fsinfo.getHashStatistics();
+            EXPECT_EQ(statistics.hashedFiles, (std::array<std::size_t, 3>{6, 5, 4}));
+        }
+    }
+    std::filesystem::remove_all(compare_path);
+}
+
+TEST_F(FSInfoTestHashStages, ComparesWithSeveralPaths) {
+    // the second compared path lies within the path, the third one has no duplicates
+    const std::filesystem::path compare_path =
+        std::filesystem::current_path() / "ddk_test_data_compare";
+    std::filesystem::create_directories(compare_path / "first");
+    std::filesystem::create_directory(base_path / "second");
+    std::filesystem::create_directory(compare_path / "third");
+    writeFile(compare_path / "first" / "original.txt", "0123456789abcdef");
+    writeFile(base_path / "second" / "original.txt", "0123456789abcdef");
+    writeFile(base_path / "second" / "small.txt", "abc");
+    writeFile(compare_path / "third" / "other.txt", "other");
+    const FileSystemInfo first(compare_path / "first", false);
+    const FileSystemInfo second(base_path / "second", false);
+    const FileSystemInfo third(compare_path / "third", false);
+
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+    const auto duplicates = fsinfo.getDuplicatesFromCompare({&first, &second, &third});
+    ASSERT_EQ(duplicates.size(), 2);
+    std::map<std::string, FileTable::Origins> origins;
+    for (const auto &duplicate : duplicates) {
+        for (const FileSystemItem *const item : duplicate) {
+            const auto relative = item->getPath().lexically_relative(base_path.parent_path());
+            origins[relative.generic_string()] = item->getOrigins();
+        }
+    }
+    const FileTable::Origins path = FileSystemInfo::PATH_ORIGIN;
+    EXPECT_EQ(origins, (std::map<std::string, FileTable::Origins>{
+                           {"ddk_test_data/copy.txt", path},
+                           {"ddk_test_data/original.txt", path},
+                           {"ddk_test_data/second/original.txt",
+                            path | FileSystemInfo::getCompareOrigin(1)},
+                           {"ddk_test_data/second/small.txt",
+                            path | FileSystemInfo::getCompareOrigin(1)},
+                           {"ddk_test_data/small_0.txt", path},
+                           {"ddk_test_data/small_1.txt", path},
+                           {"ddk_test_data_compare/first/original.txt",
+                            FileSystemInfo::getCompareOrigin(0)}}));
+    // every file is hashed once for all compared paths
+    EXPECT_EQ(fsinfo.getHashStatistics().hashedFiles[0], 10);
+
+    const std::vector<const FileSystemInfo *> compares(FileSystemInfo::MAX_COMPARES + 1, &third);
+    EXPECT_THROW(fsinfo.getDuplicatesFromCompare(compares), std::length_error);
+    std::filesystem::remove_all(compare_path);
+}
+
+TEST_F(FSInfoTestHashStages, ComparesInLockstep) {
+    // larger than a single chunk, differs in the second one
+    std::string content(FILTER::DEDUPLICATION::LOCKSTEP_CHUNK_SIZE + 100, 'a');
+    writeFile(base_path / "large_0.txt", content);
+    writeFile(base_path / "large_1.txt", content);
+    content[FILTER::DEDUPLICATION::LOCKSTEP_CHUNK_SIZE + 50] = 'b';
+    writeFile(base_path / "large_2.txt", content);
+    writeFile(base_path / "large_3.txt", content);
+
+    for (const std::size_t threads : {1, 4}) {
+        FileSystemInfo hashed(base_path, false, threads);
+        FileSystemInfo compared(base_path, false, threads);
+        compared.setEngine(FILTER::DEDUPLICATION::Engine::LOCKSTEP);
+
+        const auto [items, ranges] = compared.getDuplicates();
+        ASSERT_EQ(ranges, std::get<1>(hashed.getDuplicates()));
+        // larger files first
+        ASSERT_EQ(ranges, (std::vector<std::size_t>{2, 2, 2, 2}));
+        EXPECT_EQ(items.front()->getSizeInBytes(), content.size());
+        EXPECT_EQ(items.back()->getSizeInBytes(), 3);
+        std::vector<std::string> names;
+        for (std::size_t i = 0; i < items.size(); i += 2) {
+            std::vector<std::string> group{items.at(i)->getItemName(),
+                                           items.at(i + 1)->getItemName()};
+            std::sort(group.begin(), group.end());
+            names.push_back(group.front() + " " + group.back());
+        }
+        std::sort(names.begin(), names.end());
+        EXPECT_EQ(names,
+                  (std::vector<std::string>{"copy.txt original.txt", "large_0.txt large_1.txt",
+                                            "large_2.txt large_3.txt", "small_0.txt small_1.txt"}));
+        EXPECT_EQ(compared.getHashStatistics().hashedFiles[0], 0);
+    }
+}
+
+TEST_F(FSInfoTestHashStages, ComparesMoreFilesThanCanBeOpen) {
+    std::filesystem::remove_all(base_path);
+    std::filesystem::create_directory(base_path);
+    const std::size_t files = FILTER::DEDUPLICATION::MAX_LOCKSTEP_OPEN_FILES + 44;
+    std::string content(FILTER::DEDUPLICATION::LOCKSTEP_CHUNK_SIZE + 10, 'a');
+    for (std::size_t i = 0; i < files; i++) {
+        content[FILTER::DEDUPLICATION::LOCKSTEP_CHUNK_SIZE + 5] = static_cast<char>('a' + i % 3);
+        writeFile(base_path / ("file_" + std::to_string(i) + ".txt"), content);
+    }
+
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setEngine(FILTER::DEDUPLICATION::Engine::LOCKSTEP);
+    EXPECT_EQ(std::get<1>(fsinfo.getDuplicates()), (std::vector<std::size_t>(3, files / 3)));
+}
+
+TEST_F(FSInfoTestHashStages, ComparesLargeGroupsInBatches) {
+    std::filesystem::remove_all(base_path);
+    std::filesystem::create_directory(base_path);
+    // 64 threads leave 4 open files per thread, larger parts are compared in batches
+    std::string content(3 * FILTER::DEDUPLICATION::LOCKSTEP_CHUNK_SIZE, 'a');
+    for (std::size_t i = 0; i < 30; i++) {
+        std::string file = content;
+        // unique in the first chunk, or one of three contents in the last one
+        file[i % 5 == 0 ? i : file.size() - 1] = static_cast<char>('b' + (i % 5 == 0 ? 0 : i % 3));
+        writeFile(base_path / ("file_" + std::to_string(i) + ".txt"), file);
+    }
+
+    FileSystemInfo hashed(base_path, false);
+    FileSystemInfo compared(base_path, false, 64);
+    compared.setEngine(FILTER::DEDUPLICATION::Engine::LOCKSTEP);
+    const auto [items, ranges] = compared.getDuplicates();
+    EXPECT_EQ(ranges, (std::vector<std::size_t>{8, 8, 8}));
+    EXPECT_EQ(ranges, std::get<1>(hashed.getDuplicates()));
+    for (std::size_t i = 0; i < items.size(); i += 8) {
+        for (std::size_t j = i + 1; j < i + 8; j++) {
+            EXPECT_TRUE(VERIFY::equalFiles(items.at(i)->getPath(), items.at(j)->getPath()));
+        }
+    }
+}
+
+TEST_F(FSInfoTestHashStages, HashesLargeFilesInSegments) {
+    std::string content(10000, 'a');
+    writeFile(base_path / "large_0.txt", content);
+    writeFile(base_path / "large_1.txt", content);
+    content[5000] = 'b';
+    writeFile(base_path / "large_2.txt", content);
+    stages.segmentSize = 1000;
+    stages.segmentedHashThreshold = 4000;
+
+    std::vector<HASH::Hash> segmentHashes;
+    for (std::size_t segment = 0; segment < 10; segment++) {
+        segmentHashes.push_back(FILTER::DEDUPLICATION::hashSegment(base_path / "large_0.txt",
+                                                                   10000, segment, stages)
+                                    .value());
+    }
+    const HASH::Hash expected =
+        FILTER::DEDUPLICATION::combineSegmentHashes(segmentHashes, stages);
+
+    for (const std::size_t threads : {1, 4}) {
+        FileSystemInfo fsinfo(base_path, false, threads);
+        fsinfo.setHashStages(stages);
+
+        const auto [items, ranges] = fsinfo.getDuplicates();
+        ASSERT_EQ(ranges, (std::vector<std::size_t>{2, 2, 2}));
+        const auto large = std::find_if(items.begin(), items.end(), [](const auto item) {
+            return item->getSizeInBytes() == 10000;
+        });
+        ASSERT_NE(large, items.end());
+        EXPECT_EQ((*large)->getHash(), expected);
+        EXPECT_EQ((*(large + 1))->getHash(), expected);
+        // three files of each size collide in their head and tail blocks
+        EXPECT_EQ(fsinfo.getHashStatistics().hashedFiles[2], 6);
+    }
+}
+
 } // namespace Test
 } // namespace DDK
 
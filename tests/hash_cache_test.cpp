@@ -0,0 +1,193 @@
+#include "filter/deduplication.hpp"
+#include "fsinfo.hpp"
+#include "hash/hash_cache.hpp"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <thread>
+
+namespace DDK {
+namespace Test {
+
+class HashCacheTest : public testing::Test {
+  protected:
+    HashCacheTest() {
+        std::filesystem::create_directory(base_path);
+        writeFile(base_path / "a.txt", "duplicate");
+        writeFile(base_path / "b.txt", "duplicate");
+        writeFile(base_path / "c.txt", "different");
+    }
+
+    ~HashCacheTest() override { std::filesystem::remove_all(base_path); }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path);
+        outfile << content;
+    }
+
+    // files changed within HashCache::RACY_INTERVAL are never stored
+    static void waitUntilStorable() {
+        std::this_thread::sleep_for(HASH::HashCache::RACY_INTERVAL +
+                                    std::chrono::milliseconds(100));
+    }
+
+    HASH::HashCache::Key getKey(const std::string &name) const {
+        const std::optional<HASH::HashCache::Key> key = HASH::HashCache::getKey(base_path / name);
+        EXPECT_TRUE(key.has_value());
+        return key.value_or(HASH::HashCache::Key{});
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const std::filesystem::path cache_path = std::filesystem::current_path() / "ddk_test_cache";
+};
+
+TEST_F(HashCacheTest, StoresHashesAcrossRuns) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        HASH::HashCache cache(cache_path, 42);
+        EXPECT_FALSE(cache.find(getKey("a.txt"), 0).has_value());
+        cache.insert(getKey("a.txt"), 0, HASH::Hash(1, 2));
+        cache.insert(getKey("a.txt"), 2, HASH::Hash(3, 4));
+        cache.insert(getKey("c.txt"), 1, HASH::Hash(5, 6));
+        EXPECT_EQ(cache.find(getKey("a.txt"), 0), HASH::Hash(1, 2));
+        EXPECT_EQ(cache.getHits(), 1);
+        EXPECT_EQ(cache.getMisses(), 1);
+        ASSERT_TRUE(cache.save());
+    }
+
+    HASH::HashCache cache(cache_path, 42);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.find(getKey("a.txt"), 0), HASH::Hash(1, 2));
+    EXPECT_EQ(cache.find(getKey("a.txt"), 2), HASH::Hash(3, 4));
+    EXPECT_EQ(cache.find(getKey("c.txt"), 1), HASH::Hash(5, 6));
+    EXPECT_FALSE(cache.find(getKey("a.txt"), 1).has_value());
+    EXPECT_FALSE(cache.find(getKey("b.txt"), 0).has_value());
+    EXPECT_EQ(cache.getHits(), 3);
+    EXPECT_EQ(cache.getMisses(), 2);
+
+    // another configuration starts empty
+    const HASH::HashCache other(cache_path, 43);
+    EXPECT_EQ(other.size(), 0);
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_F(HashCacheTest, DropsChangedFiles) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    HASH::HashCache cache(cache_path, 42);
+    cache.insert(getKey("a.txt"), 0, HASH::Hash(1, 2));
+    cache.insert(getKey("b.txt"), 0, HASH::Hash(1, 2));
+    ASSERT_TRUE(cache.save());
+
+    writeFile(base_path / "a.txt", "changed");
+    // same size, only the modification time changes
+    std::filesystem::last_write_time(base_path / "b.txt",
+                                     std::filesystem::last_write_time(base_path / "b.txt") +
+                                         std::chrono::seconds(1));
+
+    HASH::HashCache loaded(cache_path, 42);
+    EXPECT_FALSE(loaded.find(getKey("a.txt"), 0).has_value());
+    EXPECT_FALSE(loaded.find(getKey("b.txt"), 0).has_value());
+    loaded.insert(getKey("a.txt"), 1, HASH::Hash(7, 8));
+    EXPECT_FALSE(loaded.find(getKey("a.txt"), 0).has_value());
+    EXPECT_EQ(loaded.find(getKey("a.txt"), 1), HASH::Hash(7, 8));
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_F(HashCacheTest, KeepsRacyFilesInMemoryOnly) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    {
+        HASH::HashCache cache(cache_path, 42);
+        cache.insert(getKey("a.txt"), 0, HASH::Hash(1, 2));
+        EXPECT_EQ(cache.find(getKey("a.txt"), 0), HASH::Hash(1, 2));
+        ASSERT_TRUE(cache.save());
+    }
+
+    // a.txt could still change within its timestamp tick without a new mtime
+    const HASH::HashCache cache(cache_path, 42);
+    EXPECT_EQ(cache.size(), 0);
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_F(HashCacheTest, CompactsEntriesThatWereNotSeen) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        HASH::HashCache cache(cache_path, 42);
+        cache.insert(getKey("a.txt"), 0, HASH::Hash(1, 2));
+        cache.insert(getKey("b.txt"), 0, HASH::Hash(3, 4));
+        ASSERT_TRUE(cache.save());
+    }
+    // entries are aged in seconds
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    {
+        HASH::HashCache cache(cache_path, 42);
+        EXPECT_TRUE(cache.find(getKey("a.txt"), 0).has_value());
+        cache.insert(getKey("c.txt"), 0, HASH::Hash(5, 6));
+        EXPECT_EQ(cache.compact(std::chrono::hours(24)), 0);
+        EXPECT_EQ(cache.compact(std::chrono::seconds(0)), 1);
+    }
+
+    const HASH::HashCache cache(cache_path, 42);
+    EXPECT_EQ(cache.size(), 2);
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_F(HashCacheTest, FindsDuplicatesWithoutReadingCachedFiles) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    FILTER::DEDUPLICATION::HashStages stages;
+    const std::uint64_t configuration = FILTER::DEDUPLICATION::getCacheConfiguration(stages);
+    {
+        HASH::HashCache cache(cache_path, configuration);
+        stages.cache = &cache;
+        FileSystemInfo fsinfo(base_path, false);
+        fsinfo.setHashStages(stages);
+        EXPECT_EQ(std::get<1>(fsinfo.getDuplicates()), (std::vector<std::size_t>{2}));
+        EXPECT_EQ(cache.getHits(), 0);
+        EXPECT_EQ(cache.getMisses(), 3);
+        ASSERT_TRUE(cache.save());
+    }
+
+    // the changed file is hashed again
+    writeFile(base_path / "b.txt", "Duplicate");
+    HASH::HashCache cache(cache_path, configuration);
+    stages.cache = &cache;
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+    EXPECT_TRUE(std::get<1>(fsinfo.getDuplicates()).empty());
+    EXPECT_EQ(cache.getHits(), 2);
+    EXPECT_EQ(cache.getMisses(), 1);
+
+    // every other hash option needs its own cache
+    stages.algorithm = HASH::Algorithm::XXHASH64;
+    EXPECT_NE(FILTER::DEDUPLICATION::getCacheConfiguration(stages), configuration);
+
+    std::filesystem::remove(cache_path);
+}
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+#include "filter/deduplication.hpp"
+#include "fsinfo.hpp"
+#include "hash/hash.hpp"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+
+namespace DDK {
+namespace Test {
+
+constexpr HASH::Algorithm algorithms[] = {HASH::Algorithm::XXHASH64, HASH::Algorithm::XXHASH3_64,
+                                          HASH::Algorithm::XXHASH3_128};
+
+TEST(HashTest, ComparesAllBits) {
+    EXPECT_EQ(HASH::Hash(1, 2), HASH::Hash(1, 2));
+    EXPECT_NE(HASH::Hash(1, 2), HASH::Hash(1, 3));
+    EXPECT_NE(HASH::Hash(1, 2), HASH::Hash(2, 2));
+    EXPECT_LT(HASH::Hash(5, 1), HASH::Hash(1, 2));
+    EXPECT_LT(HASH::Hash(1, 2), HASH::Hash(2, 2));
+    EXPECT_GT(HASH::Hash(0, 1), HASH::Hash(UINT64_MAX, 0));
+    EXPECT_EQ(HASH::Hash(42), HASH::Hash(42, 0));
+}
+
+TEST(HashTest, ParsesAlgorithmNames) {
+    for (const HASH::Algorithm algorithm : algorithms) {
+        EXPECT_EQ(HASH::parseAlgorithm(HASH::getAlgorithmName(algorithm)), algorithm);
+    }
+    EXPECT_EQ(HASH::getAlgorithmName(HASH::DEFAULT_ALGORITHM), "xxh3-128");
+    EXPECT_FALSE(HASH::parseAlgorithm("md5").has_value());
+    EXPECT_FALSE(HASH::parseAlgorithm("").has_value());
+}
+
+class HashTestAlgorithms : public testing::TestWithParam<HASH::Algorithm> {
+  protected:
+    HashTestAlgorithms() {
+        std::filesystem::create_directory(base_path);
+        writeFile(base_path / "a.txt", std::string(100000, 'a'));
+        writeFile(base_path / "b.txt", std::string(100000, 'a'));
+        writeFile(base_path / "c.txt", std::string(99999, 'a') + "b");
+    }
+
+    ~HashTestAlgorithms() override { std::filesystem::remove_all(base_path); }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path);
+        outfile << content;
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const HASH::Algorithm algorithm = GetParam();
+};
+
+TEST_P(HashTestAlgorithms, FindsDuplicates) {
+    FILTER::DEDUPLICATION::HashStages stages;
+    stages.algorithm = algorithm;
+    FileSystemInfo fsinfo(base_path, false);
+    fsinfo.setHashStages(stages);
+
+    const auto [items, ranges] = fsinfo.getDuplicates();
+    ASSERT_EQ(ranges, std::vector<std::size_t>{2});
+    for (const FileSystemItem *const item : items) {
+        EXPECT_EQ(item->getHash(),
+                  FILTER::DEDUPLICATION::hashMappedMemory(item->getPath(), algorithm));
+    }
+}
+
+TEST_P(HashTestAlgorithms, UsesDigestWidthOfAlgorithm) {
+    const HASH::Hash hash = FILTER::DEDUPLICATION::hashMappedMemory(base_path / "a.txt", algorithm);
+    EXPECT_NE(hash.low, 0);
+    EXPECT_EQ(hash.high != 0, algorithm == HASH::Algorithm::XXHASH3_128);
+
+    // every algorithm yields a different digest
+    for (const HASH::Algorithm other : algorithms) {
+        if (other != algorithm) {
+            EXPECT_NE(FILTER::DEDUPLICATION::hashMappedMemory(base_path / "a.txt", other), hash);
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(HashTestAlgorithmsWithParameter,
+                         HashTestAlgorithms,
+                         testing::ValuesIn(algorithms));
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
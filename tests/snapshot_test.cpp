@@ -0,0 +1,163 @@
+#include "fsinfo.hpp"
+#include "scan/snapshot.hpp"
+#include "stream/streaming_deduplication.hpp"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <thread>
+
+namespace DDK {
+namespace Test {
+
+class SnapshotTest : public testing::Test {
+  protected:
+    SnapshotTest() {
+        std::filesystem::create_directories(base_path / "dir_a" / "dir_c");
+        std::filesystem::create_directory(base_path / "dir_b");
+        writeFile(base_path / "a.txt", "duplicate");
+        writeFile(base_path / "dir_a" / "b.txt", "duplicate");
+        writeFile(base_path / "dir_a" / "dir_c" / "c.txt", "different");
+        writeFile(base_path / "dir_b" / "d.txt", "other");
+    }
+
+    ~SnapshotTest() override {
+        std::filesystem::remove_all(base_path);
+        std::filesystem::remove(snapshot_path);
+    }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path);
+        outfile << content;
+    }
+
+    // directories changed within Snapshot::RACY_INTERVAL are never stored
+    static void waitUntilStorable() {
+        std::this_thread::sleep_for(SCAN::Snapshot::RACY_INTERVAL +
+                                    std::chrono::milliseconds(100));
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const std::filesystem::path snapshot_path =
+        std::filesystem::current_path() / "ddk_test_snapshot";
+};
+
+TEST_F(SnapshotTest, ReusesUnchangedDirectories) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        SCAN::Snapshot snapshot(snapshot_path, false);
+        const FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+        EXPECT_EQ(snapshot.getReusedCount(), 0);
+        EXPECT_EQ(snapshot.getListedCount(), 4);
+        EXPECT_EQ(snapshot.size(), 4);
+        ASSERT_TRUE(snapshot.save());
+    }
+
+    for (const std::size_t threads : {1, 4}) {
+        SCAN::Snapshot snapshot(snapshot_path, false);
+        const FileSystemInfo fsinfo(base_path, false, threads, SCAN::Backend::DEFAULT, &snapshot);
+        EXPECT_EQ(snapshot.getReusedCount(), 4);
+        EXPECT_EQ(snapshot.getListedCount(), 0);
+        EXPECT_EQ(fsinfo.getFilesCount(), 4);
+        EXPECT_EQ(fsinfo.getDirectoriesCount(), 4);
+        EXPECT_EQ(fsinfo.getTotalSize(), 32);
+        EXPECT_EQ(std::get<1>(fsinfo.getDuplicates()), (std::vector<std::size_t>{2}));
+        ASSERT_TRUE(snapshot.save());
+    }
+}
+
+TEST_F(SnapshotTest, ListsChangedDirectories) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        SCAN::Snapshot snapshot(snapshot_path, false);
+        const FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+        ASSERT_TRUE(snapshot.save());
+    }
+
+    // only the parent directory of a new file changes
+    writeFile(base_path / "dir_a" / "dir_c" / "e.txt", "different");
+    SCAN::Snapshot snapshot(snapshot_path, false);
+    const STREAM::StreamingDeduplication dedup(base_path, false, 1, SCAN::Backend::DEFAULT, {},
+                                               &snapshot);
+    EXPECT_EQ(snapshot.getReusedCount(), 3);
+    EXPECT_EQ(snapshot.getListedCount(), 1);
+    EXPECT_EQ(dedup.getFilesCount(), 5);
+    EXPECT_EQ(dedup.getDuplicateRanges(), (std::vector<std::size_t>{2, 2}));
+    // the changed directory is too recent to be stored again
+    EXPECT_EQ(snapshot.size(), 3);
+}
+
+TEST_F(SnapshotTest, NeverGroupsFilesModifiedInPlace) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        SCAN::Snapshot snapshot(snapshot_path, false);
+        const FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+        ASSERT_TRUE(snapshot.save());
+    }
+
+    // appending to a file leaves its directory unchanged, so the snapshot keeps its old size
+    std::ofstream(base_path / "a.txt", std::ios::app) << "XYZ";
+    for (const auto engine :
+         {FILTER::DEDUPLICATION::Engine::HASH, FILTER::DEDUPLICATION::Engine::LOCKSTEP}) {
+        for (const unsigned int queueDepth : {0, 4}) {
+            SCAN::Snapshot snapshot(snapshot_path, false);
+            FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+            EXPECT_EQ(snapshot.getReusedCount(), 4);
+            FILTER::DEDUPLICATION::HashStages stages;
+            stages.ioUringQueueDepth = queueDepth;
+            fsinfo.setHashStages(stages);
+            fsinfo.setEngine(engine);
+            EXPECT_TRUE(std::get<1>(fsinfo.getDuplicates()).empty());
+        }
+    }
+
+    SCAN::Snapshot snapshot(snapshot_path, false);
+    const STREAM::StreamingDeduplication dedup(base_path, false, 1, SCAN::Backend::DEFAULT, {},
+                                               &snapshot);
+    EXPECT_EQ(snapshot.getReusedCount(), 4);
+    EXPECT_TRUE(dedup.getDuplicateRanges().empty());
+}
+
+TEST_F(SnapshotTest, IgnoresOtherSnapshots) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "no inodes";
+#endif
+    waitUntilStorable();
+    {
+        SCAN::Snapshot snapshot(snapshot_path, false);
+        const FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+        ASSERT_TRUE(snapshot.save());
+    }
+
+    // listings differ with followed symlinks
+    {
+        SCAN::Snapshot snapshot(snapshot_path, true);
+        const FileSystemInfo fsinfo(base_path, true, 1, SCAN::Backend::DEFAULT, &snapshot);
+        EXPECT_EQ(snapshot.getReusedCount(), 0);
+    }
+
+    // a truncated file starts an empty snapshot
+    std::filesystem::resize_file(snapshot_path, std::filesystem::file_size(snapshot_path) - 1);
+    SCAN::Snapshot snapshot(snapshot_path, false);
+    const FileSystemInfo fsinfo(base_path, false, 1, SCAN::Backend::DEFAULT, &snapshot);
+    EXPECT_EQ(snapshot.getReusedCount(), 0);
+    EXPECT_EQ(fsinfo.getFilesCount(), 4);
+}
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+#include "fsinfo.hpp"
+#include "stream/streaming_deduplication.hpp"
+#include "test_data.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+namespace DDK {
+namespace Test {
+
+class StreamingDeduplicationTest
+    : public testing::TestWithParam<std::tuple<std::size_t, std::size_t, std::size_t, std::size_t>> {
+  protected:
+    StreamingDeduplicationTest() {
+        std::filesystem::create_directory(base_path);
+        Data::setupDirectory(base_path, directories_per_depth, files_per_directory,
+                             recursion_depth);
+    }
+
+    ~StreamingDeduplicationTest() override { std::filesystem::remove_all(base_path); }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+    const std::size_t recursion_depth = std::get<0>(GetParam());
+    const std::size_t directories_per_depth = std::get<1>(GetParam());
+    const std::size_t files_per_directory = std::get<2>(GetParam());
+    const std::size_t threads = std::get<3>(GetParam());
+    const std::size_t total_file_count =
+        (Data::calcualteTotalDirectoryCount(recursion_depth, directories_per_depth) *
+         files_per_directory) +
+        files_per_directory;
+};
+
+TEST_P(StreamingDeduplicationTest, IdenticalToFileSystemInfo) {
+    const FileSystemInfo fsinfo(base_path, false);
+    const STREAM::StreamingDeduplication stream(base_path, false, threads);
+
+    EXPECT_FALSE(stream.symlinks());
+    EXPECT_EQ(stream.getRootPath(), fsinfo.getRootPath());
+    EXPECT_EQ(stream.getTotalSize(), fsinfo.getTotalSize());
+    EXPECT_EQ(stream.getFilesCount(), fsinfo.getFilesCount());
+    EXPECT_EQ(stream.getDirectoriesCount(), fsinfo.getDirectoriesCount());
+    EXPECT_EQ(stream.getSymlinksCount(), fsinfo.getSymlinksCount());
+
+    const auto [items, ranges] = fsinfo.getDuplicates();
+    const auto [paths, stream_ranges] = stream.getDuplicates();
+    ASSERT_EQ(stream_ranges, ranges);
+
+    // same groups in the same order, only the order within a group may differ
+    std::size_t range_start = 0;
+    for (const std::size_t range : ranges) {
+        std::vector<std::filesystem::path> expected;
+        for (std::size_t i = range_start; i < range_start + range; i++) {
+            expected.push_back(items.at(i)->getPath());
+        }
+        std::sort(expected.begin(), expected.end());
+        const std::vector<std::filesystem::path> group(paths.begin() + range_start,
+                                                       paths.begin() + range_start + range);
+        EXPECT_EQ(group, expected);
+        range_start += range;
+    }
+}
+
+TEST_P(StreamingDeduplicationTest, HashesOnlyFilesWithSharedSize) {
+    // all generated files have the same size
+    const std::size_t candidates = total_file_count > 1 ? total_file_count : 0;
+
+    {
+        std::ofstream outfile(base_path / "unique_size.txt");
+        outfile << "unique size" << std::endl;
+    }
+    std::ofstream(base_path / "empty_0.txt").close();
+    std::ofstream(base_path / "empty_1.txt").close();
+
+    const STREAM::StreamingDeduplication stream(base_path, false, threads);
+    EXPECT_EQ(stream.getFilesCount(), total_file_count + 3);
+    EXPECT_EQ(stream.getCandidatesCount(), candidates);
+}
+
+INSTANTIATE_TEST_SUITE_P(StreamingDeduplicationTestWithParameter,
+                         StreamingDeduplicationTest,
+                         testing::Combine(testing::Values(1, 3),   // recursion_depth
+                                          testing::Values(0, 1, 3), // directories_per_depth
+                                          testing::Values(0, 1, 5), // files_per_directory
+                                          testing::Values(1, 4)     // threads
+                                          ));
+
+TEST(StreamingDeduplicationHardlinkTest, HashesEveryFileOnce) {
+    const std::filesystem::path base_path = std::filesystem::current_path() / "ddk_test_data";
+    std::filesystem::create_directory(base_path);
+    for (const std::string name : {"a.txt", "c.txt"}) {
+        std::ofstream outfile(base_path / name);
+        outfile << "duplicate content" << std::endl;
+    }
+    try {
+        std::filesystem::create_hard_link(base_path / "a.txt", base_path / "b.txt");
+        std::filesystem::create_hard_link(base_path / "a.txt", base_path / "d.txt");
+    } catch (const std::system_error &e) {
+        std::filesystem::remove_all(base_path);
+        GTEST_SKIP() << e.what();
+    }
+
+    const STREAM::StreamingDeduplication stream(base_path, false);
+    const auto [paths, ranges] = stream.getDuplicates();
+    EXPECT_EQ(ranges, std::vector<std::size_t>{4});
+    EXPECT_EQ(stream.getFilesCount(), 4);
+    // a.txt and c.txt
+    EXPECT_EQ(stream.getCandidatesCount(), 2);
+
+    // links of a single file are no duplicates
+    std::filesystem::remove(base_path / "c.txt");
+    const STREAM::StreamingDeduplication links(base_path, false);
+    EXPECT_EQ(links.getDuplicatesCount(), 0);
+    EXPECT_EQ(links.getCandidatesCount(), 0);
+
+    std::filesystem::remove_all(base_path);
+}
+
+TEST(StreamingDeduplicationHashStagesTest, IdenticalToFileSystemInfo) {
+    const std::filesystem::path base_path = std::filesystem::current_path() / "ddk_test_data";
+    std::filesystem::create_directory(base_path);
+    // files of equal size that differ in a single block
+    std::vector<std::string> contents{"0123456789abcdef", "0123456789abcdef",
+                                      "X123456789abcdef", "01234567X9abcdef",
+                                      "0123456789abcdeX", "abc",
+                                      "abc"};
+    // hashed in segments
+    contents.insert(contents.end(), 2, std::string(10000, 'a'));
+    contents.push_back(std::string(10000, 'a'));
+    contents.back()[5000] = 'b';
+    for (std::size_t i = 0; i < contents.size(); i++) {
+        std::ofstream outfile(base_path / ("file_" + std::to_string(i) + ".txt"));
+        outfile << contents.at(i);
+    }
+    FILTER::DEDUPLICATION::HashStages stages;
+    stages.headBytes = 4;
+    stages.tailBytes = 4;
+    stages.segmentSize = 1000;
+    stages.segmentedHashThreshold = 4000;
+
+    // small files are hashed by the scanning threads
+    for (const std::uintmax_t singleReadThreshold : {0, 16}) {
+        stages.singleReadThreshold = singleReadThreshold;
+        for (const std::size_t threads : {1, 4}) {
+            FileSystemInfo fsinfo(base_path, false);
+            fsinfo.setHashStages(stages);
+            const STREAM::StreamingDeduplication stream(base_path, false, threads,
+                                                        SCAN::Backend::DEFAULT, stages);
+
+            const auto [items, ranges] = fsinfo.getDuplicates();
+            const auto [paths, stream_ranges] = stream.getDuplicates();
+            ASSERT_EQ(stream_ranges, ranges);
+            std::vector<std::filesystem::path> expected;
+            for (const FileSystemItem *const item : items) {
+                expected.push_back(item->getPath());
+            }
+            std::vector<std::filesystem::path> sorted = paths;
+            std::sort(expected.begin(), expected.end());
+            std::sort(sorted.begin(), sorted.end());
+            EXPECT_EQ(sorted, expected);
+
+            const auto statistics = fsinfo.getHashStatistics();
+            const auto stream_statistics = stream.getHashStatistics();
+            EXPECT_EQ(stream_statistics.hashedFiles, statistics.hashedFiles);
+            EXPECT_EQ(stream_statistics.hashedBytes, statistics.hashedBytes);
+            EXPECT_EQ(stream_statistics.savedBytes, statistics.savedBytes);
+        }
+    }
+
+    std::filesystem::remove_all(base_path);
+}
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+#include "verify/verification.hpp"
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+
+namespace DDK {
+namespace Test {
+
+TEST(VerificationTest, ComparesEveryByte) {
+    // covers the vector loops and the remaining bytes of every kernel
+    for (const std::size_t size : {0, 1, 15, 16, 17, 31, 32, 33, 127, 128, 129, 300}) {
+        const std::vector<char> lhs(size + 1, 'a');
+        for (std::size_t offset = 0; offset < 2; offset++) {
+            std::vector<char> rhs(lhs);
+            EXPECT_TRUE(VERIFY::equalBytes(lhs.data() + offset, rhs.data() + offset,
+                                           size - std::min(size, offset)));
+            for (std::size_t difference = offset; difference < size; difference++) {
+                rhs[difference] = 'b';
+                EXPECT_FALSE(VERIFY::equalBytes(lhs.data() + offset, rhs.data() + offset,
+                                                size - offset))
+                    << "size " << size << " difference " << difference;
+                rhs[difference] = 'a';
+            }
+        }
+    }
+}
+
+class VerificationTestFiles : public testing::Test {
+  protected:
+    VerificationTestFiles() {
+        std::filesystem::create_directory(base_path);
+        const std::string content(5 * 1024 * 1024 + 3, 'a');
+        writeFile(base_path / "keeper.txt", content);
+        writeFile(base_path / "copy_0.txt", content);
+        writeFile(base_path / "copy_1.txt", content);
+        std::string different(content);
+        different.back() = 'b';
+        writeFile(base_path / "different.txt", different);
+        writeFile(base_path / "shorter.txt", content.substr(1));
+    }
+
+    ~VerificationTestFiles() override { std::filesystem::remove_all(base_path); }
+
+    static void writeFile(const std::filesystem::path &path, const std::string &content) {
+        std::ofstream outfile(path, std::ios::binary);
+        outfile << content;
+    }
+
+    const std::string test_directory = "ddk_test_data";
+    const std::filesystem::path base_path = std::filesystem::current_path() / "" / test_directory;
+};
+
+TEST_F(VerificationTestFiles, ComparesFiles) {
+    EXPECT_TRUE(VERIFY::equalFiles(base_path / "keeper.txt", base_path / "copy_0.txt"));
+    EXPECT_FALSE(VERIFY::equalFiles(base_path / "keeper.txt", base_path / "different.txt"));
+    EXPECT_FALSE(VERIFY::equalFiles(base_path / "keeper.txt", base_path / "shorter.txt"));
+    EXPECT_FALSE(VERIFY::equalFiles(base_path / "keeper.txt", base_path / "missing.txt"));
+}
+
+TEST_F(VerificationTestFiles, VerifiesCandidatesAgainstKeeper) {
+    const std::vector<VERIFY::DuplicateGroup> groups{
+        {base_path / "keeper.txt",
+         {base_path / "copy_0.txt", base_path / "different.txt", base_path / "keeper.txt"}},
+        {base_path / "copy_1.txt", {base_path / "shorter.txt", base_path / "copy_0.txt"}},
+    };
+
+    for (const std::size_t threads : {1, 4}) {
+        const VERIFY::Verification verification = VERIFY::verifyDuplicates(groups, threads);
+        EXPECT_EQ(verification.verified,
+                  (std::vector<std::filesystem::path>{base_path / "copy_0.txt",
+                                                      base_path / "copy_0.txt"}));
+        // the keeper itself is never removed
+        EXPECT_EQ(verification.rejected,
+                  (std::vector<std::filesystem::path>{base_path / "different.txt",
+                                                      base_path / "keeper.txt",
+                                                      base_path / "shorter.txt"}));
+        EXPECT_EQ(verification.verifiedBytes,
+                  2 * std::filesystem::file_size(base_path / "copy_0.txt"));
+    }
+}
+
+TEST_F(VerificationTestFiles, NeverRemovesTheDataOfTheKeeper) {
+#if defined(_WIN32)
+    GTEST_SKIP() << "symlinks need extra privileges";
+#endif
+    std::filesystem::create_symlink("keeper.txt", base_path / "link.txt");
+    std::filesystem::create_hard_link(base_path / "keeper.txt", base_path / "hardlink.txt");
+
+    // the symlink comes first, but its target is kept
+    const std::vector<std::filesystem::path> files{base_path / "link.txt",
+                                                   base_path / "keeper.txt"};
+    EXPECT_EQ(VERIFY::selectKeeper(files), 1);
+    EXPECT_EQ(VERIFY::selectKeeper({base_path / "link.txt"}), 0);
+
+    // the target of a kept symlink, the symlink to a kept file and hard links are the same file
+    const std::vector<VERIFY::DuplicateGroup> groups{
+        {base_path / "link.txt", {base_path / "keeper.txt", base_path / "copy_0.txt"}},
+        {base_path / "keeper.txt", {base_path / "link.txt", base_path / "hardlink.txt"}},
+    };
+    const VERIFY::Verification verification = VERIFY::verifyDuplicates(groups);
+    EXPECT_EQ(verification.verified,
+              (std::vector<std::filesystem::path>{base_path / "copy_0.txt"}));
+    EXPECT_EQ(verification.rejected,
+              (std::vector<std::filesystem::path>{base_path / "keeper.txt",
+                                                  base_path / "link.txt",
+                                                  base_path / "hardlink.txt"}));
+}
+
+} // namespace Test
+} // namespace DDK
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}